@@ -0,0 +1,692 @@
+#define _GNU_SOURCE // prctl(PR_SET_PDEATHSIG)
+#include "common.h"
+#include "log.h"
+#include "net.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Gateway: drží TCP spojení klientů, sám odpovídá na HELLO/LIST a roomky
+// rozkládá mezi několik backendů (build/server --unix=... --room-base=...).
+// Backend i má roomky s id i*MAX_ROOMS+1 .. (i+1)*MAX_ROOMS, takže routování
+// JOIN/REJOIN/WATCH je čistě podle čísla roomky. Klient dostane k backendu
+// vlastní UNIX spojení a od té doby se jeho řádky přeposílají beze změny.
+
+#define GW_MAX_CLIENTS 256
+#define GW_MAX_BACKENDS 16
+#define GW_MAX_INVALID 5
+#define GW_REFRESH_SEC 1 // jak často se obnovuje adresář roomek (vyvažování CREATE)
+#define GW_CONNECT_WAIT_MS 3000
+#define GW_LIST_TIMEOUT_SEC 2 // backend, který neodpoví, se v LIST vynechá
+#define GW_ROOM_LINE 128
+
+typedef struct Backend {
+    char path[108]; // sun_path
+    pid_t pid;      // > 0 = backend spustila gateway (--spawn)
+    int ctl_fd;     // řídicí spojení pro LIST; -1 = backend nedostupný
+
+    char rx[BUF_SIZE];
+    size_t rx_len;
+
+    // Adresář: poslední kompletní odpověď na LIST a rozpracovaná další
+    char rooms[MAX_ROOMS][GW_ROOM_LINE];
+    int nrooms;
+    char stage[MAX_ROOMS][GW_ROOM_LINE];
+    int nstage;
+    int load;       // nrooms + CREATE, které rozpracovaný LIST ještě nevidí
+    unsigned creates;          // počet CREATE přeposlaných na backend
+    unsigned creates_at_list;  // stav počítadla při odeslání LIST
+    int expect;     // kolik ROOM řádků ještě přijde; -1 = čekáme na "ROOMS n"
+    int in_flight;  // LIST odeslán, odpověď ještě není celá
+} Backend;
+
+typedef struct Client {
+    int fd; // -1 = volný slot
+    char rx[BUF_SIZE];
+    size_t rx_len;
+
+    int identified;
+    char name[32];
+    int invalid;
+
+    // Spojení k backendu (po prvním CREATE/JOIN/REJOIN/WATCH)
+    int backend;
+    int up_fd;
+    char up_rx[BUF_SIZE];
+    size_t up_rx_len;
+    int swallow_welcome; // odpověď na HELLO, které za klienta poslala gateway
+    int in_room;         // podle JOINED/LEFT/RETURNED_TO_LOBBY od backendu
+
+    int want_list;
+} Client;
+
+static Backend backends[GW_MAX_BACKENDS];
+static int nbackends;
+static Client clients[GW_MAX_CLIENTS];
+
+static int dir_round;   // běží kolo LIST na backendech
+static int dir_again;   // během kola přišel další LIST -> hned další kolo
+static time_t dir_last; // kdy začalo poslední kolo
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int unix_connect(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un a = {0};
+    a.sun_family = AF_UNIX;
+    snprintf(a.sun_path, sizeof(a.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// --- backendy ---
+
+static void backend_ctl_close(Backend *b) {
+    if (b->ctl_fd >= 0) close(b->ctl_fd);
+    b->ctl_fd = -1;
+    b->rx_len = 0;
+    b->nrooms = 0;
+    b->load = 0;
+    b->in_flight = 0;
+}
+
+static int backend_ctl_open(Backend *b) {
+    b->ctl_fd = unix_connect(b->path);
+    if (b->ctl_fd < 0) return 0;
+    b->rx_len = 0;
+    b->in_flight = 0;
+    net_send_lit(b->ctl_fd, "HELLO gw-ctl\n");
+    return 1;
+}
+
+static int backend_for_room(int room_id) {
+    int b = (room_id - 1) / MAX_ROOMS;
+    return (room_id >= 1 && b < nbackends) ? b : -1;
+}
+
+// CREATE jde na nejméně vytížený živý backend (podle posledního adresáře)
+static int backend_least_loaded(void) {
+    int best = -1;
+    for (int i = 0; i < nbackends; i++) {
+        if (backends[i].ctl_fd < 0) continue;
+        if (best < 0 || backends[i].load < backends[best].load) best = i;
+    }
+    return best;
+}
+
+static void dir_start_round(void) {
+    dir_round = 0;
+    dir_last = time(NULL);
+    for (int i = 0; i < nbackends; i++) {
+        Backend *b = &backends[i];
+        if (b->ctl_fd < 0 && !backend_ctl_open(b)) continue;
+        b->nstage = 0;
+        b->expect = -1;
+        b->in_flight = 1;
+        b->creates_at_list = b->creates;
+        net_send_lit(b->ctl_fd, "LIST\n");
+        dir_round = 1;
+    }
+}
+
+static void dir_answer_waiting(void) {
+    int total = 0;
+    for (int i = 0; i < nbackends; i++)
+        if (backends[i].ctl_fd >= 0) total += backends[i].nrooms;
+
+    char head[32];
+    snprintf(head, sizeof(head), "ROOMS %d\n", total);
+
+    for (int c = 0; c < GW_MAX_CLIENTS; c++) {
+        Client *cl = &clients[c];
+        if (cl->fd < 0 || !cl->want_list) continue;
+        cl->want_list = 0;
+
+        net_send_all(cl->fd, head);
+        for (int i = 0; i < nbackends; i++) {
+            if (backends[i].ctl_fd < 0) continue;
+            for (int r = 0; r < backends[i].nrooms; r++)
+                net_send_all(cl->fd, backends[i].rooms[r]);
+        }
+    }
+}
+
+static void dir_round_check(void) {
+    if (!dir_round) return;
+    for (int i = 0; i < nbackends; i++)
+        if (backends[i].ctl_fd >= 0 && backends[i].in_flight) return;
+
+    dir_round = 0;
+    dir_answer_waiting();
+    if (dir_again) {
+        dir_again = 0;
+        dir_start_round();
+        if (!dir_round) dir_answer_waiting(); // žádný backend nežije
+    }
+}
+
+static void dir_request(Client *c) {
+    c->want_list = 1;
+    if (dir_round) {
+        dir_again = 1; // běžící kolo mohlo začít před klientovou poslední akcí
+        return;
+    }
+    dir_start_round();
+    if (!dir_round) dir_answer_waiting();
+}
+
+static void backend_ctl_line(Backend *b, const char *line) {
+    if (strcmp(line, "PING") == 0) {
+        net_send_lit(b->ctl_fd, "PONG\n");
+        return;
+    }
+    if (!b->in_flight) return;
+
+    int n;
+    if (b->expect < 0 && strncmp(line, "ERROR BUSY", 10) == 0) {
+        // Přetížený backend: zůstane poslední známý seznam jeho roomek
+        b->in_flight = 0;
+        dir_round_check();
+        return;
+    }
+    if (b->expect < 0 && sscanf(line, "ROOMS %d", &n) == 1) {
+        b->expect = n;
+    } else if (b->expect > 0 && strncmp(line, "ROOM ", 5) == 0) {
+        if (b->nstage < MAX_ROOMS)
+            snprintf(b->stage[b->nstage++], GW_ROOM_LINE, "%s\n", line);
+        b->expect--;
+    } else {
+        return; // WELCOME apod.
+    }
+
+    if (b->expect == 0) {
+        memcpy(b->rooms, b->stage, sizeof(b->rooms[0]) * (size_t)b->nstage);
+        b->nrooms = b->nstage;
+        // CREATE poslané během kola v odpovědi nejsou, nesmí se zapomenout
+        b->load = b->nrooms + (int)(b->creates - b->creates_at_list);
+        b->in_flight = 0;
+        dir_round_check();
+    }
+}
+
+static void backend_ctl_read(Backend *b) {
+    ssize_t r = recv(b->ctl_fd, b->rx + b->rx_len, sizeof(b->rx) - b->rx_len,
+                     MSG_DONTWAIT);
+    if (r <= 0) {
+        if (r < 0 && (errno == EINTR || errno == EAGAIN)) return;
+        log_warn("backend %s: control connection lost", b->path);
+        backend_ctl_close(b);
+        dir_round_check();
+        return;
+    }
+    b->rx_len += (size_t)r;
+
+    size_t start = 0;
+    for (size_t i = 0; i < b->rx_len; i++) {
+        if (b->rx[i] != '\n') continue;
+        b->rx[i] = '\0';
+        if (i > start && b->rx[i - 1] == '\r') b->rx[i - 1] = '\0';
+        backend_ctl_line(b, b->rx + start);
+        if (b->ctl_fd < 0) return;
+        start = i + 1;
+    }
+    memmove(b->rx, b->rx + start, b->rx_len - start);
+    b->rx_len -= start;
+    if (b->rx_len == sizeof(b->rx)) b->rx_len = 0; // řádek delší než buffer
+}
+
+static int backend_spawn(Backend *b, const char *server, int idx) {
+    char sock[128], base[32];
+    snprintf(sock, sizeof(sock), "--unix=%s", b->path);
+    snprintf(base, sizeof(base), "--room-base=%d", idx * MAX_ROOMS);
+
+    pid_t pid = fork();
+    if (pid < 0) return 0;
+    if (pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGTERM); // backend nepřežije gateway
+        execl(server, server, sock, base, (char *)NULL);
+        perror(server);
+        _exit(127);
+    }
+    b->pid = pid;
+    return 1;
+}
+
+// --- klienti ---
+
+static void client_detach(Client *c) {
+    if (c->up_fd >= 0) close(c->up_fd);
+    c->up_fd = -1;
+    c->backend = -1;
+    c->up_rx_len = 0;
+    c->in_room = 0;
+    c->swallow_welcome = 0;
+}
+
+static void client_close(Client *c) {
+    client_detach(c);
+    if (c->fd >= 0) close(c->fd);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    c->up_fd = -1;
+    c->backend = -1;
+}
+
+static void client_strike(Client *c) {
+    if (++c->invalid < GW_MAX_INVALID) return;
+    net_send_lit(c->fd, "ERROR TOO_MANY_ERRORS\n");
+    log_warn("client fd=%d too many errors -> disconnect", c->fd);
+    client_close(c);
+}
+
+static int client_attach(Client *c, int b) {
+    client_detach(c);
+    c->up_fd = unix_connect(backends[b].path);
+    if (c->up_fd < 0) return 0;
+
+    // Backend o gateway neví: klienta mu představíme jeho vlastním nickem
+    char hello[64];
+    snprintf(hello, sizeof(hello), "HELLO %s\n", c->name);
+    net_send_all(c->up_fd, hello);
+    c->backend = b;
+    c->swallow_welcome = 1;
+    return 1;
+}
+
+static void client_forward(Client *c, const char *line) {
+    net_send_all(c->up_fd, line);
+    net_send_lit(c->up_fd, "\n");
+}
+
+// Příkaz vázaný na roomku na backendu b
+static void client_route(Client *c, int b, const char *line) {
+    if (c->up_fd >= 0 && (c->backend == b || c->in_room)) {
+        // Ve hře na jiném backendu: odpověď (ALREADY_IN_ROOM) dá backend sám
+        client_forward(c, line);
+        return;
+    }
+    if (!client_attach(c, b)) {
+        net_send_lit(c->fd, "ERROR BACKEND_DOWN\n");
+        return;
+    }
+    client_forward(c, line);
+}
+
+static void client_line(Client *c, const char *line) {
+    char cmd[32];
+    if (sscanf(line, "%31s", cmd) != 1) {
+        net_send_lit(c->fd, "ERROR BAD_COMMAND\n");
+        client_strike(c);
+        return;
+    }
+
+    if (strcmp(cmd, "HELLO") == 0) {
+        const char *sp = strchr(line, ' ');
+        if (c->identified) {
+            net_send_lit(c->fd, "ERROR ALREADY_HELLO\n");
+        } else if (!sp || sp[1] == '\0') {
+            net_send_lit(c->fd, "ERROR BAD_ARGS\n");
+            client_strike(c);
+        } else {
+            snprintf(c->name, sizeof(c->name), "%s", sp + 1);
+            c->identified = 1;
+            char out[64];
+            snprintf(out, sizeof(out), "WELCOME %s\n", c->name);
+            net_send_all(c->fd, out);
+        }
+        return;
+    }
+    if (strcmp(cmd, "PING") == 0) {
+        net_send_lit(c->fd, "PONG\n");
+        return;
+    }
+    if (strcmp(cmd, "PONG") == 0) {
+        if (c->up_fd >= 0) client_forward(c, line); // heartbeat backendu
+        return;
+    }
+    if (strcmp(cmd, "RESUME") == 0) {
+        // Token zná jen backend, který ho vydal, a gateway ho zatím
+        // nepřeposílá; klient se vrací přes HELLO + REJOIN
+        net_send_lit(c->fd, "ERROR UNSUPPORTED\n");
+        return;
+    }
+    if (!c->identified) {
+        net_send_lit(c->fd, "ERROR MUST_HELLO\n");
+        client_strike(c);
+        return;
+    }
+
+    if (strcmp(cmd, "LIST") == 0) {
+        // Odběr diffů by musel spojit proudy všech backendů; klient zůstane
+        // u dotazování
+        if (strcmp(line, "LIST") != 0) {
+            net_send_lit(c->fd, "ERROR UNSUPPORTED\n");
+            return;
+        }
+        dir_request(c);
+        return;
+    }
+    if (strcmp(cmd, "MUX") == 0) {
+        // Klient gatewaye má jedno spojení na jeden backend; roomky MUX
+        // spojení by mohly ležet na různých. Boti jdou přímo na backend.
+        net_send_lit(c->fd, "ERROR UNSUPPORTED\n");
+        return;
+    }
+
+    if (strcmp(cmd, "CREATE") == 0) {
+        int b = (c->up_fd >= 0) ? c->backend : backend_least_loaded();
+        if (b < 0) {
+            net_send_lit(c->fd, "ERROR NO_ROOMS\n");
+            return;
+        }
+        backends[b].creates++;
+        backends[b].load++; // odhad do dalšího LIST
+        client_route(c, b, line);
+        return;
+    }
+
+    if (strcmp(cmd, "JOIN") == 0 || strcmp(cmd, "REJOIN") == 0 ||
+        strcmp(cmd, "WATCH") == 0) {
+        const char *sp = strchr(line, ' ');
+        int rid;
+        if (!sp || sscanf(sp + 1, "%d", &rid) != 1) {
+            net_send_lit(c->fd, "ERROR BAD_ARGS\n");
+            client_strike(c);
+            return;
+        }
+        int b = backend_for_room(rid);
+        if (b < 0) {
+            net_send_lit(c->fd, "ERROR ROOM_NOT_FOUND\n");
+            return;
+        }
+        client_route(c, b, line);
+        return;
+    }
+
+    if (c->up_fd >= 0) {
+        client_forward(c, line);
+        return;
+    }
+    // Žebříček má každý backend v paměti zvlášť; klient bez backendu nemá
+    // kterou tabulku dostat (ve hře se ptá svého backendu)
+    if (strcmp(cmd, "LEADERBOARD") == 0 || strcmp(cmd, "RANK") == 0) {
+        net_send_lit(c->fd, "ERROR UNSUPPORTED\n");
+        return;
+    }
+
+    // Bez backendu není klient v žádné roomce: odpovíme jako server
+    if (strcmp(cmd, "UNWATCH") == 0)
+        net_send_lit(c->fd, "ERROR NOT_WATCHING\n");
+    else if (strcmp(cmd, "LEAVE") == 0 || strcmp(cmd, "PLACE") == 0 ||
+             strncmp(cmd, "PLACING", 7) == 0 || strcmp(cmd, "READY") == 0 ||
+             strcmp(cmd, "SHOOT") == 0 || strcmp(cmd, "STATE") == 0 ||
+             strcmp(cmd, "FLEET") == 0 || strcmp(cmd, "AUTO_PLACE") == 0 ||
+             strcmp(cmd, "REMATCH") == 0 || strcmp(cmd, "SALVO") == 0)
+        net_send_lit(c->fd, "ERROR NOT_IN_ROOM\n");
+    else
+        net_send_lit(c->fd, "ERROR BAD_COMMAND\n");
+    client_strike(c);
+}
+
+static void client_read(Client *c) {
+    ssize_t r = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, MSG_DONTWAIT);
+    if (r <= 0) {
+        if (r < 0 && (errno == EINTR || errno == EAGAIN)) return;
+        log_info("client fd=%d disconnected", c->fd);
+        client_close(c); // backend uvidí EOF a nechá slot pro REJOIN
+        return;
+    }
+    c->rx_len += (size_t)r;
+
+    size_t start = 0;
+    for (size_t i = 0; i < c->rx_len; i++) {
+        if (c->rx[i] != '\n') continue;
+        c->rx[i] = '\0';
+        if (i > start && c->rx[i - 1] == '\r') c->rx[i - 1] = '\0';
+        client_line(c, c->rx + start);
+        if (c->fd < 0) return;
+        start = i + 1;
+    }
+    memmove(c->rx, c->rx + start, c->rx_len - start);
+    c->rx_len -= start;
+
+    if (c->rx_len == sizeof(c->rx)) {
+        net_send_lit(c->fd, "ERROR LINE_TOO_LONG\n");
+        client_close(c);
+    }
+}
+
+static void upstream_line(Client *c, const char *line) {
+    if (c->swallow_welcome && strncmp(line, "WELCOME ", 8) == 0) {
+        c->swallow_welcome = 0;
+        return;
+    }
+
+    if (strncmp(line, "JOINED ", 7) == 0 || strncmp(line, "OK REJOINED ", 12) == 0)
+        c->in_room = 1;
+    else if (strncmp(line, "LEFT ", 5) == 0 || strcmp(line, "OPPONENT_LEFT") == 0 ||
+             strcmp(line, "RETURNED_TO_LOBBY") == 0)
+        c->in_room = 0;
+
+    net_send_all(c->fd, line);
+    net_send_lit(c->fd, "\n");
+}
+
+static void upstream_read(Client *c) {
+    ssize_t r = recv(c->up_fd, c->up_rx + c->up_rx_len,
+                     sizeof(c->up_rx) - c->up_rx_len, MSG_DONTWAIT);
+    if (r <= 0) {
+        if (r < 0 && (errno == EINTR || errno == EAGAIN)) return;
+        // Backend klienta odpojil (TOO_MANY_ERRORS) nebo spadl -> stejně jako server
+        log_warn("client fd=%d: backend %d closed the connection", c->fd,
+                 c->backend);
+        client_close(c);
+        return;
+    }
+    c->up_rx_len += (size_t)r;
+
+    size_t start = 0;
+    for (size_t i = 0; i < c->up_rx_len; i++) {
+        if (c->up_rx[i] != '\n') continue;
+        c->up_rx[i] = '\0';
+        upstream_line(c, c->up_rx + start);
+        start = i + 1;
+    }
+    memmove(c->up_rx, c->up_rx + start, c->up_rx_len - start);
+    c->up_rx_len -= start;
+    if (c->up_rx_len == sizeof(c->up_rx)) c->up_rx_len = 0;
+}
+
+static void accept_client(int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    for (int i = 0; i < GW_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) continue;
+        client_close(&clients[i]); // čistý stav
+        clients[i].fd = fd;
+        log_info("client connected fd=%d", fd);
+        return;
+    }
+    net_send_lit(fd, "ERROR SERVER_FULL\n");
+    close(fd);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr,
+                "Usage: %s <ip> <port> [--backend=PATH]... [--spawn=N] [--server=PATH]\n"
+                "  --backend=PATH  running backend; the i-th one must use --room-base=i*%d\n"
+                "  --spawn=N       start N local backends (%s --unix=... --room-base=...)\n"
+                "Example: %s 0.0.0.0 5555 --spawn=4\n",
+                argv[0], MAX_ROOMS, "build/server", argv[0]);
+        return 1;
+    }
+
+    const char *ip = argv[1];
+    int port = atoi(argv[2]);
+    if (port <= 0 || port > 65535) {
+        fprintf(stderr, "Bad port\n");
+        return 1;
+    }
+
+    // Výchozí binárka backendu leží vedle gateway (build/server)
+    char server[512];
+    const char *slash = strrchr(argv[0], '/');
+    snprintf(server, sizeof(server), "%.*sserver",
+             slash ? (int)(slash - argv[0] + 1) : 0, argv[0]);
+
+    int spawn = 0;
+    for (int i = 3; i < argc; i++) {
+        if (strncmp(argv[i], "--backend=", 10) == 0) {
+            if (nbackends == GW_MAX_BACKENDS) {
+                fprintf(stderr, "Too many backends (max %d)\n", GW_MAX_BACKENDS);
+                return 1;
+            }
+            snprintf(backends[nbackends++].path, sizeof(backends[0].path), "%s",
+                     argv[i] + 10);
+        } else if (strncmp(argv[i], "--spawn=", 8) == 0) {
+            spawn = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "--server=", 9) == 0) {
+            snprintf(server, sizeof(server), "%s", argv[i] + 9);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (spawn < 0 || nbackends + spawn > GW_MAX_BACKENDS) {
+        fprintf(stderr, "Bad --spawn (max %d backends)\n", GW_MAX_BACKENDS);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    for (int i = 0; i < spawn; i++) {
+        Backend *b = &backends[nbackends];
+        snprintf(b->path, sizeof(b->path), "/tmp/bsgw-%d-%d.sock", (int)getpid(), i);
+        if (!backend_spawn(b, server, nbackends)) {
+            perror("fork");
+            return 1;
+        }
+        nbackends++;
+    }
+    if (nbackends == 0) {
+        fprintf(stderr, "No backends (use --backend=PATH or --spawn=N)\n");
+        return 1;
+    }
+
+    // Spuštěné backendy chvíli startují: na řídicí spojení počkáme
+    for (int i = 0; i < nbackends; i++) {
+        backends[i].ctl_fd = -1;
+        for (int waited = 0; waited < GW_CONNECT_WAIT_MS; waited += 50) {
+            if (backend_ctl_open(&backends[i])) break;
+            usleep(50 * 1000);
+        }
+        if (backends[i].ctl_fd < 0)
+            log_warn("backend %s not reachable (will retry)", backends[i].path);
+        else
+            log_info("backend %d: %s rooms %d..%d", i, backends[i].path,
+                     i * MAX_ROOMS + 1, (i + 1) * MAX_ROOMS);
+    }
+
+    for (int i = 0; i < GW_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+        client_close(&clients[i]);
+    }
+
+    int listen_fd = net_make_listen_socket(ip, port);
+    log_info("gateway listening on %s:%d (%d backends)", ip, port, nbackends);
+
+    while (!stop_requested) {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(listen_fd, &readfds);
+        int maxfd = listen_fd;
+
+        for (int i = 0; i < nbackends; i++) {
+            int fd = backends[i].ctl_fd;
+            if (fd < 0) continue;
+            FD_SET(fd, &readfds);
+            if (fd > maxfd) maxfd = fd;
+        }
+        for (int i = 0; i < GW_MAX_CLIENTS; i++) {
+            Client *c = &clients[i];
+            if (c->fd < 0) continue;
+            FD_SET(c->fd, &readfds);
+            if (c->fd > maxfd) maxfd = c->fd;
+            if (c->up_fd >= 0) {
+                FD_SET(c->up_fd, &readfds);
+                if (c->up_fd > maxfd) maxfd = c->up_fd;
+            }
+        }
+
+        struct timeval tv = {GW_REFRESH_SEC, 0};
+        int rc = select(maxfd + 1, &readfds, NULL, NULL, &tv);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            perror("select");
+            break;
+        }
+
+        // Pravidelná obnova adresáře (počty roomek pro CREATE, reconnect backendů)
+        if (!dir_round && time(NULL) - dir_last >= GW_REFRESH_SEC) dir_start_round();
+        if (dir_round && time(NULL) - dir_last >= GW_LIST_TIMEOUT_SEC) {
+            for (int i = 0; i < nbackends; i++) {
+                if (!backends[i].in_flight) continue;
+                log_warn("backend %s: LIST timeout", backends[i].path);
+                backends[i].in_flight = 0; // zůstane předchozí adresář
+            }
+            dir_round_check();
+        }
+
+        if (rc == 0) continue;
+
+        if (FD_ISSET(listen_fd, &readfds)) accept_client(listen_fd);
+
+        for (int i = 0; i < nbackends; i++)
+            if (backends[i].ctl_fd >= 0 && FD_ISSET(backends[i].ctl_fd, &readfds))
+                backend_ctl_read(&backends[i]);
+
+        for (int i = 0; i < GW_MAX_CLIENTS; i++) {
+            Client *c = &clients[i];
+            if (c->fd >= 0 && c->up_fd >= 0 && FD_ISSET(c->up_fd, &readfds))
+                upstream_read(c);
+            if (c->fd >= 0 && FD_ISSET(c->fd, &readfds)) client_read(c);
+        }
+    }
+
+    log_info("gateway shutting down");
+    for (int i = 0; i < GW_MAX_CLIENTS; i++)
+        if (clients[i].fd >= 0) client_close(&clients[i]);
+    for (int i = 0; i < nbackends; i++) {
+        backend_ctl_close(&backends[i]);
+        if (backends[i].pid > 0) {
+            kill(backends[i].pid, SIGTERM);
+            waitpid(backends[i].pid, NULL, 0);
+            unlink(backends[i].path);
+        }
+    }
+    close(listen_fd);
+    return 0;
+}
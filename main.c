@@ -4,101 +4,198 @@
 #include "lobby.h"
 #include "game.h"
 #include "protocol.h"
+#include "capture.h"
+#include "journal.h"
+#include "live.h"
+#include "load.h"
 #include "log.h"
+#include "probe.h"
+#include "spectate.h"
+#include "stats.h"
+#include "trace.h"
+#include "wal.h"
+#include <arpa/inet.h>
 #include <errno.h>
+#include <netinet/in.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
 
-#define RECONNECT_GRACE_SEC 45
+#define MAX_CONN_PER_IP 8
 
 static void die(const char *msg) {
     perror(msg);
     exit(1);
 }
 
-static void tick(Room rooms[], Game games[], Player players[]) {
-    // Periodická údržba: hlídá reconnect timeout a v případě vypršení roomku uklidí
-    time_t now = time(NULL);
-
-    for (int i = 0; i < MAX_ROOMS; i++) {
-        Room *r = &rooms[i];
-        if (r->state == ROOM_EMPTY) continue;
-
-        for (int slot = 0; slot < 2; slot++) {
-            if (r->slot_connected[slot]) continue;          // slot je UP
-            if (r->player_names[slot][0] == '\0') continue; // není tam vůbec hráč
-            if (r->slot_down_since[slot] == 0) continue;    // nemáme čas výpadku
-
-            double dt = difftime(now, r->slot_down_since[slot]);
-            if (dt < RECONNECT_GRACE_SEC) continue;
-
-            // Grace vypršela: informujeme protivníka a zavíráme roomku
-            int opp = (slot == 0) ? 1 : 0;
-            if (r->slot_connected[opp]) {
-                Player *op = find_player_by_fd(players, r->player_fds[opp]);
-                if (op) {
-                    net_send_all(op->socket_fd, "OPPONENT_TIMEOUT\n");
-                    net_send_all(op->socket_fd, "ROOM_CLOSED TIMEOUT\n");
-                    net_send_all(op->socket_fd, "RETURNED_TO_LOBBY\n");
-                }
-            }
+static int connections_from_ip(Player players[], uint32_t ip) {
+    int c = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        if (players[i].socket_fd >= 0 && players[i].peer_ip == ip) c++;
+    return c;
+}
 
-            log_info("room=%d slot=%d timeout -> destroy", r->id, slot);
-
-            // Zrušíme hru navázanou na roomku (index = id-1)
-            Game *g = &games[r->id - 1];
-            game_reset(g);
-
-            // Odpojíme VŠECHNY hráče navázané na tuto roomku:
-            // - připojeným pošleme info a vrátíme je do lobby
-            // - ghost sloty pro rejoin tvrdě uvolníme (player_reset)
-            for (int pi = 0; pi < MAX_PLAYERS; pi++) {
-                Player *pp = &players[pi];
-                if (pp->is_identified && pp->current_room_id == r->id) {
-                    if (pp->socket_fd >= 0) {
-                        net_send_all(pp->socket_fd, "ROOM_CLOSED TIMEOUT\n");
-                        net_send_all(pp->socket_fd, "RETURNED_TO_LOBBY\n");
-
-                        // připojený hráč: fd necháme být, jen zrušíme vazbu na roomku
-                        pp->current_room_id = -1;
-                        pp->player_slot = -1;
-                    } else {
-                        // ghost slot: uvolníme celý záznam, aby se dal znovu použít
-                        player_reset(pp);
-                    }
-                }
-            }
+static void accept_player(int listen_fd, Player players[]) {
+    struct sockaddr_storage ss;
+    socklen_t peer_len = sizeof(ss);
+    int new_fd = accept(listen_fd, (struct sockaddr *)&ss, &peer_len);
+    if (new_fd < 0) return;
+
+    // Přetížený server nové klienty nebere (rozehrané hry mají přednost)
+    if (load_level() == LOAD_CRITICAL) {
+        load_send_busy(new_fd);
+        net_close(new_fd);
+        live_counters.rejected++;
+        PROBE2(reject, new_fd, "overloaded");
+        log_warn("rejecting fd=%d (overloaded, lag %d ms)", new_fd, load_lag_ms());
+        return;
+    }
 
-            room_reset(r);
-            break;
+    // UNIX socket (gateway) nemá IP: limit na IP se na něj nevztahuje
+    struct sockaddr_in *peer = (struct sockaddr_in *)&ss;
+    uint32_t peer_ip = (ss.ss_family == AF_INET) ? peer->sin_addr.s_addr : 0;
+
+    if (peer_ip != 0 && connections_from_ip(players, peer_ip) >= MAX_CONN_PER_IP) {
+        char ipbuf[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &peer->sin_addr, ipbuf, sizeof(ipbuf));
+        net_send_lit(new_fd, "ERROR TOO_MANY_CONNECTIONS\n");
+        net_close(new_fd);
+        live_counters.rejected++;
+        PROBE2(reject, new_fd, "per_ip");
+        log_warn("rejecting fd=%d (per-IP limit, %s)", new_fd, ipbuf);
+        return;
+    }
+
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        // bereme jen skutečně volné sloty (ne ghost sloty držené kvůli rejoinu)
+        if (players[i].socket_fd < 0 && players[i].is_identified == 0) {
+            players[i].socket_fd = new_fd;
+            players[i].peer_ip = peer_ip;
+            players[i].rx_len = 0;
+            players[i].rx_pending = RX_IDLE;
+            players[i].rl_last_ms = 0; // bucket se naplní při prvním řádku
+
+            players[i].is_identified = 0;
+            players[i].player_name[0] = '\0';
+
+            players[i].current_room_id = -1;
+            players[i].player_slot = -1;
+            players[i].watching_room_id = -1;
+
+            players[i].invalid_count = 0;
+            players[i].connected = 1;
+            players[i].disconnected_at = 0;
+
+            live_counters.accepted++;
+            PROBE1(accept, new_fd);
+            capture_conn_open(new_fd);
+            log_info("player connected fd=%d", new_fd);
+            return;
         }
     }
+
+    net_send_lit(new_fd, "ERROR SERVER_FULL\n");
+    net_close(new_fd);
+    live_counters.rejected++;
+    PROBE2(reject, new_fd, "full");
+    log_warn("rejecting fd=%d (server full)", new_fd);
 }
 
 int main(int argc, char **argv) {
-    if (argc != 3) {
+    // TCP listener je volitelný: backend za gatewayí poslouchá jen na --unix
+    const char *ip = NULL;
+    int port = 0, first_opt = 1;
+    if (argc >= 3 && strncmp(argv[1], "--", 2) != 0) {
+        ip = argv[1];
+        port = atoi(argv[2]);
+        first_opt = 3;
+        if (port <= 0 || port > 65535) {
+            fprintf(stderr, "Bad port\n");
+            return 1;
+        }
+    }
+
+    // Volitelné přepínače za povinnými argumenty
+    const char *journal_path = NULL;
+    const char *stats_path = NULL;
+    const char *unix_path = NULL;
+    const char *live_name = NULL;
+    const char *wal_prefix = NULL;
+    const char *capture_path = NULL;
+    for (int i = first_opt; i < argc; i++) {
+        if (strncmp(argv[i], "--watch-delay=", 14) == 0) {
+            spec_delay_sec = atoi(argv[i] + 14);
+            if (spec_delay_sec < 0) spec_delay_sec = 0;
+        } else if (strncmp(argv[i], "--journal=", 10) == 0) {
+            journal_path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--stats=", 8) == 0) {
+            stats_path = argv[i] + 8;
+        } else if (strncmp(argv[i], "--live=", 7) == 0) {
+            live_name = argv[i] + 7;
+        } else if (strncmp(argv[i], "--wal=", 6) == 0) {
+            wal_prefix = argv[i] + 6;
+        } else if (strncmp(argv[i], "--capture=", 10) == 0) {
+            capture_path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--rate-limit=", 13) == 0) {
+            protocol_rate_cmds = atoi(argv[i] + 13);
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            trace_enable(NULL);
+        } else if (strncmp(argv[i], "--trace-file=", 13) == 0) {
+            trace_enable(argv[i] + 13);
+        } else if (strncmp(argv[i], "--unix=", 7) == 0) {
+            unix_path = argv[i] + 7;
+        } else if (strncmp(argv[i], "--room-base=", 12) == 0) {
+            lobby_room_base = atoi(argv[i] + 12);
+            if (lobby_room_base < 0) lobby_room_base = 0;
+        } else if (strncmp(argv[i], "--busy-lag-ms=", 14) == 0) {
+            load_busy_ms = atoi(argv[i] + 14);
+        } else if (strncmp(argv[i], "--critical-lag-ms=", 18) == 0) {
+            load_critical_ms = atoi(argv[i] + 18);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (!ip && !unix_path) {
         fprintf(stderr,
-                "Usage: %s <ip> <port>\nExample: %s 0.0.0.0 5555\n",
-                argv[0], argv[0]);
+                "Usage: %s <ip> <port> [--watch-delay=SEC] [--journal=PATH] [--stats=PATH]\n"
+                "          [--trace] [--trace-file=PATH] [--live=SHM_NAME]\n"
+                "          [--unix=PATH] [--room-base=N] [--wal=PREFIX]\n"
+                "          [--busy-lag-ms=MS] [--critical-lag-ms=MS]\n"
+                "          [--capture=PATH] [--rate-limit=CMDS_PER_SEC]\n"
+                "       %s --unix=PATH [--room-base=N] [options]\n"
+                "Example: %s 0.0.0.0 5555\n",
+                argv[0], argv[0], argv[0]);
         return 1;
     }
 
-    const char *ip = argv[1];
-    int port = atoi(argv[2]);
-    if (port <= 0 || port > 65535) {
-        fprintf(stderr, "Bad port\n");
-        return 1;
+    if (journal_path && !journal_open(journal_path)) return 1;
+    if (stats_path && !stats_open(stats_path)) return 1;
+    if (live_name && !live_open(live_name)) return 1;
+    if (capture_path && !capture_open(capture_path)) return 1;
+
+    int listen_fd = -1, unix_fd = -1;
+    if (ip) {
+        listen_fd = net_make_listen_socket(ip, port);
+        log_info("server listening on %s:%d", ip, port);
+    }
+    if (unix_path) {
+        unix_fd = net_make_unix_listen_socket(unix_path);
+        log_info("server listening on unix:%s (room base %d)", unix_path,
+                 lobby_room_base);
     }
 
-    int listen_fd = net_make_listen_socket(ip, port);
-    log_info("server listening on %s:%d", ip, port);
+    // Odpovědi se skládají do bufferů spojení a odchází jednou za iteraci
+    net_set_buffered(1);
 
     Player players[MAX_PLAYERS];
     for (int i = 0; i < MAX_PLAYERS; i++) {
+        memset(&players[i], 0, sizeof(players[i]));
         players[i].socket_fd = -1;
         player_reset(&players[i]);
     }
@@ -109,83 +206,115 @@ int main(int argc, char **argv) {
     Game games[MAX_ROOMS];
     for (int i = 0; i < MAX_ROOMS; i++) game_reset(&games[i]);
 
+    // Roomky a hry z minulého běhu (snapshot + log); hráči se vrací přes REJOIN
+    if (wal_prefix && !wal_open(wal_prefix, rooms, games)) return 1;
+
+    int rr_start = 0; // round-robin: kdo je v iteraci obsloužen první
+    time_t spec_flushed_at = 0;
+
     while (1) {
         fd_set readfds;
         FD_ZERO(&readfds);
 
-        FD_SET(listen_fd, &readfds);
-        int maxfd = listen_fd;
+        int maxfd = -1;
+        if (listen_fd >= 0) {
+            FD_SET(listen_fd, &readfds);
+            maxfd = listen_fd;
+        }
+        if (unix_fd >= 0) {
+            FD_SET(unix_fd, &readfds);
+            if (unix_fd > maxfd) maxfd = unix_fd;
+        }
 
+        int pending_budget = 0, pending_rate = 0;
         for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (players[i].socket_fd >= 0) {
-                FD_SET(players[i].socket_fd, &readfds);
-                if (players[i].socket_fd > maxfd) maxfd = players[i].socket_fd;
+            if (players[i].socket_fd < 0) continue;
+
+            // Hráč s odloženými řádky se nečte (TCP backpressure), jen dožene frontu
+            if (players[i].rx_pending == RX_PENDING_BUDGET) {
+                pending_budget = 1;
+                continue;
             }
+            if (players[i].rx_pending == RX_PENDING_RATE) {
+                pending_rate = 1;
+                continue;
+            }
+            FD_SET(players[i].socket_fd, &readfds);
+            if (players[i].socket_fd > maxfd) maxfd = players[i].socket_fd;
         }
 
+        // Odložené řádky: nečekáme celou sekundu (rate limit = krátký poll)
         struct timeval tv;
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
+        tv.tv_sec = (pending_budget || pending_rate) ? 0 : 1;
+        tv.tv_usec = pending_budget ? 0 : pending_rate ? 10000 : 0;
 
         int rc = select(maxfd + 1, &readfds, NULL, NULL, &tv);
         if (rc < 0) {
-            if (errno == EINTR) continue;
+            if (errno == EINTR) {
+                trace_poll(); // SIGUSR1 přerušil select -> dump hned
+                continue;
+            }
             die("select");
         }
 
+        // Od teď do konce iterace se měří zpoždění smyčky (čekání v select ne)
+        load_iter_begin();
+        int level = load_level();
+
         // Periodická údržba
-        tick(rooms, games, players);
+        TraceSpan ts = trace_begin("tick", 0);
+        protocol_tick(rooms, games, players);
+        trace_end(&ts);
 
         // Heartbeat: server pinguje klienty, po pár missed PONG to řeší jako „down“
         protocol_heartbeat_tick(rooms, games, players);
 
-        // Nové připojení
-        if (rc > 0 && FD_ISSET(listen_fd, &readfds)) {
-            int new_fd = accept(listen_fd, NULL, NULL);
-            if (new_fd >= 0) {
-                int placed = 0;
-                for (int i = 0; i < MAX_PLAYERS; i++) {
-                    // bereme jen skutečně volné sloty (ne ghost sloty držené kvůli rejoinu)
-                    if (players[i].socket_fd < 0 && players[i].is_identified == 0) {
-                        players[i].socket_fd = new_fd;
-                        players[i].rx_len = 0;
-
-                        players[i].is_identified = 0;
-                        players[i].player_name[0] = '\0';
-
-                        players[i].current_room_id = -1;
-                        players[i].player_slot = -1;
-
-                        players[i].invalid_count = 0;
-                        players[i].connected = 1;
-                        players[i].disconnected_at = 0;
-
-                        placed = 1;
-                        break;
-                    }
-                }
-
-                if (!placed) {
-                    net_send_all(new_fd, "ERROR SERVER_FULL\n");
-                    close(new_fd);
-                    log_warn("rejecting fd=%d (server full)", new_fd);
-                } else {
-                    log_info("player connected fd=%d", new_fd);
-                }
-            }
+        // Nová připojení
+        if (rc > 0 && listen_fd >= 0 && FD_ISSET(listen_fd, &readfds))
+            accept_player(listen_fd, players);
+        if (rc > 0 && unix_fd >= 0 && FD_ISSET(unix_fd, &readfds))
+            accept_player(unix_fd, players);
+
+        // Data od hráčů (při zátěži nejdřív hráči ve hře, lobby po nich)
+        protocol_serve(rooms, games, players, rc > 0 ? &readfds : NULL, level,
+                       rr_start);
+        rr_start = (rr_start + 1) % MAX_PLAYERS;
+
+        // Změny roomek z této iterace jako jeden diff odběratelům lobby
+        lobby_publish(rooms, players);
+
+        // Odeslání nasbíraných (sdílených) zpráv spectatorům; při zátěži
+        // nejvýš jednou za sekundu (fronty mezitím jen rostou)
+        time_t now = net_now();
+        if (level == LOAD_OK || now != spec_flushed_at) {
+            spec_flush(players);
+            spec_flushed_at = now;
         }
 
-        // Data od hráčů
-        if (rc > 0) {
-            for (int i = 0; i < MAX_PLAYERS; i++) {
-                if (players[i].socket_fd >= 0 &&
-                    FD_ISSET(players[i].socket_fd, &readfds)) {
-                    protocol_process_incoming(&players[i], rooms, games, players);
-                }
-            }
-        }
+        // Žurnál se zapisuje velkými bloky až tady, mimo obsluhu příkazů
+        journal_flush(0);
+        capture_flush(0);
+
+        // Dump trasování na vyžádání (SIGUSR1)
+        trace_poll();
+
+        // Snímek pro bstop (nejvýš 4x za sekundu, bez čekání na čtenáře)
+        live_publish(rooms, games, players);
+
+        // Změny roomek z této iterace do logu dřív, než odejdou odpovědi
+        wal_flush(rooms, games);
+
+        // Všechno, co se v této iteraci nasbíralo, odchází až teď
+        net_flush_all();
+        load_iter_end();
     }
 
-    close(listen_fd);
+    journal_close();
+    capture_close();
+    stats_close();
+    live_close();
+    wal_close();
+    if (listen_fd >= 0) close(listen_fd);
+    if (unix_fd >= 0) close(unix_fd);
     return 0;
 }
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "game.h"
+#include <stdint.h>
+
+// Bitboard přes celou desku varianty: bit (y * n + x). Pole má místo pro
+// největší variantu; funkce berou počet platných slov (nw), který je v
+// specializovaných jádrech konstanta, takže se smyčky rozvinou
+#define BB_MAX_CELLS (GAME_N_MAX * GAME_N_MAX)
+#define BB_MAX_WORDS ((BB_MAX_CELLS + 63) / 64)
+#define BB_WORDS_FOR(n) (((n) * (n) + 63) / 64)
+
+typedef struct Bitboard {
+  uint64_t w[BB_MAX_WORDS];
+} Bitboard;
+
+static inline void bb_clear(Bitboard *b, const int nw) {
+  for (int i = 0; i < nw; i++)
+    b->w[i] = 0;
+}
+
+static inline void bb_set(Bitboard *b, int cell) {
+  b->w[cell >> 6] |= 1ull << (cell & 63);
+}
+
+static inline int bb_test(const Bitboard *b, int cell) {
+  return (int)((b->w[cell >> 6] >> (cell & 63)) & 1u);
+}
+
+static inline int bb_empty(const Bitboard *b, const int nw) {
+  uint64_t acc = 0;
+  for (int i = 0; i < nw; i++)
+    acc |= b->w[i];
+  return acc == 0;
+}
+
+static inline int bb_intersects(const Bitboard *a, const Bitboard *b,
+                                const int nw) {
+  uint64_t acc = 0;
+  for (int i = 0; i < nw; i++)
+    acc |= a->w[i] & b->w[i];
+  return acc != 0;
+}
+
+static inline void bb_and(Bitboard *d, const Bitboard *a, const int nw) {
+  for (int i = 0; i < nw; i++)
+    d->w[i] &= a->w[i];
+}
+
+static inline void bb_or(Bitboard *d, const Bitboard *a, const int nw) {
+  for (int i = 0; i < nw; i++)
+    d->w[i] |= a->w[i];
+}
+
+static inline void bb_andnot(Bitboard *d, const Bitboard *a, const int nw) {
+  for (int i = 0; i < nw; i++)
+    d->w[i] &= ~a->w[i];
+}
+
+// d = a >> n (posun směrem k nižším buňkám přes hranice slov)
+static inline void bb_shr(Bitboard *d, const Bitboard *a, int n,
+                          const int nw) {
+  int ws = n >> 6, bs = n & 63;
+  for (int i = 0; i < nw; i++) {
+    uint64_t lo = (i + ws < nw) ? a->w[i + ws] : 0;
+    uint64_t hi = (i + ws + 1 < nw) ? a->w[i + ws + 1] : 0;
+    d->w[i] = bs ? (lo >> bs) | (hi << (64 - bs)) : lo;
+  }
+}
+
+static inline int bb_popcount(const Bitboard *b, const int nw) {
+  int c = 0;
+  for (int i = 0; i < nw; i++)
+    c += __builtin_popcountll(b->w[i]);
+  return c;
+}
+
+// Iterace přes nastavené bity: volat dokud nevrátí -1 (bity se mažou)
+static inline int bb_pop_first(Bitboard *b, const int nw) {
+  for (int i = 0; i < nw; i++) {
+    if (b->w[i]) {
+      int bit = __builtin_ctzll(b->w[i]);
+      b->w[i] &= b->w[i] - 1;
+      return i * 64 + bit;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,227 @@
+#include "bot.h"
+#include "bitboard.h"
+#include "rng.h"
+#include <string.h>
+
+// Váha rozmístění, které pokrývá už zasaženou (nepotopenou) buňku:
+// v "target" režimu tím bot dostřeluje rozbitou loď místo hledání nové
+#define BOT_HIT_WEIGHT 24
+
+// Masky pro každou variantu (buňka = y * n + x)
+static Bitboard full_mask[GAME_VARIANT_COUNT];
+static Bitboard start_h[GAME_VARIANT_COUNT][GAME_N_MAX + 1]; // x <= n - len
+static Bitboard start_v[GAME_VARIANT_COUNT][GAME_N_MAX + 1]; // y <= n - len
+static int masks_ready = 0;
+
+static void init_masks(void) {
+  if (masks_ready)
+    return;
+
+  for (int v = 0; v < GAME_VARIANT_COUNT; v++) {
+    int n = game_variants[v].n;
+    bb_clear(&full_mask[v], BB_MAX_WORDS);
+    for (int c = 0; c < n * n; c++)
+      bb_set(&full_mask[v], c);
+
+    for (int len = 1; len <= n; len++) {
+      bb_clear(&start_h[v][len], BB_MAX_WORDS);
+      bb_clear(&start_v[v][len], BB_MAX_WORDS);
+      for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+          if (x <= n - len)
+            bb_set(&start_h[v][len], y * n + x);
+          if (y <= n - len)
+            bb_set(&start_v[v][len], y * n + x);
+        }
+      }
+    }
+  }
+  masks_ready = 1;
+}
+
+// Všechny počáteční buňky, odkud se loď délky len vejde do volných buněk
+GAME_KERNEL void valid_starts(int variant, const Bitboard *free, int len,
+                              Bitboard *h, Bitboard *v, const int n) {
+  const int nw = BB_WORDS_FOR(n);
+  Bitboard t;
+  *h = *free;
+  bb_and(h, &start_h[variant][len], nw);
+  *v = *free;
+  bb_and(v, &start_v[variant][len], nw);
+
+  for (int k = 1; k < len; k++) {
+    bb_shr(&t, free, k, nw);
+    bb_and(h, &t, nw);
+    bb_shr(&t, free, k * n, nw);
+    bb_and(v, &t, nw);
+  }
+}
+
+GAME_KERNEL int nth_bit(const Bitboard *b, int k, const int nw) {
+  Bitboard t = *b;
+  int c;
+  while ((c = bb_pop_first(&t, nw)) >= 0) {
+    if (k-- == 0)
+      return c;
+  }
+  return -1;
+}
+
+const char *bot_level_str(int level) {
+  return (level == BOT_EASY) ? "EASY" : (level == BOT_HARD) ? "HARD" : "NONE";
+}
+
+int bot_level_from_str(const char *s) {
+  if (!s || !s[0])
+    return BOT_EASY;
+  if (strcmp(s, "easy") == 0 || strcmp(s, "EASY") == 0)
+    return BOT_EASY;
+  if (strcmp(s, "hard") == 0 || strcmp(s, "HARD") == 0)
+    return BOT_HARD;
+  return BOT_NONE;
+}
+
+int bot_place_fleet(Game *g, int slot, uint64_t *rng,
+                    PendingShip out[GAME_FLEET_MAX]) {
+  PendingShip fleet[GAME_FLEET_MAX];
+  char err[64];
+  if (!game_random_fleet(g, rng, fleet) ||
+      !game_place_fleet(g, slot, fleet, g->fleet, err, sizeof(err)))
+    return 0;
+  if (out)
+    memcpy(out, fleet, sizeof(fleet[0]) * (size_t)g->fleet);
+  return 1;
+}
+
+GAME_KERNEL int pick_random(const Bitboard *b, uint64_t *rng, const int nw) {
+  int cnt = bb_popcount(b, nw);
+  if (cnt == 0)
+    return -1;
+  return nth_bit(b, (int)rng_below(rng, (unsigned)cnt), nw);
+}
+
+// skip = buňky už vybrané do rozpracované salvy (výsledek zatím neznámý)
+GAME_KERNEL int choose_shot(const Game *g, int slot, int level, uint64_t *rng,
+                            const Bitboard *skip, const int n) {
+  const int nw = BB_WORDS_FOR(n);
+  int enemy = (slot == 0) ? 1 : 0;
+
+  // Veřejná informace o soupeřově desce: minutí, zásahy, potopené lodě
+  Bitboard shot, blocked, open_hits;
+  bb_clear(&shot, nw);
+  bb_clear(&blocked, nw);
+  bb_clear(&open_hits, nw);
+
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < n; x++) {
+      unsigned char c = g->board[enemy][y][x];
+      int cell = y * n + x;
+      if (c == 3) {
+        bb_set(&shot, cell);
+        bb_set(&blocked, cell);
+      } else if (c == 2) {
+        bb_set(&shot, cell);
+        int ss = (int)g->ship_id[enemy][y][x] - 1;
+        if (ss >= 0 && ss < g->fleet && g->ships_left_count[enemy][ss] == 0)
+          bb_set(&blocked, cell); // potopená loď už nic dalšího neskrývá
+        else
+          bb_set(&open_hits, cell);
+      }
+    }
+  }
+
+  Bitboard unknown = full_mask[g->variant];
+  bb_andnot(&unknown, &shot, nw);
+  if (skip)
+    bb_andnot(&unknown, skip, nw);
+
+  if (level != BOT_HARD)
+    return pick_random(&unknown, rng, nw);
+
+  Bitboard free = full_mask[g->variant];
+  bb_andnot(&free, &blocked, nw);
+  int target = !bb_empty(&open_hits, nw);
+
+  unsigned heat[BB_MAX_CELLS];
+  memset(heat, 0, sizeof(heat[0]) * (size_t)(n * n));
+
+  // Hustota: kolik legálních rozmístění zbývajících lodí pokrývá buňku
+  for (int s = 0; s < g->fleet; s++) {
+    if (g->ships_left_count[enemy][s] == 0)
+      continue;
+    int len = g->ship_len[s];
+    Bitboard starts[2];
+    valid_starts(g->variant, &free, len, &starts[0], &starts[1], n);
+
+    for (int d = 0; d < 2; d++) {
+      int step = d ? n : 1;
+      int c;
+      while ((c = bb_pop_first(&starts[d], nw)) >= 0) {
+        unsigned w = 1;
+        if (target) {
+          for (int i = 0; i < len; i++)
+            if (bb_test(&open_hits, c + i * step))
+              w += BOT_HIT_WEIGHT;
+        }
+        for (int i = 0; i < len; i++)
+          heat[c + i * step] += w;
+      }
+    }
+  }
+
+  // Maximum přes nestřelené buňky, shody rozhodne náhoda
+  int best = -1;
+  unsigned best_heat = 0;
+  int ties = 0;
+  Bitboard cand = unknown;
+  int c;
+  while ((c = bb_pop_first(&cand, nw)) >= 0) {
+    if (heat[c] > best_heat) {
+      best_heat = heat[c];
+      best = c;
+      ties = 1;
+    } else if (heat[c] == best_heat && best_heat > 0) {
+      if (rng_below(rng, (unsigned)++ties) == 0)
+        best = c;
+    }
+  }
+
+  if (best < 0)
+    best = pick_random(&unknown, rng, nw);
+  return best;
+}
+
+int bot_choose_shot(const Game *g, int slot, int level, uint64_t *rng,
+                    int *out_x, int *out_y) {
+  init_masks();
+
+  int best = -1, n = g->n;
+  GAME_SPECIALIZE(g, best = choose_shot(g, slot, level, rng, NULL, N));
+  if (best < 0)
+    return 0;
+
+  *out_x = best % n;
+  *out_y = best / n;
+  return 1;
+}
+
+int bot_choose_salvo(const Game *g, int slot, int level, uint64_t *rng,
+                     GameShot out[], int count) {
+  init_masks();
+
+  // Celá salva se vybírá naslepo jako u hráče: další výstřel nezná výsledek
+  // předchozích, jen je vynechá
+  Bitboard picked;
+  bb_clear(&picked, BB_MAX_WORDS);
+  int n = g->n;
+  for (int i = 0; i < count; i++) {
+    int best = -1;
+    GAME_SPECIALIZE(g, best = choose_shot(g, slot, level, rng, &picked, N));
+    if (best < 0)
+      return i;
+    bb_set(&picked, best);
+    out[i].x = best % n;
+    out[i].y = best / n;
+  }
+  return count;
+}
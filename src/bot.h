@@ -0,0 +1,25 @@
+#pragma once
+
+#include "game.h"
+#include <stdint.h>
+
+typedef enum { BOT_NONE = 0, BOT_EASY = 1, BOT_HARD = 2 } BotLevel;
+
+#define BOT_NAME "BOT"
+#define BOT_SLOT 1 // bot vždy sedí na místě P2
+
+const char *bot_level_str(int level);
+int bot_level_from_str(const char *s);
+
+// Náhodně rozmístí celou flotilu (game_random_fleet); out (volitelně)
+// dostane použité souřadnice, aby je šlo zapsat do žurnálu
+int bot_place_fleet(Game *g, int slot, uint64_t *rng,
+                    PendingShip out[GAME_FLEET_MAX]);
+
+// Vybere další výstřel hráče slot; hard = hustota pravděpodobnosti
+int bot_choose_shot(const Game *g, int slot, int level, uint64_t *rng,
+                    int *out_x, int *out_y);
+
+// count různých výstřelů salvy do out (x, y); vrací kolik se jich našlo
+int bot_choose_salvo(const Game *g, int slot, int level, uint64_t *rng,
+                     GameShot out[], int count);
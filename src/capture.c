@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200112L
+#include "capture.h"
+#include "journal.h"
+#include "log.h"
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static int c_fd = -1;
+static unsigned char c_buf[CAPTURE_BUF_SIZE];
+static size_t c_len = 0;
+static uint64_t c_last_us = 0; // čas předchozího záznamu
+static time_t c_last_flush = 0;
+
+static uint64_t mono_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void write_all(const unsigned char *s, size_t len) {
+  while (len > 0) {
+    ssize_t w = write(c_fd, s, len);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      log_error("capture write failed (errno=%d), capture disabled", errno);
+      close(c_fd);
+      c_fd = -1;
+      return;
+    }
+    s += w;
+    len -= (size_t)w;
+  }
+}
+
+void capture_flush(int force) {
+  if (c_fd < 0 || c_len == 0)
+    return;
+
+  time_t now = time(NULL);
+  if (!force && c_len < CAPTURE_FLUSH_AT &&
+      now - c_last_flush < CAPTURE_FLUSH_SEC)
+    return;
+
+  TRACE_SCOPE("flush_capture", (int)c_len);
+  write_all(c_buf, c_len);
+  c_len = 0;
+  c_last_flush = now;
+}
+
+// Hlavička záznamu; vrací 0, když je capture vypnutý
+static int record(uint64_t now_us, int conn, CaptureKind kind, size_t extra) {
+  // Nejhorší případ: 3 varinty po 10 B + data
+  if (c_len + 30 + extra > sizeof(c_buf))
+    capture_flush(1);
+  if (c_fd < 0)
+    return 0;
+
+  c_len += varint_put(c_buf + c_len, now_us - c_last_us);
+  c_len += varint_put(c_buf + c_len, (uint64_t)conn << 2 | kind);
+  c_last_us = now_us;
+  return 1;
+}
+
+int capture_open(const char *path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    log_error("capture open '%s' failed (errno=%d)", path, errno);
+    return 0;
+  }
+
+  c_fd = fd;
+  memcpy(c_buf, CAPTURE_MAGIC, 4);
+  c_len = 4;
+  c_last_us = mono_us(); // první dt = od startu záznamu
+  c_last_flush = time(NULL);
+  capture_flush(1);
+
+  log_info("capturing inbound traffic to '%s'", path);
+  return 1;
+}
+
+void capture_close(void) {
+  if (c_fd < 0)
+    return;
+  capture_flush(1);
+  if (c_fd >= 0)
+    close(c_fd);
+  c_fd = -1;
+}
+
+int capture_enabled(void) { return c_fd >= 0; }
+
+void capture_conn_open(int conn) {
+  if (c_fd >= 0)
+    record(mono_us(), conn, CAP_OPEN, 0);
+}
+
+void capture_conn_close(int conn) {
+  if (c_fd >= 0)
+    record(mono_us(), conn, CAP_CLOSE, 0);
+}
+
+void capture_received(int conn, const char *rx, size_t old_len,
+                      size_t new_len) {
+  if (c_fd < 0)
+    return;
+
+  // Začátek rozepsané řádky: za posledním '\n' v datech z dřívějška
+  size_t start = old_len;
+  while (start > 0 && rx[start - 1] != '\n')
+    start--;
+
+  uint64_t now = mono_us(); // jeden čas pro celý recv()
+  for (size_t i = old_len; i < new_len; i++) {
+    if (rx[i] != '\n')
+      continue;
+    size_t len = i - start;
+    if (len > CAPTURE_LINE_MAX)
+      len = CAPTURE_LINE_MAX;
+    if (!record(now, conn, CAP_LINE, 10 + len))
+      return;
+    c_len += varint_put(c_buf + c_len, (uint64_t)len);
+    memcpy(c_buf + c_len, rx + start, len);
+    c_len += len;
+    start = i + 1;
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Záznam příchozího provozu (--capture=PATH) pro tools/capreplay.c: každý
+// celý řádek od klienta s monotónním časem příjmu, tak jak ho viděl
+// protocol_process_incoming(). Zápis jako u žurnálu: paměťový buffer, na
+// disk velkými bloky z hlavní smyčky (capture_flush).
+//
+// Soubor: CAPTURE_MAGIC, pak záznamy
+//   varint dt_us od předchozího záznamu, varint (conn << 2 | CaptureKind),
+//   u CAP_LINE ještě varint délka + bajty řádku (bez '\n').
+// conn je číslo spojení na serveru; po CAP_CLOSE nebo dalším CAP_OPEN může
+// stejné číslo patřit jinému klientovi.
+
+#define CAPTURE_MAGIC "BSC1"
+#define CAPTURE_BUF_SIZE (256 * 1024)
+#define CAPTURE_FLUSH_AT (64 * 1024)
+#define CAPTURE_FLUSH_SEC 1
+#define CAPTURE_LINE_MAX 1024 // delší řádek server stejně ořízne
+
+typedef enum {
+  CAP_OPEN = 0,  // nové spojení (accept)
+  CAP_LINE = 1,  // celý řádek od klienta
+  CAP_CLOSE = 2  // klient zavřel spojení (EOF / chyba recv)
+} CaptureKind;
+
+int capture_open(const char *path);
+void capture_close(void);
+int capture_enabled(void);
+
+void capture_conn_open(int conn);
+void capture_conn_close(int conn);
+
+// Po recv(): rx[0..old_len) už bylo v bufferu, rx[old_len..new_len) je nové.
+// Zapíše každý řádek, který nová data dokončila (i s začátkem z dřívějška).
+void capture_received(int conn, const char *rx, size_t old_len,
+                      size_t new_len);
+
+void capture_flush(int force);
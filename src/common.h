@@ -4,3 +4,4 @@
 #define MAX_PLAYERS 64
 #define MAX_ROOMS 32
 #define BUF_SIZE 4096
+#define CACHE_LINE 64 // zarovnání horkých částí Player/Room/Game
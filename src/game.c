@@ -1,11 +1,86 @@
+#define _POSIX_C_SOURCE 200112L
 #include "game.h"
+#include "bitboard.h"
 #include "log.h"
 #include "net.h"
+#include "probe.h"
+#include "rng.h"
+#include "trace.h"
+#include "wire.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+
+// Tabulka variant: rozměr desky a flotila (pořadí lodí = ship slot)
+const GameVariant game_variants[GAME_VARIANT_COUNT] = {
+    [GAME_VARIANT_CLASSIC] = {"CLASSIC", GAME_N_CLASSIC, 5, {5, 4, 3, 3, 2}},
+    [GAME_VARIANT_QUICK] = {"QUICK", GAME_N_QUICK, 4, {4, 3, 2, 2}},
+    [GAME_VARIANT_LARGE] = {"LARGE", GAME_N_LARGE, 8,
+                            {6, 5, 4, 4, 3, 3, 2, 2}},
+};
+
+int game_variant_from_str(const char *s) {
+  if (!s)
+    return -1;
+  for (int v = 0; v < GAME_VARIANT_COUNT; v++)
+    if (strcasecmp(s, game_variants[v].name) == 0)
+      return v;
+  return -1;
+}
+
+// Chybový kód do err bez snprintf: literál má délku známou při překladu
+#define SET_ERR(s) set_err(err, errsz, "" s, sizeof(s) - 1)
+
+static inline void set_err(char *err, int errsz, const char *s, size_t n) {
+  if (!err || errsz <= 0) return;
+  if (n >= (size_t)errsz) n = (size_t)errsz - 1;
+  memcpy(err, s, n);
+  err[n] = '\0';
+}
+
+GAME_KERNEL int in_bounds(int x, int y, const int n) {
+  return x >= 0 && x < n && y >= 0 && y < n;
+}
+
+// --- předrenderované řádky desek ---
+
+#define TXT_SELF_TAG "BSELF"
+#define TXT_ENEMY_TAG "BENEMY"
+
+// Offset buňky (x, y) v bloku "TAG y ROW\n": řádky 0..9 mají jednociferné y,
+// od 10 jsou o znak delší
+static inline int txt_cell(int tag_len, int n, int x, int y) {
+  return y * (tag_len + n + 4) + (y > 10 ? y - 10 : 0) + tag_len +
+         (y >= 10 ? 4 : 3) + x;
+}
 
-static int in_bounds(int x, int y) {
-  return x >= 0 && x < GAME_N && y >= 0 && y < GAME_N;
+static inline void txt_set(Game *g, int slot, int x, int y, char self,
+                           char enemy) {
+  g->txt_self[slot][txt_cell(sizeof(TXT_SELF_TAG) - 1, g->n, x, y)] = self;
+  g->txt_enemy[slot][txt_cell(sizeof(TXT_ENEMY_TAG) - 1, g->n, x, y)] = enemy;
+}
+
+static size_t txt_build(char *out, size_t cap, const char *tag, int n) {
+  Wire w = {out, 0, cap, 0};
+  for (int y = 0; y < n; y++) {
+    wire_str(&w, tag);
+    wire_char(&w, ' ');
+    wire_int(&w, y);
+    wire_char(&w, ' ');
+    for (int x = 0; x < n; x++)
+      wire_char(&w, '.');
+    wire_char(&w, '\n');
+  }
+  return w.len;
+}
+
+// Prázdná deska (voda všude); volá se při založení hry a resetu rozmístění
+static void txt_reset(Game *g, int slot) {
+  g->txt_self_len = (unsigned short)txt_build(
+      g->txt_self[slot], sizeof(g->txt_self[slot]), TXT_SELF_TAG, g->n);
+  g->txt_enemy_len = (unsigned short)txt_build(
+      g->txt_enemy[slot], sizeof(g->txt_enemy[slot]), TXT_ENEMY_TAG, g->n);
 }
 
 void game_reset(Game *g) {
@@ -14,28 +89,35 @@ void game_reset(Game *g) {
   g->room_id = -1;
 }
 
-void game_room_init(Game *g, int room_id) {
+void game_room_init(Game *g, int room_id, int variant) {
+  if (variant < 0 || variant >= GAME_VARIANT_COUNT)
+    variant = GAME_VARIANT_CLASSIC;
+  const GameVariant *v = &game_variants[variant];
+
   memset(g, 0, sizeof(*g));
   g->in_use = 1;
   g->room_id = room_id;
 
-  // Definice flotily (5 lodí, včetně dvou samostatných "trojek")
-  g->ship_len[0] = 5;
-  g->ship_len[1] = 4;
-  g->ship_len[2] = 3;
-  g->ship_len[3] = 3;
-  g->ship_len[4] = 2;
+  // Definice flotily podle varianty (klasika: 5 lodí, včetně dvou "trojek")
+  g->variant = variant;
+  g->n = v->n;
+  g->fleet = v->fleet;
+  for (int s = 0; s < v->fleet; s++)
+    g->ship_len[s] = v->ship_len[s];
 
   // Inicializace stavu hráčů (ready/počty zásahů, obsazené "sloty" lodí)
   for (int p = 0; p < 2; p++) {
     g->ready[p] = 0;
     g->ships_alive[p] = 0;
-    for (int s = 0; s < GAME_FLEET; s++) {
+    for (int s = 0; s < GAME_FLEET_MAX; s++) {
       g->ship_used[p][s] = 0;
       g->ships_left_count[p][s] = 0;
     }
   }
 
+  txt_reset(g, 0);
+  txt_reset(g, 1);
+
   g->turn = 0;
   g->finished = 0;
   g->winner = -1;
@@ -46,17 +128,14 @@ void game_clear_player_setup(Game *g, int slot) {
   if (!g || !g->in_use) return;
   if (slot < 0 || slot > 1) return;
 
-  for (int y = 0; y < GAME_N; y++) {
-    for (int x = 0; x < GAME_N; x++) {
-      g->board[slot][y][x] = 0;
-      g->ship_id[slot][y][x] = 0;
-    }
-  }
+  memset(g->board[slot], 0, sizeof(g->board[slot]));
+  memset(g->ship_id[slot], 0, sizeof(g->ship_id[slot]));
+  txt_reset(g, slot);
 
   g->ready[slot] = 0;
   g->ships_alive[slot] = 0;
 
-  for (int s = 0; s < GAME_FLEET; s++) {
+  for (int s = 0; s < GAME_FLEET_MAX; s++) {
     g->ship_used[slot][s] = 0;
     g->ships_left_count[slot][s] = 0;
   }
@@ -65,156 +144,389 @@ void game_clear_player_setup(Game *g, int slot) {
 int game_all_ready(const Game *g) { return g && g->ready[0] && g->ready[1]; }
 
 static int find_free_ship_slot(Game *g, int player, int len) {
-  for (int s = 0; s < GAME_FLEET; s++) {
+  for (int s = 0; s < g->fleet; s++) {
     if (g->ship_len[s] == len && g->ship_used[player][s] == 0)
       return s;
   }
   return -1;
 }
 
+// Kontrola hranic + překryvů a zápis lodě, specializováno podle N
+GAME_KERNEL int place_cells(Game *g, int slot, int ship_slot, int x, int y,
+                            int len, char dir, char *err, int errsz,
+                            const int n) {
+  // Kontrola hranic + překryvů pro všechny buňky lodě
+  for (int i = 0; i < len; i++) {
+    int cx = x + (dir == 'H' ? i : 0);
+    int cy = y + (dir == 'V' ? i : 0);
+    if (!in_bounds(cx, cy, n)) {
+      SET_ERR("OUT_OF_BOUNDS");
+      return 0;
+    }
+    if (g->board[slot][cy][cx] == 1) {
+      SET_ERR("OVERLAP");
+      return 0;
+    }
+  }
+
+  // Umístění lodě + zapsání ship_id, aby šlo později zjistit, která loď se potopila
+  unsigned char sid = (unsigned char)(ship_slot + 1);
+  for (int i = 0; i < len; i++) {
+    int cx = x + (dir == 'H' ? i : 0);
+    int cy = y + (dir == 'V' ? i : 0);
+    g->board[slot][cy][cx] = 1;
+    g->ship_id[slot][cy][cx] = sid;
+    txt_set(g, slot, cx, cy, 'S', '.');
+  }
+  return 1;
+}
+
 int game_place_ship(Game *g, int slot, int x, int y, int len, char dir,
                     char *err, int errsz) {
+  TRACE_SCOPE("game_place_ship", slot);
   if (!g || !g->in_use) {
-    snprintf(err, errsz, "NO_GAME");
+    SET_ERR("NO_GAME");
     return 0;
   }
   if (g->finished) {
-    snprintf(err, errsz, "GAME_FINISHED");
+    SET_ERR("GAME_FINISHED");
     return 0;
   }
   if (slot < 0 || slot > 1) {
-    snprintf(err, errsz, "BAD_SLOT");
+    SET_ERR("BAD_SLOT");
     return 0;
   }
   if (g->ready[slot]) {
-    snprintf(err, errsz, "ALREADY_READY");
+    SET_ERR("ALREADY_READY");
     return 0;
   }
 
   if (dir == 'h' || dir == 'H') dir = 'H';
   if (dir == 'v' || dir == 'V') dir = 'V';
   if (dir != 'H' && dir != 'V') {
-    snprintf(err, errsz, "BAD_DIR");
+    SET_ERR("BAD_DIR");
     return 0;
   }
 
   int ship_slot = find_free_ship_slot(g, slot, len);
   if (ship_slot < 0) {
-    snprintf(err, errsz, "SHIP_NOT_AVAILABLE");
+    SET_ERR("SHIP_NOT_AVAILABLE");
     return 0;
   }
 
-  // Kontrola hranic + překryvů pro všechny buňky lodě
-  for (int i = 0; i < len; i++) {
-    int cx = x + (dir == 'H' ? i : 0);
-    int cy = y + (dir == 'V' ? i : 0);
-    if (!in_bounds(cx, cy)) {
-      snprintf(err, errsz, "OUT_OF_BOUNDS");
+  int ok = 0;
+  GAME_SPECIALIZE(g, ok = place_cells(g, slot, ship_slot, x, y, len, dir, err,
+                                      errsz, N));
+  if (!ok)
+    return 0;
+
+  g->ship_used[slot][ship_slot] = 1;
+  g->ships_left_count[slot][ship_slot] = len;
+  g->ships_alive[slot] += len;
+
+  SET_ERR("OK");
+  return 1;
+}
+
+// --- tabulky rozmístění ---
+
+// Maska každého legálního umístění lodě pro (varianta, délka). Pořadí:
+// nejdřív H (y, x <= n - len), pak V (y <= n - len, x), takže index se
+// z (x, y, dir) spočítá přímo a náhodné umístění je jen náhodný index.
+#define PLACE_POOL 4096
+
+static Bitboard place_pool[PLACE_POOL];
+static const Bitboard *place_tab[GAME_VARIANT_COUNT][GAME_N_MAX + 1];
+static int place_count[GAME_VARIANT_COUNT][GAME_N_MAX + 1];
+static int place_ready = 0;
+
+static void place_init(void) {
+  if (place_ready)
+    return;
+  int used = 0;
+  for (int v = 0; v < GAME_VARIANT_COUNT; v++) {
+    const GameVariant *gv = &game_variants[v];
+    int n = gv->n;
+    for (int s = 0; s < gv->fleet; s++) {
+      int len = gv->ship_len[s];
+      if (place_tab[v][len])
+        continue; // stejně dlouhé lodě sdílí tabulku
+      int span = n - len + 1;
+      int cnt = 2 * n * span;
+      if (used + cnt > PLACE_POOL) {
+        log_error("placement tables need more than %d masks", PLACE_POOL);
+        abort();
+      }
+      Bitboard *t = &place_pool[used];
+      for (int k = 0; k < cnt; k++) {
+        int h = k < n * span;
+        int kk = h ? k : k - n * span;
+        int x = h ? kk % span : kk % n;
+        int y = h ? kk / span : kk / n;
+        bb_clear(&t[k], BB_MAX_WORDS);
+        for (int i = 0; i < len; i++)
+          bb_set(&t[k], (y + (h ? 0 : i)) * n + x + (h ? i : 0));
+      }
+      place_tab[v][len] = t;
+      place_count[v][len] = cnt;
+      used += cnt;
+    }
+  }
+  place_ready = 1;
+}
+
+// Index umístění v place_tab, -1 = loď přesahuje desku
+static inline int place_index(int n, int x, int y, int len, char dir) {
+  int span = n - len + 1;
+  if (span <= 0 || x < 0 || y < 0)
+    return -1;
+  if (dir == 'H')
+    return (x < span && y < n) ? y * span + x : -1;
+  return (x < n && y < span) ? n * span + y * n + x : -1;
+}
+
+// Celá flotila: jedna maska na loď, překryv = AND, obsazení = OR
+GAME_KERNEL int fleet_check(const Game *g, const PendingShip ships[],
+                            PendingShip norm[], char *err, int errsz,
+                            const int n) {
+  const int nw = BB_WORDS_FOR(n);
+  Bitboard occ;
+  bb_clear(&occ, nw);
+  unsigned used = 0; // ship sloty už přiřazené některé lodi
+
+  for (int i = 0; i < g->fleet; i++) {
+    PendingShip ps = ships[i];
+    if (ps.dir == 'h') ps.dir = 'H';
+    if (ps.dir == 'v') ps.dir = 'V';
+    if (ps.dir != 'H' && ps.dir != 'V') {
+      SET_ERR("BAD_DIR");
       return 0;
     }
-    if (g->board[slot][cy][cx] == 1) {
-      snprintf(err, errsz, "OVERLAP");
+    int s = 0;
+    while (s < g->fleet && (g->ship_len[s] != ps.len || ((used >> s) & 1u)))
+      s++;
+    if (s == g->fleet) {
+      SET_ERR("SHIP_NOT_AVAILABLE");
+      return 0;
+    }
+    int k = place_index(n, ps.x, ps.y, ps.len, ps.dir);
+    if (k < 0) {
+      SET_ERR("OUT_OF_BOUNDS");
+      return 0;
+    }
+    const Bitboard *m = &place_tab[g->variant][ps.len][k];
+    if (bb_intersects(&occ, m, nw)) {
+      SET_ERR("OVERLAP");
       return 0;
     }
+    bb_or(&occ, m, nw);
+    used |= 1u << s;
+    norm[s] = ps; // pořadí podle ship slotů (sid = slot + 1)
   }
+  return 1;
+}
 
-  // Umístění lodě + zapsání ship_id, aby šlo později zjistit, která loď se potopila
-  unsigned char sid = (unsigned char)(ship_slot + 1);
-  for (int i = 0; i < len; i++) {
-    int cx = x + (dir == 'H' ? i : 0);
-    int cy = y + (dir == 'V' ? i : 0);
-    g->board[slot][cy][cx] = 1;
-    g->ship_id[slot][cy][cx] = sid;
+int game_place_fleet(Game *g, int slot, const PendingShip ships[], int count,
+                     char *err, int errsz) {
+  TRACE_SCOPE("game_place_fleet", slot);
+  if (!g || !g->in_use) {
+    SET_ERR("NO_GAME");
+    return 0;
+  }
+  if (g->finished) {
+    SET_ERR("GAME_FINISHED");
+    return 0;
+  }
+  if (slot < 0 || slot > 1) {
+    SET_ERR("BAD_SLOT");
+    return 0;
+  }
+  if (g->ready[slot]) {
+    SET_ERR("ALREADY_READY");
+    return 0;
+  }
+  if (count != g->fleet) {
+    if (count < g->fleet)
+      SET_ERR("INCOMPLETE");
+    else
+      SET_ERR("TOO_MANY");
+    return 0;
   }
 
-  g->ship_used[slot][ship_slot] = 1;
-  g->ships_left_count[slot][ship_slot] = len;
-  g->ships_alive[slot] += len;
-
-  snprintf(err, errsz, "OK");
+  place_init();
+  PendingShip norm[GAME_FLEET_MAX];
+  int ok = 0;
+  GAME_SPECIALIZE(g, ok = fleet_check(g, ships, norm, err, errsz, N));
+  if (!ok)
+    return 0; // deska hráče zůstala beze změny
+
+  // Validní celá flotila -> teprve teď se přepíše předchozí rozmístění
+  game_clear_player_setup(g, slot);
+  for (int s = 0; s < g->fleet; s++) {
+    const PendingShip *ps = &norm[s];
+    for (int i = 0; i < ps->len; i++) {
+      int cx = ps->x + (ps->dir == 'H' ? i : 0);
+      int cy = ps->y + (ps->dir == 'V' ? i : 0);
+      g->board[slot][cy][cx] = 1;
+      g->ship_id[slot][cy][cx] = (unsigned char)(s + 1);
+      txt_set(g, slot, cx, cy, 'S', '.');
+    }
+    g->ship_used[slot][s] = 1;
+    g->ships_left_count[slot][s] = ps->len;
+    g->ships_alive[slot] += ps->len;
+  }
+  SET_ERR("OK");
   return 1;
 }
 
+// Rovnoměrně náhodná legální flotila: každá loď dostane náhodný index
+// z tabulky, při prvním překryvu se začíná znovu (zamítací výběr, takže
+// každé rozmístění je stejně pravděpodobné)
+GAME_KERNEL int fleet_random(const Game *g, uint64_t *rng, PendingShip out[],
+                             const int n) {
+  const int nw = BB_WORDS_FOR(n);
+  for (int attempt = 0; attempt < 100000; attempt++) {
+    Bitboard occ;
+    bb_clear(&occ, nw);
+    int s = 0;
+    for (; s < g->fleet; s++) {
+      int len = g->ship_len[s];
+      int k = (int)rng_below(rng, (unsigned)place_count[g->variant][len]);
+      const Bitboard *m = &place_tab[g->variant][len][k];
+      if (bb_intersects(&occ, m, nw))
+        break;
+      bb_or(&occ, m, nw);
+
+      int span = n - len + 1;
+      int h = k < n * span;
+      int kk = h ? k : k - n * span;
+      out[s].x = h ? kk % span : kk % n;
+      out[s].y = h ? kk / span : kk / n;
+      out[s].len = len;
+      out[s].dir = h ? 'H' : 'V';
+    }
+    if (s == g->fleet)
+      return 1;
+  }
+  return 0;
+}
+
+int game_random_fleet(const Game *g, uint64_t *rng,
+                      PendingShip out[GAME_FLEET_MAX]) {
+  if (!g || !g->in_use)
+    return 0;
+  place_init();
+  int ok = 0;
+  GAME_SPECIALIZE(g, ok = fleet_random(g, rng, out, N));
+  return ok;
+}
+
 static int fleet_complete(const Game *g, int slot) {
-  for (int s = 0; s < GAME_FLEET; s++) {
+  for (int s = 0; s < g->fleet; s++) {
     if (g->ship_used[slot][s] == 0) return 0;
   }
   return 1;
 }
 
 int game_set_ready(Game *g, int slot, char *err, int errsz) {
+  TRACE_SCOPE("game_set_ready", slot);
   if (!g || !g->in_use) {
-    snprintf(err, errsz, "NO_GAME");
+    SET_ERR("NO_GAME");
     return 0;
   }
   if (slot < 0 || slot > 1) {
-    snprintf(err, errsz, "BAD_SLOT");
+    SET_ERR("BAD_SLOT");
     return 0;
   }
   if (g->ready[slot]) {
-    snprintf(err, errsz, "ALREADY_READY");
+    SET_ERR("ALREADY_READY");
     return 0;
   }
   if (!fleet_complete(g, slot)) {
-    snprintf(err, errsz, "FLEET_INCOMPLETE");
+    SET_ERR("FLEET_INCOMPLETE");
     return 0;
   }
 
   g->ready[slot] = 1;
-  snprintf(err, errsz, "OK");
+  if (game_all_ready(g)) {
+    g->started_at = net_now();
+    if (g->salvo)
+      g->salvo_left = game_salvo_size(g, g->turn);
+  }
+  SET_ERR("OK");
   return 1;
 }
 
 static int ship_is_sunk(const Game *g, int victim_slot, unsigned char sid) {
   int ship_slot = (int)sid - 1;
-  if (ship_slot < 0 || ship_slot >= GAME_FLEET) return 0;
+  if (ship_slot < 0 || ship_slot >= g->fleet) return 0;
   return g->ships_left_count[victim_slot][ship_slot] == 0;
 }
 
-int game_shoot(Game *g, int slot, int x, int y, char *err, int errsz) {
+int game_salvo_size(const Game *g, int slot) {
+  if (!g || slot < 0 || slot > 1)
+    return 0;
+  int alive = 0;
+  for (int s = 0; s < g->fleet; s++)
+    if (g->ships_left_count[slot][s] > 0)
+      alive++;
+  // Ke konci nemusí zbýt tolik nestřelených buněk (každý výstřel je jiná)
+  int left = g->n * g->n - g->shots[slot];
+  return alive < left ? alive : left;
+}
+
+// Tah po výstřelu: v salvě až po posledním výstřelu, pak se hned spočítá
+// velikost salvy soupeře (jeho živé lodě)
+static void pass_turn(Game *g, int slot) {
+  if (g->salvo && --g->salvo_left > 0)
+    return;
+  g->turn = 1 - slot;
+  if (g->salvo)
+    g->salvo_left = game_salvo_size(g, g->turn);
+}
+
+// Společné podmínky výstřelu i salvy
+static int shot_allowed(const Game *g, int slot, char *err, int errsz) {
   if (!g || !g->in_use) {
-    snprintf(err, errsz, "NO_GAME");
-    return -1;
+    SET_ERR("NO_GAME");
+    return 0;
   }
   if (g->finished) {
-    snprintf(err, errsz, "GAME_FINISHED");
-    return -1;
+    SET_ERR("GAME_FINISHED");
+    return 0;
   }
   if (!game_all_ready(g)) {
-    snprintf(err, errsz, "NOT_READY");
-    return -1;
+    SET_ERR("NOT_READY");
+    return 0;
   }
   if (slot != g->turn) {
-    snprintf(err, errsz, "NOT_YOUR_TURN");
-    return -1;
-  }
-  if (!in_bounds(x, y)) {
-    snprintf(err, errsz, "OUT_OF_BOUNDS");
-    return -1;
+    SET_ERR("NOT_YOUR_TURN");
+    return 0;
   }
+  return 1;
+}
 
+// Zápis už ověřeného výstřelu do desky soupeře (tah neřeší):
+// 0 voda, 1 zásah, 2 potopení, 3 výhra
+static int apply_shot(Game *g, int slot, int x, int y) {
   int enemy = (slot == 0) ? 1 : 0;
-  unsigned char cell = g->board[enemy][y][x];
-
-  if (cell == 2 || cell == 3) {
-    snprintf(err, errsz, "ALREADY_SHOT");
-    return -1;
-  }
+  g->shots[slot]++;
 
-  if (cell == 0) {
+  if (g->board[enemy][y][x] == 0) {
     g->board[enemy][y][x] = 3; // miss
-    g->turn = enemy;
-    snprintf(err, errsz, "OK");
+    txt_set(g, enemy, x, y, 'M', 'M');
     return 0; // water
   }
 
   // cell == 1
   g->board[enemy][y][x] = 2; // hit
+  g->hits[slot]++;
+  txt_set(g, enemy, x, y, 'H', 'H');
   g->ships_alive[enemy] -= 1;
 
   unsigned char sid = g->ship_id[enemy][y][x];
   int ship_slot = (int)sid - 1;
-  if (ship_slot >= 0 && ship_slot < GAME_FLEET) {
+  if (ship_slot >= 0 && ship_slot < g->fleet) {
     if (g->ships_left_count[enemy][ship_slot] > 0)
       g->ships_left_count[enemy][ship_slot] -= 1;
   }
@@ -222,76 +534,179 @@ int game_shoot(Game *g, int slot, int x, int y, char *err, int errsz) {
   if (g->ships_alive[enemy] == 0) {
     g->finished = 1;
     g->winner = slot;
-    snprintf(err, errsz, "OK");
     return 3; // win
   }
+  return ship_is_sunk(g, enemy, sid) ? 2 : 1; // sink / hit
+}
+
+int game_shoot(Game *g, int slot, int x, int y, char *err, int errsz) {
+  TRACE_SCOPE("game_shoot", slot);
+  if (!shot_allowed(g, slot, err, errsz))
+    return -1;
+
+  int inside = 0;
+  GAME_SPECIALIZE(g, inside = in_bounds(x, y, N));
+  if (!inside) {
+    SET_ERR("OUT_OF_BOUNDS");
+    return -1;
+  }
 
-  if (ship_is_sunk(g, enemy, sid)) {
-    g->turn = enemy;
-    snprintf(err, errsz, "OK");
-    return 2; // sink
+  int enemy = (slot == 0) ? 1 : 0;
+  unsigned char cell = g->board[enemy][y][x];
+  if (cell == 2 || cell == 3) {
+    SET_ERR("ALREADY_SHOT");
+    return -1;
   }
 
-  g->turn = enemy;
-  snprintf(err, errsz, "OK");
-  return 1; // hit
+  int res = apply_shot(g, slot, x, y);
+  PROBE5(shot, g->room_id, slot, x, y, res);
+  if (res != 3)
+    pass_turn(g, slot);
+  SET_ERR("OK");
+  return res;
 }
 
-static void send_board_self(const Game *g, int slot, Player *to) {
-  char line[128];
-  for (int y = 0; y < GAME_N; y++) {
-    char row[GAME_N + 1];
-    for (int x = 0; x < GAME_N; x++) {
-      unsigned char c = g->board[slot][y][x];
-      row[x] = (c == 0) ? '.' : (c == 1) ? 'S' : (c == 2) ? 'H' : 'M';
-    }
-    row[GAME_N] = '\0';
-    snprintf(line, sizeof(line), "BSELF %d %s\n", y, row);
-    net_send_all(to->socket_fd, line);
+int game_salvo(Game *g, int slot, GameShot shots[], int count, char *err,
+               int errsz) {
+  TRACE_SCOPE("game_salvo", slot);
+  if (!shot_allowed(g, slot, err, errsz))
+    return -1;
+  if (!g->salvo) {
+    SET_ERR("NOT_SALVO");
+    return -1;
+  }
+  if (count != g->salvo_left) {
+    SET_ERR("SALVO_SIZE");
+    return -1;
   }
-}
 
-static void send_board_enemy_view(const Game *g, int slot, Player *to) {
+  // Nejdřív celá validace, deska se mění až když projde všechno
   int enemy = (slot == 0) ? 1 : 0;
-  char line[128];
-  for (int y = 0; y < GAME_N; y++) {
-    char row[GAME_N + 1];
-    for (int x = 0; x < GAME_N; x++) {
-      unsigned char c = g->board[enemy][y][x];
-      row[x] = (c == 2) ? 'H' : (c == 3) ? 'M' : '.';
+  for (int i = 0; i < count; i++) {
+    int x = shots[i].x, y = shots[i].y, inside = 0;
+    GAME_SPECIALIZE(g, inside = in_bounds(x, y, N));
+    if (!inside) {
+      SET_ERR("OUT_OF_BOUNDS");
+      return -1;
+    }
+    if (g->board[enemy][y][x] >= 2) {
+      SET_ERR("ALREADY_SHOT");
+      return -1;
     }
-    row[GAME_N] = '\0';
-    snprintf(line, sizeof(line), "BENEMY %d %s\n", y, row);
-    net_send_all(to->socket_fd, line);
+    for (int j = 0; j < i; j++) {
+      if (shots[j].x == x && shots[j].y == y) {
+        SET_ERR("DUPLICATE");
+        return -1;
+      }
+    }
+  }
+
+  int fired = 0;
+  for (int i = 0; i < count; i++)
+    shots[i].res = -1;
+  while (fired < count && !g->finished) {
+    GameShot *s = &shots[fired++];
+    s->res = apply_shot(g, slot, s->x, s->y);
+    PROBE5(shot, g->room_id, slot, s->x, s->y, s->res);
+    if (s->res != 3)
+      pass_turn(g, slot);
   }
+  SET_ERR("OK");
+  return fired;
 }
 
 void game_send_state(const Game *g, const Room *r, Player *to) {
+  TRACE_SCOPE("game_send_state", to ? to->socket_fd : -1);
   if (!g || !r || !to || to->socket_fd < 0) return;
 
-  char line[256];
-  snprintf(line, sizeof(line), "PHASE %s\n", room_phase_str(r->phase));
-  net_send_all(to->socket_fd, line);
+  // Celý dump (fáze, STATE, obě desky) se skládá do jednoho bufferu
+  char buf[GAME_STATE_BUF];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "PHASE ");
+  wire_str(&w, room_phase_str(r->phase));
+  wire_char(&w, '\n');
 
   if (!g->in_use) {
-    net_send_all(to->socket_fd, "STATE NO_GAME\n");
+    wire_lit(&w, "STATE NO_GAME\n");
+    net_send(to->socket_fd, w.p, w.len);
     return;
   }
 
   int slot = to->player_slot;
   if (slot < 0 || slot > 1) slot = 0;
 
-  snprintf(line, sizeof(line),
-           "STATE ROOM=%d YOU=%d READY=%d/%d TURN=%d FIN=%d WIN=%d\n", r->id,
-           slot + 1, g->ready[0], g->ready[1], g->turn + 1, g->finished ? 1 : 0,
-           g->finished ? (g->winner + 1) : 0);
-  net_send_all(to->socket_fd, line);
+  wire_lit(&w, "STATE ROOM=");
+  wire_int(&w, r->id);
+  wire_lit(&w, " YOU=");
+  wire_int(&w, slot + 1);
+  wire_lit(&w, " READY=");
+  wire_int(&w, g->ready[0]);
+  wire_char(&w, '/');
+  wire_int(&w, g->ready[1]);
+  wire_lit(&w, " TURN=");
+  wire_int(&w, g->turn + 1);
+  wire_lit(&w, " FIN=");
+  wire_int(&w, g->finished ? 1 : 0);
+  wire_lit(&w, " WIN=");
+  wire_int(&w, g->finished ? (g->winner + 1) : 0);
+  wire_char(&w, '\n');
+
+  wire_put(&w, g->txt_self[slot], g->txt_self_len);
+  wire_put(&w, g->txt_enemy[1 - slot], g->txt_enemy_len);
+  net_send(to->socket_fd, w.p, w.len);
+}
+
+GAME_KERNEL int render_public(const Game *g, char *out, int outsz,
+                              const int n) {
+  Wire w = {out, 0, (size_t)outsz, 0};
+  for (int slot = 0; slot < 2; slot++) {
+    for (int y = 0; y < n; y++) {
+      // Řádek veřejného pohledu = řádek z BENEMY bloku
+      const char *row =
+          g->txt_enemy[slot] + txt_cell(sizeof(TXT_ENEMY_TAG) - 1, n, 0, y);
+
+      size_t mark = w.len;
+      wire_lit(&w, "SPEC_BOARD ");
+      wire_int(&w, slot + 1);
+      wire_char(&w, ' ');
+      wire_int(&w, y);
+      wire_char(&w, ' ');
+      wire_put(&w, row, (size_t)n);
+      wire_char(&w, '\n');
+      if (w.full || w.len == w.cap) // jen celé řádky (a místo pro '\0')
+        return (int)mark;
+    }
+  }
+  return (int)w.len;
+}
+
+int game_render_public(const Game *g, char *out, int outsz) {
+  TRACE_SCOPE("game_render_public", g ? g->room_id : -1);
+  // Veřejný pohled na obě desky (jen zásahy/minutí, lodě skryté) pro spectatory
+  if (!g || !g->in_use || outsz <= 0)
+    return 0;
+
+  int len = 0;
+  GAME_SPECIALIZE(g, len = render_public(g, out, outsz, N));
+  return len;
+}
 
-  send_board_self(g, slot, to);
-  send_board_enemy_view(g, slot, to);
+void game_send_your_turn(const Game *g, int fd) {
+  if (!g->salvo) {
+    net_send_lit(fd, "YOUR_TURN\n");
+    return;
+  }
+  // V salvě hráč rovnou ví, kolik výstřelů má poslat
+  char buf[32];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "YOUR_TURN ");
+  wire_int(&w, g->salvo_left);
+  wire_char(&w, '\n');
+  net_send(fd, w.p, w.len);
 }
 
 void game_send_turn(const Game *g, const Room *r, Player players[]) {
+  TRACE_SCOPE("game_send_turn", r ? r->id : -1);
   (void)players; // parametr je tu kvůli starému rozhraní, teď ho nepotřebujeme
 
   if (!g || !r) return;
@@ -302,15 +717,38 @@ void game_send_turn(const Game *g, const Room *r, Player players[]) {
     if (fd < 0) continue; // slot prázdný
 
     if (g->turn == slot) {
-      net_send_all(fd, "YOUR_TURN\n");
+      game_send_your_turn(g, fd);
       log_info("Turn -> slot=%d fd=%d YOUR_TURN", slot, fd);
     } else {
-      net_send_all(fd, "OPP_TURN\n");
+      net_send_lit(fd, "OPP_TURN\n");
       log_info("Turn -> slot=%d fd=%d OPP_TURN", slot, fd);
     }
   }
 }
 
+GAME_KERNEL int ship_bbox(const Game *g, int victim_slot, unsigned char sid,
+                          int *minx, int *miny, int *maxx, int *maxy,
+                          const int n) {
+  int count = 0;
+  *minx = n;
+  *miny = n;
+  *maxx = -1;
+  *maxy = -1;
+
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < n; x++) {
+      if (g->ship_id[victim_slot][y][x] == sid) {
+        count++;
+        if (x < *minx) *minx = x;
+        if (y < *miny) *miny = y;
+        if (x > *maxx) *maxx = x;
+        if (y > *maxy) *maxy = y;
+      }
+    }
+  }
+  return count;
+}
+
 int game_ship_def_from_sid(const Game *g, int victim_slot, unsigned char sid,
                            int *out_x, int *out_y, int *out_len,
                            char *out_dir) {
@@ -318,20 +756,10 @@ int game_ship_def_from_sid(const Game *g, int victim_slot, unsigned char sid,
   if (victim_slot < 0 || victim_slot > 1) return 0;
   if (sid == 0) return 0;
 
-  int minx = GAME_N, miny = GAME_N, maxx = -1, maxy = -1;
+  int minx, miny, maxx, maxy;
   int count = 0;
-
-  for (int y = 0; y < GAME_N; y++) {
-    for (int x = 0; x < GAME_N; x++) {
-      if (g->ship_id[victim_slot][y][x] == sid) {
-        count++;
-        if (x < minx) minx = x;
-        if (y < miny) miny = y;
-        if (x > maxx) maxx = x;
-        if (y > maxy) maxy = y;
-      }
-    }
-  }
+  GAME_SPECIALIZE(g, count = ship_bbox(g, victim_slot, sid, &minx, &miny, &maxx,
+                                       &maxy, N));
 
   if (count <= 0) return 0;
 
@@ -371,14 +799,19 @@ void game_send_sunk_def(const Game *g, int victim_slot, unsigned char sid,
   char dir;
   if (!game_ship_def_from_sid(g, victim_slot, sid, &x, &y, &len, &dir)) return;
 
-  char line[64];
-
-  if (shooter) {
-    snprintf(line, sizeof(line), "SUNK %d %d %d %c\n", x, y, len, dir);
-    net_send_all(shooter->socket_fd, line);
-  }
-  if (victim) {
-    snprintf(line, sizeof(line), "OPP_SUNK %d %d %d %c\n", x, y, len, dir);
-    net_send_all(victim->socket_fd, line);
-  }
+  // "OPP_SUNK x y len dir\n"; střelec dostane totéž bez prefixu "OPP_"
+  char buf[48];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "OPP_SUNK ");
+  wire_int(&w, x);
+  wire_char(&w, ' ');
+  wire_int(&w, y);
+  wire_char(&w, ' ');
+  wire_int(&w, len);
+  wire_char(&w, ' ');
+  wire_char(&w, dir);
+  wire_char(&w, '\n');
+
+  if (shooter) net_send(shooter->socket_fd, w.p + 4, w.len - 4);
+  if (victim) net_send(victim->socket_fd, w.p, w.len);
 }
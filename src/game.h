@@ -3,38 +3,140 @@
 #include "lobby.h"
 #include "net.h"
 
-#define GAME_N 10
-#define GAME_FLEET 5
+// Maximální rozměry přes všechny varianty (pole v Game jsou pevná)
+#define GAME_N_MAX 16
+#define GAME_FLEET_MAX 8
+#define GAME_STATE_BUF 1536 // PHASE + STATE + 2 desky GAME_N_MAX (jedním send)
+// Blok řádků jedné desky "BENEMY y ROW\n" x GAME_N_MAX (nejdelší tag)
+#define GAME_BOARD_TXT (GAME_N_MAX * (6 + 1 + 2 + 1 + GAME_N_MAX + 1))
 
+typedef enum {
+  GAME_VARIANT_CLASSIC = 0, // 10x10, 5 lodí
+  GAME_VARIANT_QUICK = 1,   // 8x8, 4 lodě
+  GAME_VARIANT_LARGE = 2,   // 16x16, 8 lodí
+  GAME_VARIANT_COUNT
+} GameVariantId;
+
+// Rozměry variant jako konstanty: jádra desky se pro každou specializují
+#define GAME_N_CLASSIC 10
+#define GAME_N_QUICK 8
+#define GAME_N_LARGE 16
+
+// Jádro desky psané pro konstantní N: GAME_SPECIALIZE ho rozvine do jedné
+// větve na variantu, takže kompilátor zná rozměr a klasika neplatí za
+// obecnost (žádné runtime n v smyčkách ani kontrolách hranic)
+#define GAME_KERNEL static inline __attribute__((always_inline))
+
+#define GAME_SPECIALIZE(g, stmt)                                               \
+  do {                                                                         \
+    switch ((g)->variant) {                                                    \
+    case GAME_VARIANT_QUICK: {                                                 \
+      enum { N = GAME_N_QUICK };                                               \
+      stmt;                                                                    \
+    } break;                                                                   \
+    case GAME_VARIANT_LARGE: {                                                 \
+      enum { N = GAME_N_LARGE };                                               \
+      stmt;                                                                    \
+    } break;                                                                   \
+    default: {                                                                 \
+      enum { N = GAME_N_CLASSIC };                                             \
+      stmt;                                                                    \
+    } break;                                                                   \
+    }                                                                          \
+  } while (0)
+
+typedef struct GameVariant {
+  const char *name;
+  int n;
+  int fleet;
+  int ship_len[GAME_FLEET_MAX];
+} GameVariant;
+
+extern const GameVariant game_variants[GAME_VARIANT_COUNT];
+
+int game_variant_from_str(const char *s);
+
+// Skalární stav tahu na začátku (jedna cache line), pak desky a nakonec
+// předrenderované řádky, které se čtou jen při STATE/spectate
 typedef struct Game {
-  int in_use;
+  _Alignas(CACHE_LINE) int in_use;
   int room_id;
 
-  unsigned char board[2][GAME_N][GAME_N];
-  unsigned char ship_id[2][GAME_N][GAME_N];
-
-  int ship_len[GAME_FLEET];
-  int ship_used[2][GAME_FLEET];
-  int ships_left_count[2][GAME_FLEET];
-  int ships_alive[2];
+  int variant; // GameVariantId (index, ne ukazatel -> Game zůstává POD)
+  int n;       // strana desky varianty
+  int fleet;   // počet lodí varianty
 
   int ready[2];
   int turn;
   int finished;
   int winner;
+  int ships_alive[2];
+
+  int salvo;      // 1 = tah je salva, jeden výstřel za každou živou loď
+  int salvo_left; // kolik výstřelů ještě zbývá hráči na tahu
+
+  unsigned journal_id; // 0 = hra se nezaznamenává
+
+  int ship_len[GAME_FLEET_MAX];
+  int ship_used[2][GAME_FLEET_MAX];
+  int ships_left_count[2][GAME_FLEET_MAX];
+
+  // Pro statistiky dohrané hry
+  int shots[2];
+  int hits[2];
+  time_t started_at; // kdy byli oba ready (začátek PLAY)
+
+  unsigned char board[2][GAME_N_MAX][GAME_N_MAX];
+  unsigned char ship_id[2][GAME_N_MAX][GAME_N_MAX];
+
+  // Předrenderované řádky desek přesně ve tvaru pro STATE; každá změna
+  // buňky přepíše jeden znak, dump desky je pak jen memcpy
+  char txt_self[2][GAME_BOARD_TXT];  // "BSELF y ROW\n", jak ji vidí majitel
+  char txt_enemy[2][GAME_BOARD_TXT]; // "BENEMY y ROW\n", lodě skryté
+  unsigned short txt_self_len;
+  unsigned short txt_enemy_len;
 } Game;
 
+_Static_assert(offsetof(Game, journal_id) + sizeof(unsigned) <= CACHE_LINE,
+               "skalární stav Game se nevejde do jedné cache line");
+
 void game_reset(Game *g);
-void game_room_init(Game *g, int room_id);
+void game_room_init(Game *g, int room_id, int variant);
 void game_clear_player_setup(Game *g, int slot);
 
 int game_all_ready(const Game *g);
 int game_place_ship(Game *g, int slot, int x, int y, int len, char dir,
                     char *err, int errsz);
+// Celá flotila naráz (počet = flotila varianty); validace přes tabulky
+// masek, při chybě zůstane deska hráče beze změny
+int game_place_fleet(Game *g, int slot, const PendingShip ships[], int count,
+                     char *err, int errsz);
+// Rovnoměrně náhodná legální flotila do out (na desku nic nezapisuje)
+int game_random_fleet(const Game *g, uint64_t *rng,
+                      PendingShip out[GAME_FLEET_MAX]);
 int game_set_ready(Game *g, int slot, char *err, int errsz);
+// V režimu salvy se tah předá až po salvo_left výstřelech (po jednom se
+// salva přehrává ze žurnálu a WAL)
 int game_shoot(Game *g, int slot, int x, int y, char *err, int errsz);
 
+// Salva: výstřely se ověří všechny předem (počet = game_salvo_size, žádný
+// mimo desku, dvakrát ani do už střelené buňky) a teprve pak se zapíšou;
+// tah přejde jednou na konci. res každého výstřelu jako u game_shoot, po
+// výhře zbylé výstřely dostanou -1. Vrací počet vypálených, -1 = chyba.
+typedef struct GameShot {
+  int x, y;
+  int res;
+} GameShot;
+
+// Živé lodě hráče slot, nejvýš kolik mu zbývá nestřelených buněk
+int game_salvo_size(const Game *g, int slot);
+int game_salvo(Game *g, int slot, GameShot shots[], int count, char *err,
+               int errsz);
+
 void game_send_state(const Game *g, const Room *r, Player *to);
+int game_render_public(const Game *g, char *out, int outsz);
+// "YOUR_TURN\n", v salvě "YOUR_TURN k\n" (k = počet výstřelů salvy)
+void game_send_your_turn(const Game *g, int fd);
 void game_send_turn(const Game *g, const Room *r, Player players[]);
 
 int game_ship_def_from_sid(const Game *g, int victim_slot, unsigned char sid,
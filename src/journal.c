@@ -0,0 +1,183 @@
+#define _POSIX_C_SOURCE 200112L
+#include "journal.h"
+#include "log.h"
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static int j_fd = -1;
+static unsigned char j_buf[JOURNAL_BUF_SIZE];
+static size_t j_len = 0;
+static unsigned j_next_gid = 1;
+static time_t j_last_flush = 0;
+
+size_t varint_put(unsigned char *p, uint64_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (unsigned char)v;
+  return n;
+}
+
+int varint_get(const unsigned char **p, const unsigned char *end, uint64_t *v) {
+  uint64_t out = 0;
+  int shift = 0;
+  const unsigned char *q = *p;
+  while (q < end && shift < 64) {
+    unsigned char b = *q++;
+    out |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      *v = out;
+      *p = q;
+      return 1;
+    }
+    shift += 7;
+  }
+  return 0;
+}
+
+static void write_all(const unsigned char *s, size_t len) {
+  while (len > 0) {
+    ssize_t w = write(j_fd, s, len);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      log_error("journal write failed (errno=%d), recording disabled", errno);
+      close(j_fd);
+      j_fd = -1;
+      return;
+    }
+    s += w;
+    len -= (size_t)w;
+  }
+}
+
+void journal_flush(int force) {
+  if (j_fd < 0 || j_len == 0)
+    return;
+
+  // Bez force zapisujeme jen větší bloky (nebo jednou za JOURNAL_FLUSH_SEC)
+  time_t now = time(NULL);
+  if (!force && j_len < JOURNAL_FLUSH_AT &&
+      now - j_last_flush < JOURNAL_FLUSH_SEC)
+    return;
+
+  TRACE_SCOPE("flush_journal", (int)j_len);
+  write_all(j_buf, j_len);
+  j_len = 0;
+  j_last_flush = now;
+}
+
+static void append(JournalTag tag, const uint64_t *vals, int n) {
+  if (j_fd < 0)
+    return;
+
+  // Nejhorší případ: tag + n * 10 B varint
+  if (j_len + 1 + (size_t)n * 10 > sizeof(j_buf))
+    journal_flush(1);
+  if (j_fd < 0)
+    return;
+
+  j_buf[j_len++] = (unsigned char)tag;
+  for (int i = 0; i < n; i++)
+    j_len += varint_put(j_buf + j_len, vals[i]);
+}
+
+int journal_open(const char *path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    log_error("journal open '%s' failed (errno=%d)", path, errno);
+    return 0;
+  }
+
+  j_fd = fd;
+  j_len = 0;
+  j_last_flush = time(NULL);
+
+  // Hlavička jen u nového souboru; při restartu se připojuje nová session
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size == 0) {
+    memcpy(j_buf, JOURNAL_MAGIC, 4);
+    j_len = 4;
+  }
+
+  uint64_t v[1] = {(uint64_t)time(NULL)};
+  append(JR_SESSION, v, 1);
+  journal_flush(1);
+
+  log_info("journal recording to '%s'", path);
+  return 1;
+}
+
+void journal_close(void) {
+  if (j_fd < 0)
+    return;
+  journal_flush(1);
+  if (j_fd >= 0)
+    close(j_fd);
+  j_fd = -1;
+}
+
+int journal_enabled(void) { return j_fd >= 0; }
+
+unsigned journal_game_start(int room_id, int variant) {
+  if (j_fd < 0)
+    return 0;
+  unsigned gid = j_next_gid++;
+  uint64_t v[4] = {gid, (uint64_t)room_id, (uint64_t)time(NULL),
+                   (uint64_t)variant};
+  append(JR_GAME, v, 4);
+  return gid;
+}
+
+void journal_salvo(unsigned gid) {
+  if (!gid)
+    return;
+  uint64_t v[1] = {gid};
+  append(JR_SALVO, v, 1);
+}
+
+void journal_place(unsigned gid, int slot, int x, int y, int len, char dir) {
+  if (!gid)
+    return;
+  uint64_t v[6] = {gid, (uint64_t)slot, (uint64_t)x, (uint64_t)y,
+                   (uint64_t)len, (dir == 'V' || dir == 'v') ? 1u : 0u};
+  append(JR_PLACE, v, 6);
+}
+
+void journal_ready(unsigned gid, int slot) {
+  if (!gid)
+    return;
+  uint64_t v[2] = {gid, (uint64_t)slot};
+  append(JR_READY, v, 2);
+}
+
+void journal_shot(unsigned gid, int slot, int x, int y) {
+  // Výstřel je nejčastější záznam: přímý zápis bez obecného append()
+  if (!gid || j_fd < 0)
+    return;
+  if (j_len + 1 + 2 * 10 > sizeof(j_buf)) {
+    journal_flush(1);
+    if (j_fd < 0)
+      return;
+  }
+
+  unsigned char *p = j_buf + j_len;
+  *p++ = JR_SHOT;
+  p += varint_put(p, gid);
+  p += varint_put(p, ((uint64_t)y << 6) | ((uint64_t)x << 1) | (uint64_t)slot);
+  j_len = (size_t)(p - j_buf);
+}
+
+void journal_game_end(unsigned gid, int winner) {
+  if (!gid)
+    return;
+  uint64_t v[2] = {gid, (uint64_t)winner};
+  append(JR_END, v, 2);
+}
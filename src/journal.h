@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binární žurnál her: záznam = tag (1 B) + varint pole.
+// Zápis jde do paměťového bufferu, na disk se posílá velkými bloky
+// z hlavní smyčky (journal_flush), nikdy z obsluhy příkazu.
+
+#define JOURNAL_MAGIC "BSJ1"
+#define JOURNAL_BUF_SIZE (64 * 1024)
+#define JOURNAL_FLUSH_AT (32 * 1024)
+#define JOURNAL_FLUSH_SEC 1
+
+typedef enum {
+  JR_SESSION = 1, // start serveru: unix time
+  JR_GAME = 2,    // gid, room_id, unix time, variant
+  JR_PLACE = 3,   // gid, slot, x, y, len, dir (0=H, 1=V)
+  JR_READY = 4,   // gid, slot
+  JR_SHOT = 5,    // gid, (y << 6 | x << 1 | slot) -- nejčastější, proto sbalený
+  JR_END = 6,     // gid, winner slot
+  JR_SALVO = 7    // gid -- hra se hraje na salvy (hned po JR_GAME)
+} JournalTag;
+
+int journal_open(const char *path);
+void journal_close(void);
+int journal_enabled(void);
+
+unsigned journal_game_start(int room_id, int variant);
+void journal_salvo(unsigned gid);
+void journal_place(unsigned gid, int slot, int x, int y, int len, char dir);
+void journal_ready(unsigned gid, int slot);
+void journal_shot(unsigned gid, int slot, int x, int y);
+void journal_game_end(unsigned gid, int winner);
+
+void journal_flush(int force);
+
+size_t varint_put(unsigned char *p, uint64_t v);
+int varint_get(const unsigned char **p, const unsigned char *end, uint64_t *v);
@@ -0,0 +1,144 @@
+#define _POSIX_C_SOURCE 200112L
+#include "live.h"
+#include "load.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+LiveCounters live_counters;
+
+static LiveFile *lf = NULL;
+static char lf_name[64];
+static uint64_t last_pub_ms = 0;
+
+static uint64_t mono_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+int live_open(const char *name) {
+  snprintf(lf_name, sizeof(lf_name), "%s%s", name[0] == '/' ? "" : "/", name);
+
+  int fd = shm_open(lf_name, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    log_error("live: shm_open '%s' failed (errno=%d)", lf_name, errno);
+    return 0;
+  }
+  // Segment po předchozím běhu se přepíše (velikost i obsah)
+  if (ftruncate(fd, 0) != 0 || ftruncate(fd, sizeof(LiveFile)) != 0) {
+    log_error("live: cannot size '%s' (errno=%d)", lf_name, errno);
+    close(fd);
+    shm_unlink(lf_name);
+    return 0;
+  }
+  void *m = mmap(NULL, sizeof(LiveFile), PROT_READ | PROT_WRITE, MAP_SHARED,
+                 fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) {
+    log_error("live: mmap '%s' failed (errno=%d)", lf_name, errno);
+    shm_unlink(lf_name);
+    return 0;
+  }
+
+  lf = m;
+  lf->version = LIVE_VERSION;
+  lf->max_players = MAX_PLAYERS;
+  lf->max_rooms = MAX_ROOMS;
+  lf->pid = (int32_t)getpid();
+  lf->started_at = (int64_t)time(NULL);
+  // magic až nakonec: čtenář, který ho vidí, má i platnou hlavičku
+  __atomic_store_n(&lf->magic, LIVE_MAGIC, __ATOMIC_RELEASE);
+  log_info("live: publishing to shm '%s'", lf_name);
+  return 1;
+}
+
+void live_close(void) {
+  if (!lf)
+    return;
+  munmap(lf, sizeof(*lf));
+  shm_unlink(lf_name);
+  lf = NULL;
+}
+
+static void fill_room(LiveRoom *lr, const Room *r, const Game *g,
+                      const Player players[], time_t now) {
+  memset(lr, 0, sizeof(*lr));
+  lr->id = (r->state == ROOM_EMPTY) ? -1 : r->id;
+  if (lr->id < 0)
+    return;
+  lr->state = r->state;
+  lr->phase = r->phase;
+  lr->variant = r->variant;
+  lr->bot_level = r->bot_level;
+  lr->turn = -1;
+  for (int s = 0; s < 2; s++) {
+    lr->slot_up[s] = r->slot_connected[s];
+    if (!r->slot_connected[s] && r->slot_down_since[s] > 0)
+      lr->down_sec[s] = (int32_t)(now - r->slot_down_since[s]);
+    memcpy(lr->names[s], r->player_names[s], LIVE_NAME - 1);
+  }
+  if (g->in_use && g->room_id == r->id) {
+    if (r->phase == PHASE_PLAY)
+      lr->turn = g->turn;
+    for (int s = 0; s < 2; s++) {
+      lr->ships_alive[s] = g->ships_alive[s];
+      lr->shots[s] = g->shots[s];
+      lr->hits[s] = g->hits[s];
+    }
+  }
+  for (int i = 0; i < MAX_PLAYERS; i++)
+    if (players[i].socket_fd >= 0 && players[i].watching_room_id == r->id)
+      lr->spectators++;
+}
+
+static void fill_player(LivePlayer *lp, const Player *p, time_t now) {
+  memset(lp, 0, sizeof(*lp));
+  lp->fd = p->socket_fd;
+  if (p->socket_fd < 0 && !p->is_identified)
+    return; // volný slot
+  lp->identified = p->is_identified;
+  lp->room = p->current_room_id;
+  lp->slot = p->player_slot;
+  lp->watching = p->watching_room_id;
+  lp->hb_missed = p->hb_missed;
+  lp->hb_age = p->last_ping ? (int32_t)(now - p->last_ping) : 0;
+  lp->strikes = p->invalid_count;
+  lp->outq = p->outq.count;
+  if (p->socket_fd < 0 && p->disconnected_at > 0)
+    lp->down_sec = (int32_t)(now - p->disconnected_at);
+  memcpy(lp->name, p->player_name, LIVE_NAME - 1);
+}
+
+void live_publish(const Room rooms[], const Game games[],
+                  const Player players[]) {
+  live_counters.iterations++;
+  if (!lf)
+    return;
+  uint64_t ms = mono_ms();
+  if (ms - last_pub_ms < LIVE_PERIOD_MS)
+    return;
+  last_pub_ms = ms;
+  time_t now = net_now();
+
+  // Seqlock: lichá hodnota po dobu zápisu, čtenář pak snímek zahodí
+  uint32_t seq = lf->seq;
+  __atomic_store_n(&lf->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  lf->updated_at = (int64_t)now;
+  lf->load_level = load_level();
+  lf->lag_ms = load_lag_ms();
+  lf->counters = live_counters;
+  for (int i = 0; i < MAX_ROOMS; i++)
+    fill_room(&lf->rooms[i], &rooms[i], &games[i], players, now);
+  for (int i = 0; i < MAX_PLAYERS; i++)
+    fill_player(&lf->players[i], &players[i], now);
+
+  __atomic_store_n(&lf->seq, seq + 2, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "common.h"
+#include "game.h"
+#include "lobby.h"
+#include "net.h"
+#include <stdint.h>
+
+// Živý pohled do serveru přes sdílenou paměť (POSIX shm). Smyčka jednou za
+// LIVE_PERIOD_MS přepíše snímek roomek a hráčů pod seqlockem: zapisovatel
+// nikdy nečeká, čtenář (tools/bstop) při souběžném zápisu čte znovu.
+// Server kvůli tomu neobsluhuje žádný příkaz ani spojení.
+
+#define LIVE_MAGIC 0x564c5342u // "BSLV"
+#define LIVE_VERSION 1
+#define LIVE_PERIOD_MS 250
+#define LIVE_NAME 32
+
+typedef struct LiveRoom {
+  int32_t id; // -1 = volná roomka
+  int32_t state;
+  int32_t phase;
+  int32_t variant;
+  int32_t bot_level;
+  int32_t spectators;
+  int32_t slot_up[2];
+  int32_t down_sec[2]; // jak dlouho je slot DOWN (0 = UP)
+  int32_t turn;        // slot na tahu (PLAY), jinak -1
+  int32_t ships_alive[2];
+  int32_t shots[2];
+  int32_t hits[2];
+  char names[2][LIVE_NAME];
+} LiveRoom;
+
+typedef struct LivePlayer {
+  int32_t fd; // -1 = volný slot (ghost čekající na REJOIN má fd -1 a jméno)
+  int32_t identified;
+  int32_t room;
+  int32_t slot;
+  int32_t watching;
+  int32_t hb_missed;
+  int32_t hb_age;  // sekundy od posledního PING
+  int32_t strikes; // invalid_count
+  int32_t outq;    // zprávy ve frontě spectatora
+  int32_t down_sec;
+  char name[LIVE_NAME];
+} LivePlayer;
+
+// Počítadla; smyčka je zvyšuje v obyčejné paměti, do segmentu se kopírují
+// při publikaci
+typedef struct LiveCounters {
+  uint64_t iterations;
+  uint64_t accepted;
+  uint64_t rejected; // přetížení, limit na IP, plný server
+  uint64_t commands;
+  uint64_t games_finished;
+} LiveCounters;
+
+typedef struct LiveFile {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t seq; // seqlock: liché = zápis probíhá
+  uint32_t max_players;
+  uint32_t max_rooms;
+  int32_t pid;
+  int64_t started_at;
+  int64_t updated_at;
+  int32_t load_level;
+  int32_t lag_ms;
+  LiveCounters counters;
+  LiveRoom rooms[MAX_ROOMS];
+  LivePlayer players[MAX_PLAYERS];
+} LiveFile;
+
+extern LiveCounters live_counters;
+
+int live_open(const char *name); // shm_open + mmap; jméno bez '/' se doplní
+void live_close(void);           // odmapuje a smaže segment
+
+// Volá se každou iteraci; snímek se zapíše nejvýš jednou za LIVE_PERIOD_MS
+void live_publish(const Room rooms[], const Game games[],
+                  const Player players[]);
@@ -0,0 +1,76 @@
+#define _POSIX_C_SOURCE 200112L
+#include "load.h"
+#include "log.h"
+#include "net.h"
+#include "wire.h"
+#include <stdint.h>
+#include <time.h>
+
+int load_busy_ms = LOAD_BUSY_MS;
+int load_critical_ms = LOAD_CRITICAL_MS;
+
+static uint64_t iter_t0;  // začátek obsluhy iterace (us), 0 = neměří se
+static uint64_t lag_us;   // EWMA doby obsluhy jedné iterace
+static int level = LOAD_OK;
+static int forced = -1;
+
+static uint64_t mono_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void load_iter_begin(void) { iter_t0 = mono_us(); }
+
+void load_iter_end(void) {
+  if (!iter_t0)
+    return;
+  uint64_t dt = mono_us() - iter_t0;
+  iter_t0 = 0;
+
+  // Náběh hned (jedna dlouhá iterace = lag), pokles pozvolna (EWMA 1/4)
+  if (dt > lag_us)
+    lag_us = dt;
+  else
+    lag_us -= (lag_us - dt) / 4;
+
+  if (load_busy_ms <= 0) {
+    level = LOAD_OK;
+    return;
+  }
+
+  // Hystereze: zpět o úroveň níž až pod polovinou prahu
+  uint64_t busy = (uint64_t)load_busy_ms * 1000u;
+  uint64_t crit = (uint64_t)load_critical_ms * 1000u;
+  int next;
+  if (lag_us >= crit || (level == LOAD_CRITICAL && lag_us >= crit / 2))
+    next = LOAD_CRITICAL;
+  else if (lag_us >= busy || (level != LOAD_OK && lag_us >= busy / 2))
+    next = LOAD_BUSY;
+  else
+    next = LOAD_OK;
+
+  if (next != level)
+    log_warn("load level %d -> %d (loop lag %d ms)", level, next,
+             (int)(lag_us / 1000u));
+  level = next;
+}
+
+int load_level(void) { return forced >= 0 ? forced : level; }
+
+int load_lag_ms(void) { return (int)(lag_us / 1000u); }
+
+int load_retry_sec(void) {
+  return load_level() == LOAD_CRITICAL ? 2 * LOAD_RETRY_SEC : LOAD_RETRY_SEC;
+}
+
+void load_force(int lvl) { forced = lvl; }
+
+void load_send_busy(int fd) {
+  char buf[32];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "ERROR BUSY ");
+  wire_int(&w, load_retry_sec());
+  wire_char(&w, '\n');
+  net_send(fd, w.p, w.len);
+}
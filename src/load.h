@@ -0,0 +1,26 @@
+#pragma once
+
+// Ochrana proti přetížení: smyčka měří, jak dlouho trvá obsloužit jednu
+// iteraci (zpoždění událostí), a podle prahů přepíná úroveň zátěže. Při
+// BUSY se odkládá práce s nízkou prioritou (LIST, WATCH, spectatoři), při
+// CRITICAL se navíc odmítají nová spojení. Hry a heartbeat běží vždy.
+
+#define LOAD_BUSY_MS 50      // výchozí práh pro BUSY (0 = ochrana vypnutá)
+#define LOAD_CRITICAL_MS 200 // výchozí práh pro CRITICAL
+#define LOAD_RETRY_SEC 1     // nápověda pro klienta v "ERROR BUSY <sec>"
+
+typedef enum { LOAD_OK = 0, LOAD_BUSY = 1, LOAD_CRITICAL = 2 } LoadLevel;
+
+extern int load_busy_ms;
+extern int load_critical_ms;
+
+void load_iter_begin(void);
+void load_iter_end(void);
+
+int load_level(void);     // LoadLevel
+int load_lag_ms(void);    // vyhlazené zpoždění smyčky
+int load_retry_sec(void); // za kolik sekund má klient zkusit znovu
+void load_force(int level); // pevná úroveň (simulátor); -1 = zase měřit
+
+// "ERROR BUSY <sec>\n" na fd; pro odmítnuté příkazy i spojení
+void load_send_busy(int fd);
@@ -1,11 +1,18 @@
 #include "lobby.h"
+#include "game.h"
+#include "log.h"
 #include "net.h"
+#include "trace.h"
+#include "wire.h"
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
 
+int lobby_room_base = 0;
+
 void room_reset(Room *r) {
   // Reset celé roomky do výchozího stavu (jako „prázdný slot“)
+  lobby_room_changed(r); // dokud má r->id
   r->state = ROOM_EMPTY;
   r->phase = PHASE_LOBBY;
   r->id = 0;
@@ -20,6 +27,13 @@ void room_reset(Room *r) {
   r->slot_down_since[1] = 0;
 
   r->game_active = 0;
+  r->bot_level = 0;
+  r->variant = GAME_VARIANT_CLASSIC;
+  r->salvo = 0;
+
+  r->phase_since = 0;
+  r->rematch[0] = 0;
+  r->rematch[1] = 0;
 }
 
 static const char *room_state_str(RoomState st) {
@@ -44,6 +58,12 @@ static int room_player_count(const Room *r) {
   return c;
 }
 
+int room_index(const Room *r) {
+  if (!r) return -1;
+  int idx = r->id - lobby_room_base - 1;
+  return (idx >= 0 && idx < MAX_ROOMS) ? idx : -1;
+}
+
 Room *find_room_by_id(Room rooms[], int room_id) {
   for (int i = 0; i < MAX_ROOMS; i++)
     if (rooms[i].state != ROOM_EMPTY && rooms[i].id == room_id)
@@ -54,7 +74,7 @@ Room *find_room_by_id(Room rooms[], int room_id) {
 Room *allocate_room(Room rooms[]) {
   for (int i = 0; i < MAX_ROOMS; i++) {
     if (rooms[i].state == ROOM_EMPTY) {
-      rooms[i].id = i + 1;
+      rooms[i].id = lobby_room_base + i + 1;
       rooms[i].state = ROOM_WAITING;
       rooms[i].phase = PHASE_LOBBY;
 
@@ -68,6 +88,14 @@ Room *allocate_room(Room rooms[]) {
       rooms[i].slot_down_since[1] = 0;
 
       rooms[i].game_active = 0;
+      rooms[i].bot_level = 0;
+      rooms[i].variant = GAME_VARIANT_CLASSIC;
+      rooms[i].salvo = 0;
+
+      rooms[i].phase_since = net_now();
+      rooms[i].rematch[0] = 0;
+      rooms[i].rematch[1] = 0;
+      lobby_room_changed(&rooms[i]);
       return &rooms[i];
     }
   }
@@ -80,9 +108,10 @@ void room_mark_down(Room *r, int slot) {
   // Slot je „DOWN“: zneplatníme fd a uložíme čas výpadku (kvůli timeoutům / rejoin)
   r->slot_connected[slot] = 0;
   if (r->slot_down_since[slot] == 0)
-    r->slot_down_since[slot] = time(NULL);
+    r->slot_down_since[slot] = net_now();
 
   r->player_fds[slot] = -1;
+  lobby_room_changed(r);
 }
 
 void room_mark_up(Room *r, int slot, int fd, const char *nick) {
@@ -96,6 +125,7 @@ void room_mark_up(Room *r, int slot, int fd, const char *nick) {
   if (nick && nick[0]) {
     snprintf(r->player_names[slot], sizeof(r->player_names[slot]), "%s", nick);
   }
+  lobby_room_changed(r);
 }
 
 int room_slot_by_nick(Room *r, const char *nick) {
@@ -107,26 +137,160 @@ int room_slot_by_nick(Room *r, const char *nick) {
   return -1;
 }
 
+// " id hráčů STAV FÁZE P1=.. P2=.. VARIANT=..[ MODE=SALVO]\n" za tagem
+// řádku (ROOM v LIST, ROOM+/ROOM~ v diffech odběru)
+static void wire_room_row(Wire *w, const Room *r) {
+  int v = r->variant;
+  if (v < 0 || v >= GAME_VARIANT_COUNT) v = GAME_VARIANT_CLASSIC;
+
+  wire_char(w, ' ');
+  wire_int(w, r->id);
+  wire_char(w, ' ');
+  wire_int(w, room_player_count(r));
+  wire_char(w, ' ');
+  wire_str(w, room_state_str(r->state));
+  wire_char(w, ' ');
+  wire_str(w, room_phase_str(r->phase));
+  if (r->slot_connected[0]) wire_lit(w, " P1=UP");
+  else wire_lit(w, " P1=DOWN");
+  if (r->slot_connected[1]) wire_lit(w, " P2=UP");
+  else wire_lit(w, " P2=DOWN");
+  wire_lit(w, " VARIANT=");
+  wire_str(w, game_variants[v].name);
+  if (r->salvo)
+    wire_lit(w, " MODE=SALVO");
+  wire_char(w, '\n');
+}
+
 void lobby_send_room_list(int to_fd, Room rooms[]) {
   int count = 0;
   for (int i = 0; i < MAX_ROOMS; i++)
     if (rooms[i].state != ROOM_EMPTY)
       count++;
 
-  char line[200];
-  snprintf(line, sizeof(line), "ROOMS %d\n", count);
-  net_send_all(to_fd, line);
+  // Celý výpis jedním bufferem (MAX_ROOMS řádků se vejde)
+  char buf[64 + MAX_ROOMS * 80];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "ROOMS ");
+  wire_int(&w, count);
+  wire_char(&w, '\n');
 
   for (int i = 0; i < MAX_ROOMS; i++) {
     if (rooms[i].state == ROOM_EMPTY) continue;
+    wire_lit(&w, "ROOM");
+    wire_room_row(&w, &rooms[i]);
+  }
+  net_send(to_fd, w.p, w.len);
+}
+
+// --- LIST SUBSCRIBE ---
+
+// Co odběratelé o roomce naposledy dostali; diff = porovnání s aktuálním
+// stavem, takže víc změn jedné roomky v iteraci odejde jako jeden řádek
+typedef struct LobbyRow {
+  int listed; // 0 = roomka v seznamu není (ostatní pole nulová)
+  int players;
+  RoomState state;
+  RoomPhase phase;
+  int up[2];
+  int variant;
+  int salvo;
+} LobbyRow;
 
-    snprintf(line, sizeof(line), "ROOM %d %d %s %s P1=%s P2=%s\n",
-             rooms[i].id,
-             room_player_count(&rooms[i]),
-             room_state_str(rooms[i].state),
-             room_phase_str(rooms[i].phase),
-             rooms[i].slot_connected[0] ? "UP" : "DOWN",
-             rooms[i].slot_connected[1] ? "UP" : "DOWN");
-    net_send_all(to_fd, line);
+static LobbyRow lobby_rows[MAX_ROOMS];
+static unsigned char lobby_dirty[MAX_ROOMS];
+static int lobby_dirty_any;
+
+void lobby_room_changed(const Room *r) {
+  int idx = room_index(r);
+  if (idx < 0)
+    return;
+  lobby_dirty[idx] = 1;
+  lobby_dirty_any = 1;
+}
+
+static void lobby_row_of(const Room *r, LobbyRow *row) {
+  memset(row, 0, sizeof(*row));
+  if (r->state == ROOM_EMPTY)
+    return;
+  row->listed = 1;
+  row->players = room_player_count(r);
+  row->state = r->state;
+  row->phase = r->phase;
+  row->up[0] = r->slot_connected[0];
+  row->up[1] = r->slot_connected[1];
+  row->variant = r->variant;
+  row->salvo = r->salvo;
+}
+
+static void lobby_drop_slow(Player *p) {
+  // Fronta je plná: odběratel nestíhá, musí si znovu říct o snapshot
+  log_warn("fd=%d lobby subscriber too slow -> unsubscribe", p->socket_fd);
+  lobby_unsubscribe(p);
+  outq_clear(&p->outq);
+  net_send_lit(p->socket_fd, "LIST_END SLOW\n");
+}
+
+void lobby_subscribe(Player *p, Room rooms[]) {
+  if (!p)
+    return;
+  p->lobby_sub = 1;
+  p->spec_watch = 0; // fronta je jedna: dobíhající zpožděný přenos končí
+  p->spec_feed = 0;
+  lobby_send_room_list(p->socket_fd, rooms);
+  net_send_lit(p->socket_fd, "LIST_SUBSCRIBED\n");
+}
+
+void lobby_unsubscribe(Player *p) {
+  if (p)
+    p->lobby_sub = 0;
+}
+
+void lobby_publish(Room rooms[], Player players[]) {
+  if (!lobby_dirty_any)
+    return;
+  TRACE_SCOPE("lobby_publish", 0);
+  lobby_dirty_any = 0;
+
+  char buf[MAX_ROOMS * 80];
+  Wire w = WIRE_INIT(buf);
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    if (!lobby_dirty[i])
+      continue;
+    lobby_dirty[i] = 0;
+
+    LobbyRow now;
+    lobby_row_of(&rooms[i], &now);
+    LobbyRow *was = &lobby_rows[i];
+    if (memcmp(&now, was, sizeof(now)) == 0)
+      continue; // změna se do řádku nepromítla (nebo se vrátila)
+
+    if (now.listed) {
+      wire_str(&w, was->listed ? "ROOM~" : "ROOM+");
+      wire_room_row(&w, &rooms[i]);
+    } else {
+      wire_lit(&w, "ROOM- ");
+      wire_int(&w, lobby_room_base + i + 1);
+      wire_char(&w, '\n');
+    }
+    *was = now;
+  }
+  if (w.len == 0)
+    return;
+
+  // Diff se serializuje jednou, odběratelé dostanou odkaz (jako spectatoři)
+  SharedBuf *b = NULL;
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    Player *p = &players[i];
+    if (p->socket_fd < 0 || !p->lobby_sub)
+      continue;
+    if (!b) {
+      b = sbuf_new(w.p, w.len, net_now());
+      if (!b)
+        return;
+    }
+    if (!outq_push(&p->outq, b))
+      lobby_drop_slow(p);
   }
+  sbuf_release(b);
 }
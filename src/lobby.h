@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.h"
+#include "net.h"
+#include <stddef.h>
 #include <time.h>
 
 typedef enum { ROOM_EMPTY = 0, ROOM_WAITING = 1, ROOM_FULL = 2 } RoomState;
@@ -12,23 +14,39 @@ typedef enum {
   PHASE_FINISHED = 3
 } RoomPhase;
 
+// Horká část (stav, fd, údaje pro reconnect tick) se vejde do první cache line,
+// jména hráčů čte tick až nakonec
 typedef struct Room {
-  int id;
+  _Alignas(CACHE_LINE) int id;
   RoomState state;
   RoomPhase phase;
 
   int player_fds[2];
 
   // reconnect metadata
-  char player_names[2][32];
   int slot_connected[2];
   time_t slot_down_since[2];
 
   // game link
   int game_active;
+  int bot_level; // 0 = dva lidští hráči, jinak BotLevel protivníka v P2
+  int variant;   // GameVariantId zvolená při CREATE
+  int salvo;     // CREATE ... SALVO: tah = salva (Game.salvo)
+
+  char player_names[2][32];
+
+  time_t phase_since; // vstup do aktuální fáze (úklid nečinných roomek)
+  int rematch[2];     // kdo po konci hry poslal REMATCH
 } Room;
 
+_Static_assert(offsetof(Room, salvo) + sizeof(int) <= CACHE_LINE,
+               "horká část Room se nevejde do jedné cache line");
+
+// Posun čísel roomek (backend za gatewayí má vlastní disjunktní rozsah id)
+extern int lobby_room_base;
+
 void room_reset(Room *r);
+int room_index(const Room *r); // index do rooms[]/games[], -1 = neplatné id
 Room *allocate_room(Room rooms[]);
 Room *find_room_by_id(Room rooms[], int room_id);
 
@@ -39,3 +57,17 @@ void room_mark_up(Room *r, int slot, int fd, const char *nick);
 int room_slot_by_nick(Room *r, const char *nick);
 
 void lobby_send_room_list(int to_fd, Room rooms[]);
+
+// LIST SUBSCRIBE: snapshot (jako LIST) + LIST_SUBSCRIBED, pak jen diffy
+// "ROOM+ řádek" (nová), "ROOM~ řádek" (změna), "ROOM- id" (zrušená).
+// Řádek nese celý stav roomky, takže opakovaný diff nic nerozbije.
+// Diffy jdou frontou outq (sdílený buffer), odběr končí vstupem do roomky
+// nebo WATCH (spec_unwatch) a odpojením.
+void lobby_subscribe(Player *p, Room rooms[]);
+void lobby_unsubscribe(Player *p);
+
+// Mutace roomky, kterou může být vidět v seznamu (volají ji room_* funkce
+// a room_set_phase); diff se spočítá až v lobby_publish
+void lobby_room_changed(const Room *r);
+// Z hlavní smyčky: jeden diff za iteraci pro všechny odběratele
+void lobby_publish(Room rooms[], Player players[]);
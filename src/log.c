@@ -3,6 +3,10 @@
 #include <stdio.h>
 #include <time.h>
 
+static int log_quiet = 0;
+
+void log_set_quiet(int quiet) { log_quiet = quiet; }
+
 static void log_common(const char *level, const char *fmt, va_list ap) {
   time_t now = time(NULL);
   struct tm *tm = localtime(&now);
@@ -16,6 +20,8 @@ static void log_common(const char *level, const char *fmt, va_list ap) {
 }
 
 void log_info(const char *fmt, ...) {
+  if (log_quiet)
+    return;
   va_list ap;
   va_start(ap, fmt);
   log_common("INFO", fmt, ap);
@@ -3,3 +3,6 @@
 void log_info(const char *fmt, ...);
 void log_warn(const char *fmt, ...);
 void log_error(const char *fmt, ...);
+
+// Potlačí INFO (simulátor/benchmarky); WARN a ERROR jdou dál
+void log_set_quiet(int quiet);
@@ -1,5 +1,8 @@
 #define _POSIX_C_SOURCE 200112L
 #include "net.h"
+#include "probe.h"
+#include "trace.h"
+#include "wire.h"
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netinet/in.h>
@@ -7,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 static void die(const char *msg) {
@@ -14,11 +18,48 @@ static void die(const char *msg) {
   exit(1);
 }
 
-void net_send_all(int fd, const char *s) {
+// === transport_socket: výchozí implementace nad BSD sockety ===
+
+static ssize_t sock_send(int fd, const char *data, size_t len, int nonblock) {
+  // MSG_NOSIGNAL: zápis do zavřeného spojení nesmí shodit proces (SIGPIPE)
+  return send(fd, data, len, MSG_NOSIGNAL | (nonblock ? MSG_DONTWAIT : 0));
+}
+
+static void sock_close(int fd) { close(fd); }
+
+static time_t sock_now(void) { return time(NULL); }
+
+const Transport transport_socket = {"socket", sock_send, sock_close, sock_now};
+
+static const Transport *transport = &transport_socket;
+
+void net_set_transport(const Transport *t) {
+  transport = t ? t : &transport_socket;
+}
+
+const Transport *net_transport(void) { return transport; }
+
+// === výstupní buffery spojení ===
+// V bufferovaném režimu se odpovědi skládají do bufferu spojení a odchází
+// jedním send() na konci iterace smyčky (net_flush_all), místo send() na
+// každý řádek. Bez net_set_buffered(1) se posílá hned (nástroje, gateway).
+
+typedef struct TxBuf {
+  size_t len;
+  int dirty; // je v seznamu tx_dirty
+  char data[NET_TX_SIZE];
+} TxBuf;
+
+static int tx_buffered = 0;
+static TxBuf *tx[NET_TX_MAX_CONN];
+static int tx_dirty[NET_TX_MAX_CONN];
+static int tx_ndirty = 0;
+
+static void send_raw(int fd, const char *s, size_t len) {
+  TRACE_SCOPE("send", fd);
   // Posíláme celý buffer i když send() vrací jen část (typické u TCP)
-  size_t len = strlen(s);
   while (len > 0) {
-    ssize_t w = send(fd, s, len, 0);
+    ssize_t w = transport->send(fd, s, len, 0);
     if (w < 0) {
       if (errno == EINTR)
         continue; // signál přerušil send, zkusíme to znovu
@@ -29,6 +70,152 @@ void net_send_all(int fd, const char *s) {
   }
 }
 
+// === vstupní buffery spojení ===
+// Drží se podle čísla spojení (jako tx), ne v Player: 4 KB uprostřed struktury
+// by každý sken přes hráče stál samostatnou stránku
+
+static char *rx[NET_TX_MAX_CONN];
+
+char *net_rx_buf(int conn) {
+  if (conn < 0 || conn >= NET_TX_MAX_CONN)
+    return NULL;
+  if (!rx[conn])
+    rx[conn] = malloc(BUF_SIZE);
+  return rx[conn];
+}
+
+void net_set_buffered(int on) {
+  if (!on)
+    net_flush_all();
+  tx_buffered = on;
+}
+
+void net_flush(int conn) {
+  if (conn < 0 || conn >= NET_TX_MAX_CONN || !tx[conn])
+    return;
+  TxBuf *b = tx[conn];
+  if (b->len > 0)
+    send_raw(conn, b->data, b->len);
+  b->len = 0;
+}
+
+void net_flush_all(void) {
+  for (int i = 0; i < tx_ndirty; i++) {
+    int conn = tx_dirty[i];
+    net_flush(conn);
+    if (tx[conn])
+      tx[conn]->dirty = 0;
+  }
+  tx_ndirty = 0;
+}
+
+// === multiplex (MUX) ===
+// Spojení v režimu MUX sedí v mnoha roomkách najednou; každý řádek, který mu
+// odchází v kontextu nějaké roomky, dostane předponu "@rid ". Kontext
+// nastavuje protokol: pevně (příkaz v roomce, tick roomky), nebo podle
+// proměnné (CREATE/JOIN, kdy roomka vznikne až uprostřed příkazu).
+
+static unsigned char tx_mux[NET_TX_MAX_CONN];
+static int tag_room = -1;
+static const int *tag_follow = NULL;
+
+void net_set_mux(int fd, int on) {
+  if (fd >= 0 && fd < NET_TX_MAX_CONN)
+    tx_mux[fd] = on ? 1 : 0;
+}
+
+void net_tag_room(int room_id) {
+  tag_room = room_id;
+  tag_follow = NULL;
+}
+
+void net_tag_follow(const int *room_id) {
+  tag_room = -1;
+  tag_follow = room_id;
+}
+
+void net_tag_clear(void) {
+  tag_room = -1;
+  tag_follow = NULL;
+}
+
+static void tx_append(int fd, const char *data, size_t len);
+
+static void send_tagged(int fd, int room_id, const char *data, size_t len) {
+  char pre[16];
+  Wire w = WIRE_INIT(pre);
+  wire_char(&w, '@');
+  wire_int(&w, room_id);
+  wire_char(&w, ' ');
+  while (len > 0) {
+    const char *nl = memchr(data, '\n', len);
+    size_t n = nl ? (size_t)(nl - data) + 1 : len;
+    tx_append(fd, w.p, w.len);
+    tx_append(fd, data, n);
+    data += n;
+    len -= n;
+  }
+}
+
+void net_send(int fd, const char *data, size_t len) {
+  PROBE2(send, fd, len);
+  if (fd >= 0 && fd < NET_TX_MAX_CONN && tx_mux[fd]) {
+    int rid = tag_follow ? *tag_follow : tag_room;
+    if (rid >= 0) {
+      send_tagged(fd, rid, data, len);
+      return;
+    }
+  }
+  tx_append(fd, data, len);
+}
+
+static void tx_append(int fd, const char *data, size_t len) {
+  if (!tx_buffered || fd < 0 || fd >= NET_TX_MAX_CONN) {
+    send_raw(fd, data, len);
+    return;
+  }
+
+  TxBuf *b = tx[fd];
+  if (!b) {
+    b = tx[fd] = calloc(1, sizeof(TxBuf));
+    if (!b) {
+      send_raw(fd, data, len);
+      return;
+    }
+  }
+
+  if (b->len + len > NET_TX_SIZE) {
+    net_flush(fd);
+    if (len > NET_TX_SIZE) {
+      send_raw(fd, data, len);
+      return;
+    }
+  }
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+
+  if (!b->dirty) {
+    b->dirty = 1;
+    tx_dirty[tx_ndirty++] = fd;
+  }
+}
+
+void net_send_all(int fd, const char *s) { net_send(fd, s, strlen(s)); }
+
+ssize_t net_send_some(int conn, const char *data, size_t len) {
+  net_flush(conn); // co už čeká v bufferu, musí odejít první (pořadí zpráv)
+  return transport->send(conn, data, len, 1);
+}
+
+void net_close(int conn) {
+  // Poslední odpovědi (ERROR TOO_MANY_ERRORS apod.) se ještě odešlou
+  net_flush(conn);
+  net_set_mux(conn, 0); // číslo spojení dostane příště někdo jiný
+  transport->close(conn);
+}
+
+time_t net_now(void) { return transport->now(); }
+
 int net_make_listen_socket(const char *ip, int port) {
   int s = socket(AF_INET, SOCK_STREAM, 0);
   if (s < 0)
@@ -49,17 +236,40 @@ int net_make_listen_socket(const char *ip, int port) {
   return s;
 }
 
+int net_make_unix_listen_socket(const char *path) {
+  int s = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (s < 0)
+    die("socket");
+
+  struct sockaddr_un a = {0};
+  a.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(a.sun_path)) {
+    fprintf(stderr, "unix socket path too long: %s\n", path);
+    exit(1);
+  }
+  strcpy(a.sun_path, path);
+  unlink(path); // zbytek po předchozím běhu
+
+  if (bind(s, (struct sockaddr *)&a, sizeof(a)) < 0)
+    die("bind");
+  if (listen(s, 16) < 0)
+    die("listen");
+  return s;
+}
+
 void player_reset(Player *p) {
   // Tvrdý reset hráče: zavře fd a vynuluje všechny runtime stavy
   if (!p)
     return;
   if (p->socket_fd >= 0)
-    close(p->socket_fd);
+    net_close(p->socket_fd);
 
+  outq_clear(&p->outq);
   memset(p, 0, sizeof(*p));
   p->socket_fd = -1;
   p->current_room_id = -1;
   p->player_slot = -1;
+  p->watching_room_id = -1;
 
   p->placing_mode = 0;
   p->pending_count = 0;
@@ -76,11 +286,17 @@ void player_soft_disconnect(Player *p) {
   if (!p)
     return;
   if (p->socket_fd >= 0)
-    close(p->socket_fd);
+    net_close(p->socket_fd);
 
   p->socket_fd = -1;
   p->connected = 0;
 
+  p->watching_room_id = -1;
+  p->spec_watch = 0;
+  p->spec_feed = 0;
+  p->lobby_sub = 0;
+  outq_clear(&p->outq);
+
   p->placing_mode = 0;
   p->pending_count = 0;
 
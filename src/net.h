@@ -1,10 +1,13 @@
 #pragma once
 
 #include "common.h"
+#include "outq.h"
+#include "transport.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
-#define PENDING_MAX 5
+#define PENDING_MAX 8 // = GAME_FLEET_MAX (největší flotila přes varianty)
 
 typedef struct PendingShip {
   int x;
@@ -13,36 +16,86 @@ typedef struct PendingShip {
   char dir; // 'H' or 'V'
 } PendingShip;
 
-typedef struct Player {
-  int socket_fd;
+// Proč zůstaly řádky v rx_buffer nezpracované (carry-over do další iterace)
+typedef enum {
+  RX_IDLE = 0,
+  RX_PENDING_BUDGET = 1, // vyčerpán limit řádků na iteraci
+  RX_PENDING_RATE = 2    // prázdný token bucket
+} RxPending;
 
-  char rx_buffer[BUF_SIZE];
-  size_t rx_len;
+// Rozložení hot/cold: co čtou periodické skeny přes všechny hráče (heartbeat,
+// find_player_by_fd, hledání hráčů roomky), je v první cache line, fronta
+// spectatorů (spec_flush) začíná druhou; vstupní
+// buffer žije mimo Player (net_rx_buf), takže pole hráčů je husté
 
+typedef struct Player {
+  // === horká část (jedna cache line) ===
+  _Alignas(CACHE_LINE) int socket_fd;
+  int connected;
   int is_identified;
-  char player_name[32];
-
   int current_room_id;
   int player_slot;
+  int watching_room_id; // -1 = nesleduje žádnou roomku
+  int lobby_sub;        // LIST SUBSCRIBE: diffy seznamu roomek přes outq
+  int mux;              // MUX: sedí v mnoha roomkách, room_id/slot jen po
+                        // dobu příkazu "@rid ..." (protocol.c)
+  int hb_missed;        // consecutive missed PONGs
+  int rx_pending;       // RxPending
+  time_t last_ping;     // last time server sent PING
+  size_t rx_len;        // obsazeno v net_rx_buf(socket_fd)
+  uint32_t peer_ip; // IPv4 adresa protistrany (network order), 0 = neznámá
 
-  int invalid_count;
+  // === spectator (WATCH) ===
+  // Hlavička fronty (count) začíná druhou cache line, položky jsou za ní
+  _Alignas(CACHE_LINE) OutQueue outq; // sdílené zprávy pro spectatory
+  uint32_t spec_watch; // --watch-delay: id WATCH, jehož snímek čeká v logu
+  int spec_feed;       // --watch-delay: index roomky + 1, jejíž log divák
+                       // dostává (může dobíhat i po zavření roomky)
 
-  int connected;
+  // === rate limit (token bucket, v tisícinách tokenu) ===
+  uint32_t rl_tokens;
+  uint64_t rl_last_ms;
+
+  char player_name[32];
+  uint64_t resume_token; // RESUME: náhodné bity + index v players[] (0 = není)
+  int invalid_count;
   time_t disconnected_at;
 
   // === batch setup placement ===
   int placing_mode;
   int pending_count;
   PendingShip pending[PENDING_MAX];
+} Player;
 
-  // === heartbeat (server -> client PING, client -> server PONG) ===
-  time_t last_ping; // last time server sent PING
-  int hb_missed;    // consecutive missed PONGs
+_Static_assert(offsetof(Player, peer_ip) + sizeof(uint32_t) <= CACHE_LINE,
+               "horká část Player se nevejde do jedné cache line");
 
-} Player;
+#define NET_TX_MAX_CONN 1024 // = FD_SETSIZE (select)
+#define NET_TX_SIZE 8192     // výstupní buffer spojení; větší zpráva jde rovnou
 
 int net_make_listen_socket(const char *ip, int port);
+int net_make_unix_listen_socket(const char *path);
+
+void net_send(int fd, const char *data, size_t len);
 void net_send_all(int fd, const char *s);
+// Konstantní zpráva: délka se spočítá při překladu
+#define net_send_lit(fd, s) net_send((fd), "" s, sizeof(s) - 1)
+
+// MUX: řádky pro spojení se zapnutým net_set_mux dostanou předponu "@rid "
+// podle kontextu: net_tag_room (pevná roomka), net_tag_follow (roomka podle
+// proměnné v okamžiku odeslání), net_tag_clear (bez předpony)
+void net_set_mux(int fd, int on);
+void net_tag_room(int room_id);
+void net_tag_follow(const int *room_id);
+void net_tag_clear(void);
+
+// Vstupní buffer spojení (BUF_SIZE, alokuje se při prvním použití);
+// NULL = conn mimo rozsah nebo chybí paměť
+char *net_rx_buf(int conn);
+
+void net_set_buffered(int on);
+void net_flush(int fd);
+void net_flush_all(void);
 
 void player_reset(Player *p);
 void player_soft_disconnect(Player *p);
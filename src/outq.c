@@ -0,0 +1,84 @@
+#define _POSIX_C_SOURCE 200112L
+#include "outq.h"
+#include "transport.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+SharedBuf *sbuf_new(const char *data, size_t len, time_t ready_at) {
+  SharedBuf *b = malloc(sizeof(*b) + len);
+  if (!b)
+    return NULL;
+  b->refcnt = 1;
+  b->len = len;
+  b->ready_at = ready_at;
+  memcpy(b->data, data, len);
+  return b;
+}
+
+void sbuf_retain(SharedBuf *b) {
+  if (b)
+    b->refcnt++;
+}
+
+void sbuf_release(SharedBuf *b) {
+  if (!b)
+    return;
+  if (--b->refcnt == 0)
+    free(b);
+}
+
+void outq_init(OutQueue *q) {
+  memset(q, 0, sizeof(*q));
+}
+
+int outq_push(OutQueue *q, SharedBuf *b) {
+  // Plná fronta = pomalý příjemce; volající rozhodne, co s ním (typicky kick)
+  if (!b || q->count >= OUTQ_MAX)
+    return 0;
+  int tail = (q->head + q->count) % OUTQ_MAX;
+  q->items[tail] = b;
+  q->count++;
+  sbuf_retain(b);
+  return 1;
+}
+
+int outq_flush(OutQueue *q, int fd, time_t now) {
+  // Neblokující odeslání: co se nevejde do socketu, zůstane ve frontě na další kolo
+  while (q->count > 0) {
+    SharedBuf *b = q->items[q->head];
+    if (b->ready_at > now)
+      return 0; // zpožděný přenos ještě nedozrál
+
+    ssize_t w = net_send_some(fd, b->data + q->off, b->len - q->off);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 0;
+      return -1;
+    }
+
+    q->off += (size_t)w;
+    if (q->off < b->len)
+      return 0;
+
+    sbuf_release(b);
+    q->items[q->head] = NULL;
+    q->head = (q->head + 1) % OUTQ_MAX;
+    q->count--;
+    q->off = 0;
+  }
+  return 0;
+}
+
+void outq_clear(OutQueue *q) {
+  while (q->count > 0) {
+    sbuf_release(q->items[q->head]);
+    q->items[q->head] = NULL;
+    q->head = (q->head + 1) % OUTQ_MAX;
+    q->count--;
+  }
+  q->head = 0;
+  q->off = 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <time.h>
+
+#define OUTQ_MAX 128
+
+// Sdílený (refcountovaný) buffer: jedna zpráva se serializuje jednou a pak
+// se jen odkazem vkládá do front všech příjemců (spectatoři apod.)
+typedef struct SharedBuf {
+  int refcnt;
+  size_t len;
+  time_t ready_at; // nejdřív kdy se smí odeslat (zpožděný přenos)
+  char data[];
+} SharedBuf;
+
+SharedBuf *sbuf_new(const char *data, size_t len, time_t ready_at);
+void sbuf_retain(SharedBuf *b);
+void sbuf_release(SharedBuf *b);
+
+// Výstupní fronta jednoho spojení (kruhový buffer ukazatelů na SharedBuf)
+typedef struct OutQueue {
+  int head;
+  int count;  // první: spec_flush ho čte u všech hráčů v každé iteraci
+  size_t off; // kolik bajtů z items[head] už odešlo
+  SharedBuf *items[OUTQ_MAX];
+} OutQueue;
+
+void outq_init(OutQueue *q);
+int outq_push(OutQueue *q, SharedBuf *b);
+int outq_flush(OutQueue *q, int fd, time_t now);
+void outq_clear(OutQueue *q);
@@ -0,0 +1,60 @@
+#pragma once
+
+// USDT sondy (provider "battleship") pro bpftrace / perf / systemtap, např.
+//   bpftrace -e 'usdt:./server:battleship:command { @[str(arg1)] = count(); }'
+//   perf probe -x ./server sdt_battleship:shot
+// Se sys/sdt.h je sonda jedna instrukce nop a záznam v .note.stapsdt; dokud
+// se nepřipojí trasovač, nic se nevolá. Bez sys/sdt.h (nebo s -DNO_PROBES)
+// se makra rozvinou na nic. Argumenty se vyhodnotí vždy: jen levné výrazy.
+//
+//   command(fd, cmd, line)          řádek před dispatchem (cmd = první slovo)
+//   cmd__entry(name, fd)            vstup do cmd_* handleru
+//   cmd__return(name, fd)           návrat z něj (fd ze vstupu)
+//   shot(room, slot, x, y, res)     výstřel, res 0 voda, 1 zásah, 2 potopení,
+//                                   3 výhra
+//   send(fd, bytes)                 data zařazená k odeslání (net_send)
+//   phase(room, from, to)           změna fáze roomky (RoomPhase)
+//   hb__miss(fd, missed)            PING, na který nepřišel PONG
+//   accept(fd)                      přijaté spojení
+//   reject(fd, reason)              odmítnuté ("overloaded", "per_ip", "full")
+//   strike(fd, count)               porušení protokolu
+
+#if !defined(NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef HAVE_PROBES
+#define PROBE1(name, a) DTRACE_PROBE1(battleship, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(battleship, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(battleship, name, a, b, c)
+#define PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(battleship, name, a, b, c, d, e)
+#else
+#define PROBE1(name, a) ((void)0)
+#define PROBE2(name, a, b) ((void)0)
+#define PROBE3(name, a, b, c) ((void)0)
+#define PROBE5(name, a, b, c, d, e) ((void)0)
+#endif
+
+typedef struct ProbeCmd {
+  const char *name;
+  int fd;
+} ProbeCmd;
+
+static inline ProbeCmd probe_cmd_entry(const char *name, int fd) {
+  PROBE2(cmd__entry, name, fd);
+  ProbeCmd c = {name, fd};
+  return c;
+}
+
+static inline void probe_cmd_return(ProbeCmd *c) {
+  PROBE2(cmd__return, c->name, c->fd);
+  (void)c;
+}
+
+// cmd__entry hned, cmd__return při opuštění scope (i přes return uprostřed)
+#define PROBE_CMD_SCOPE(name, fd)                                              \
+  ProbeCmd probe_cmd_ __attribute__((cleanup(probe_cmd_return))) =             \
+      probe_cmd_entry((name), (fd))
@@ -1,17 +1,57 @@
 #define _POSIX_C_SOURCE 200112L
 #include "protocol.h"
+#include "bot.h"
+#include "capture.h"
 #include "game.h"
+#include "journal.h"
+#include "live.h"
+#include "load.h"
 #include "lobby.h"
 #include "log.h"
 #include "net.h"
+#include "probe.h"
+#include "rating.h"
+#include "rng.h"
+#include "spectate.h"
+#include "stats.h"
+#include "trace.h"
+#include "wal.h"
+#include "wire.h"
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/random.h>
 #include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
 
 #define MAX_INVALID 5
 #define HB_INTERVAL_SEC 10
 #define HB_MAX_MISSES 3
+#define RECONNECT_GRACE_SEC 45
+
+// Férovost smyčky: kolik řádků jednoho klienta zpracujeme za iteraci
+// a jakou rychlostí smí klient dlouhodobě posílat příkazy
+#define LINES_PER_ITER 8
+#define RATE_CMDS_PER_SEC 20
+#define RATE_BURST 40
+
+int protocol_rate_cmds = RATE_CMDS_PER_SEC;
+
+// Handler příkazu: span pro trace + USDT sondy cmd__entry/cmd__return
+#define CMD_SCOPE(name, fd)                                                    \
+  TRACE_SCOPE(name, fd);                                                       \
+  PROBE_CMD_SCOPE(name, fd)
+
+// Sdílený generátor pro boty (rozmístění + výstřely), seedovaný při prvním použití
+static uint64_t bot_rng = 0;
+
+static uint64_t *bot_rng_state(void) {
+  if (bot_rng == 0)
+    rng_seed(&bot_rng, ((uint64_t)time(NULL) << 20) ^ (uint64_t)getpid());
+  return &bot_rng;
+}
 
 // Pomocné funkce pro batch placing (PLACING_START..STOP)
 static void pending_reset(Player *p) {
@@ -25,15 +65,46 @@ static void pending_reset(Player *p) {
 // forward (used by close_room_now)
 static Game *game_for_room(Room *r, Game games[]);
 
+// --- MUX: jedno spojení, mnoho roomek ---
+// Sedadlo MUX spojení se nedrží v Player, jen v roomce (player_fds +
+// slot_connected); current_room_id/player_slot se naplní jen na dobu
+// příkazu "@rid ..." (mux_line). Zavření roomky tak sedadlo zruší samo.
+
+static int mux_slot(const Room *r, int fd) {
+  if (fd < 0 || r->state == ROOM_EMPTY)
+    return -1;
+  for (int s = 0; s < 2; s++)
+    if (r->slot_connected[s] && r->player_fds[s] == fd)
+      return s;
+  return -1;
+}
+
+static int mux_seat_count(const Room rooms[], int fd) {
+  int n = 0;
+  for (int i = 0; i < MAX_ROOMS; i++)
+    n += mux_slot(&rooms[i], fd) >= 0;
+  return n;
+}
+
+// Hráč patří k roomce: běžně podle current_room_id, MUX podle sedadla
+static int seated_in(const Player *pp, const Room *r) {
+  if (pp->current_room_id == r->id)
+    return 1;
+  return pp->mux && mux_slot(r, pp->socket_fd) >= 0;
+}
+
 static void close_room_now(Room *r, Game games[], Player players[],
                            const char *reason) {
   if (!r)
     return;
 
-  char msg[128];
+  char buf[128];
+  Wire w = WIRE_INIT(buf);
   if (!reason)
     reason = "CLOSED";
-  snprintf(msg, sizeof(msg), "ROOM_CLOSED %s\n", reason);
+  wire_lit(&w, "ROOM_CLOSED ");
+  wire_str(&w, reason);
+  wire_lit(&w, "\nRETURNED_TO_LOBBY\n");
 
   // Zrušíme navázanou hru (roomka končí, takže game musí do čistého stavu)
   Game *g = game_for_room(r, games);
@@ -47,25 +118,27 @@ static void close_room_now(Room *r, Game games[], Player players[],
     Player *pp = &players[i];
     if (!pp->is_identified)
       continue;
-    if (pp->current_room_id != r->id)
+    if (!seated_in(pp, r))
       continue;
 
     if (pp->socket_fd >= 0 && pp->connected) {
       // stále připojený hráč -> fd nezavíráme, jen ho přepneme do lobby
-      net_send_all(pp->socket_fd, msg);
-      net_send_all(pp->socket_fd, "RETURNED_TO_LOBBY\n");
+      net_send(pp->socket_fd, w.p, w.len);
 
       pp->current_room_id = -1;
       pp->player_slot = -1;
       pp->invalid_count = 0;
       pp->connected = 1;
-      pp->rx_len = 0;
+      if (!pp->mux) // MUX spojení má v bufferu příkazy i pro jiné roomky
+        pp->rx_len = 0;
     } else {
       // ghost/odpojený placeholder už nemá smysl držet, roomka končí
       player_reset(pp);
     }
   }
 
+  spec_room_closed(r, players);
+  wal_room_closed(r->id);
   room_reset(r);
 }
 
@@ -74,12 +147,17 @@ static void strike(Player *p, Room rooms[], Game games[], Player players[],
   if (!p)
     return;
   p->invalid_count++;
+  PROBE2(strike, p->socket_fd, p->invalid_count);
   if (msg && p->socket_fd >= 0)
     net_send_all(p->socket_fd, msg);
 
-  if (p->invalid_count >= MAX_INVALID) {
+  // MUX spojení sčítá chyby všech svých her, limit roste s počtem sedadel
+  int limit = MAX_INVALID;
+  if (p->mux && rooms)
+    limit *= 1 + mux_seat_count(rooms, p->socket_fd);
+  if (p->invalid_count >= limit) {
     if (p->socket_fd >= 0)
-      net_send_all(p->socket_fd, "ERROR TOO_MANY_ERRORS\n");
+      net_send_lit(p->socket_fd, "ERROR TOO_MANY_ERRORS\n");
     log_warn("fd=%d too many errors -> disconnect", p->socket_fd);
 
     // Když někdo brutálně porušuje protokol, zavřeme i roomku, aby se to neřešilo „napůl“
@@ -94,25 +172,62 @@ static void strike(Player *p, Room rooms[], Game games[], Player players[],
   }
 }
 
-static void room_set_phase(Room *r, RoomPhase ph) {
+static void room_set_phase(Room *r, RoomPhase ph, Player players[]) {
   if (!r)
     return;
   if (r->phase == ph)
     return;
   log_info("room=%d phase %s -> %s", r->id, room_phase_str(r->phase),
            room_phase_str(ph));
+  PROBE3(phase, r->id, (int)r->phase, (int)ph);
   r->phase = ph;
+  r->phase_since = net_now();
+  wal_room(r);
+  lobby_room_changed(r);
+
+  char buf[64];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "SPEC_PHASE ");
+  wire_str(&w, room_phase_str(ph));
+  wire_char(&w, '\n');
+  spec_publish(r, players, wire_cstr(&w));
 }
 
 static Game *game_for_room(Room *r, Game games[]) {
-  if (!r)
-    return NULL;
-  int idx = r->id - 1;
-  if (idx < 0 || idx >= MAX_ROOMS)
+  int idx = room_index(r);
+  if (idx < 0)
     return NULL;
   return &games[idx];
 }
 
+// Nová hra v roomce (CREATE, JOIN, REMATCH): čistý Game, žurnál i WAL
+static void room_new_game(Room *r, Game *g) {
+  game_room_init(g, r->id, r->variant);
+  g->salvo = r->salvo;
+  g->journal_id = journal_game_start(r->id, r->variant);
+  if (g->salvo)
+    journal_salvo(g->journal_id);
+  wal_game(r);
+  r->game_active = 1;
+}
+
+// Bot si flotilu rozmístí hned a je rovnou ready
+static int bot_setup_fleet(Room *r, Game *g) {
+  PendingShip fleet[GAME_FLEET_MAX];
+  char err[64];
+  if (!bot_place_fleet(g, BOT_SLOT, bot_rng_state(), fleet) ||
+      !game_set_ready(g, BOT_SLOT, err, sizeof(err))) {
+    log_error("room=%d bot fleet placement failed", r->id);
+    return 0;
+  }
+  for (int i = 0; i < g->fleet; i++)
+    journal_place(g->journal_id, BOT_SLOT, fleet[i].x, fleet[i].y,
+                  fleet[i].len, fleet[i].dir);
+  journal_ready(g->journal_id, BOT_SLOT);
+  wal_fleet(r->id, BOT_SLOT, fleet, g->fleet);
+  return 1;
+}
+
 static void notify_opponent(Room *r, Player players[], int slot,
                             const char *msg) {
   (void)players;
@@ -146,15 +261,69 @@ static Player *find_disconnected_player_by_nick(Player players[],
   return NULL;
 }
 
+// Resume token = náhodné bity + index záznamu v players[] v nejnižším bajtu:
+// RESUME najde ghost session bez hledání a náhodná část nahrazuje nick jako
+// důkaz identity. Každé převzetí vydá token nový (starý přestane platit).
+#define RESUME_INDEX_MASK 0xFFu
+_Static_assert(MAX_PLAYERS <= RESUME_INDEX_MASK + 1,
+               "index v players[] se nevejde do RESUME_INDEX_MASK");
+
+static uint64_t resume_token_new(const Player *p, const Player players[]) {
+  uint64_t r = 0;
+  if (getrandom(&r, sizeof(r), 0) != (ssize_t)sizeof(r))
+    r = rng_next(bot_rng_state()) ^ ((uint64_t)net_now() << 32);
+  r &= ~(uint64_t)RESUME_INDEX_MASK;
+  if (r == 0)
+    r = RESUME_INDEX_MASK + 1u;
+  return r | (uint64_t)(p - players);
+}
+
+// Ghost záznam, jehož místo v roomce převzalo nové spojení (REJOIN/RESUME)
+static void ghost_release(Player *old) {
+  old->is_identified = 0;
+  old->player_name[0] = '\0';
+  old->resume_token = 0;
+  old->current_room_id = -1;
+  old->player_slot = -1;
+  old->connected = 0;
+  old->disconnected_at = 0;
+  old->invalid_count = 0;
+}
+
+// MUX spojení skončilo (EOF, heartbeat, kick): každé jeho sedadlo projde
+// stejnou cestou jako odpojení běžného hráče -- v SETUP/PLAY jen DOWN
+// (grace, REJOIN podle nicku), jinak se roomka zavře. Ghost záznam se
+// nedrží, REJOIN vrací sedadla po jednom.
+static void mux_drop_seats(int fd, Room rooms[], Game games[],
+                           Player players[], const char *why) {
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    Room *r = &rooms[i];
+    int slot = mux_slot(r, fd);
+    if (slot < 0)
+      continue;
+    net_tag_room(r->id);
+    room_mark_down(r, slot);
+    if (r->phase == PHASE_SETUP || r->phase == PHASE_PLAY) {
+      notify_opponent(r, players, slot, "OPPONENT_DOWN\n");
+      continue;
+    }
+    log_info("room=%d phase=%s: immediate close on %s", r->id,
+             room_phase_str(r->phase), why);
+    close_room_now(r, games, players, "DISCONNECT");
+  }
+  net_tag_clear();
+}
+
 // --- command handlers ---
 
-static void cmd_hello(Player *p, const char *name) {
+static void cmd_hello(Player *p, Player players[], const char *name) {
+  CMD_SCOPE("cmd_hello", p->socket_fd);
   if (p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR ALREADY_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR ALREADY_HELLO\n");
     return;
   }
   if (!name || name[0] == '\0') {
-    net_send_all(p->socket_fd, "ERROR BAD_ARGS\n");
+    net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
     strike(p, NULL, NULL, NULL, NULL);
     return;
   }
@@ -168,94 +337,294 @@ static void cmd_hello(Player *p, const char *name) {
   p->connected = 1;
   p->last_ping = 0;
   p->hb_missed = 0;
+  p->resume_token = resume_token_new(p, players);
 
-  char out[128];
-  snprintf(out, sizeof(out), "WELCOME %s\n", p->player_name);
-  net_send_all(p->socket_fd, out);
+  char buf[80];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "WELCOME ");
+  wire_str(&w, p->player_name);
+  wire_char(&w, ' ');
+  wire_hex64(&w, p->resume_token);
+  wire_char(&w, '\n');
+  net_send(p->socket_fd, w.p, w.len);
 
   log_info("player fd=%d identified as '%s'", p->socket_fd, p->player_name);
 }
 
-static void cmd_list(Player *p, Room rooms[], Game games[], Player players[]) {
+// MUX: spojení (typicky bot), které hraje mnoho her najednou. Příkazy pro
+// roomku mají předponu "@rid ", odpovědi a události roomky taky; CREATE,
+// JOIN a REJOIN bez předpony přidají další sedadlo. Platí do odpojení.
+static void cmd_mux(Player *p, Room rooms[], Game games[], Player players[]) {
+  CMD_SCOPE("cmd_mux", p->socket_fd);
+  if (!p->is_identified) {
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+  if (p->current_room_id != -1 || p->watching_room_id != -1) {
+    net_send_lit(p->socket_fd, "ERROR BAD_STATE\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+
+  p->mux = 1;
+  net_set_mux(p->socket_fd, 1);
+  net_send_lit(p->socket_fd, "MUX_ON\n");
+  log_info("player fd=%d (%s) multiplexed", p->socket_fd, p->player_name);
+}
+
+static void cmd_list(Player *p, Room rooms[], Game games[], Player players[],
+                     const char *line) {
+  CMD_SCOPE("cmd_list", p->socket_fd);
   (void)games;
   (void)players;
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+  // LIST [SUBSCRIBE|UNSUBSCRIBE]
+  char arg[16] = {0};
+  if (sscanf(line, "LIST %15s", arg) != 1) {
+    lobby_send_room_list(p->socket_fd, rooms);
+  } else if (strcmp(arg, "SUBSCRIBE") == 0) {
+    // Diffy sdílí frontu se spectatorem, proto jen z lobby
+    if (p->current_room_id != -1 || p->watching_room_id != -1) {
+      net_send_lit(p->socket_fd, "ERROR BAD_STATE\n");
+      return;
+    }
+    lobby_subscribe(p, rooms);
+  } else if (strcmp(arg, "UNSUBSCRIBE") == 0) {
+    if (!p->lobby_sub) {
+      net_send_lit(p->socket_fd, "ERROR NOT_SUBSCRIBED\n");
+      return;
+    }
+    lobby_unsubscribe(p);
+    outq_clear(&p->outq);
+    net_send_lit(p->socket_fd, "LIST_UNSUBSCRIBED\n");
+  } else {
+    net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+    strike(p, rooms, games, players, NULL);
+  }
+}
+
+static void cmd_leaderboard(Player *p, Room rooms[], Game games[],
+                            Player players[], const char *line) {
+  CMD_SCOPE("cmd_leaderboard", p->socket_fd);
+  if (!p->is_identified) {
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+  // LEADERBOARD [offset] [count]
+  int offset = 0, count = RATING_TOP_N;
+  int n = sscanf(line, "LEADERBOARD %d %d", &offset, &count);
+  if ((n >= 1 && offset < 0) || (n == 2 && count <= 0)) {
+    net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+  rating_send_leaderboard(p->socket_fd, offset, count);
+}
+
+static void cmd_rank(Player *p, Room rooms[], Game games[], Player players[],
+                     const char *line) {
+  CMD_SCOPE("cmd_rank", p->socket_fd);
+  if (!p->is_identified) {
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
-  lobby_send_room_list(p->socket_fd, rooms);
+  // RANK [nick] -- bez argumentu vlastní pořadí
+  char nick[32] = {0};
+  if (sscanf(line, "RANK %31s", nick) != 1)
+    memcpy(nick, p->player_name, sizeof(nick) - 1);
+  rating_send_rank(p->socket_fd, nick);
 }
 
-static void cmd_create(Player *p, Room rooms[], Game games[]) {
+// Klasika jde beze změny protokolu; ostatní varianty ohlásí rozměr a flotilu,
+// roomka na salvy navíc "MODE SALVO"
+static void send_variant_info(int fd, const Room *r) {
+  if (fd < 0 || !r)
+    return;
+  if (r->salvo)
+    net_send_lit(fd, "MODE SALVO\n");
+  if (r->variant == GAME_VARIANT_CLASSIC)
+    return;
+  const GameVariant *v = &game_variants[r->variant];
+
+  char buf[96];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "VARIANT ");
+  wire_str(&w, v->name);
+  wire_char(&w, ' ');
+  wire_int(&w, v->n);
+  for (int s = 0; s < v->fleet; s++) {
+    wire_char(&w, ' ');
+    wire_int(&w, v->ship_len[s]);
+  }
+  wire_char(&w, '\n');
+  net_send(fd, w.p, w.len);
+}
+
+static void cmd_create(Player *p, Room rooms[], Game games[], int variant,
+                       int salvo) {
+  CMD_SCOPE("cmd_create", p->socket_fd);
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, NULL, NULL);
     return;
   }
   if (p->current_room_id != -1) {
-    net_send_all(p->socket_fd, "ERROR ALREADY_IN_ROOM\n");
+    net_send_lit(p->socket_fd, "ERROR ALREADY_IN_ROOM\n");
     strike(p, rooms, games, NULL, NULL);
     return;
   }
 
   Room *r = allocate_room(rooms);
   if (!r) {
-    net_send_all(p->socket_fd, "ERROR NO_ROOMS\n");
+    net_send_lit(p->socket_fd, "ERROR NO_ROOMS\n");
     return;
   }
 
+  spec_unwatch(p);
   room_mark_up(r, 0, p->socket_fd, p->player_name);
+  r->variant = variant;
+  r->salvo = salvo;
   r->state = ROOM_WAITING;
-  room_set_phase(r, PHASE_LOBBY);
+  room_set_phase(r, PHASE_LOBBY, NULL);
+  wal_room(r); // fáze se nemění, roomku ale zapsat musíme
 
   p->current_room_id = r->id;
   p->player_slot = 0;
 
   Game *g = game_for_room(r, games);
   if (g)
-    game_room_init(g, r->id);
+    room_new_game(r, g);
   r->game_active = 1;
 
-  char out[128];
-  snprintf(out, sizeof(out), "CREATED %d\nJOINED %d 1\nWAIT\n", r->id, r->id);
-  net_send_all(p->socket_fd, out);
+  char buf[32];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "CREATED ");
+  wire_int(&w, r->id);
+  wire_char(&w, '\n');
+  net_send(p->socket_fd, w.p, w.len);
+  send_variant_info(p->socket_fd, r);
+  w.len = 0;
+  wire_lit(&w, "JOINED ");
+  wire_int(&w, r->id);
+  wire_lit(&w, " 1\nWAIT\n");
+  net_send(p->socket_fd, w.p, w.len);
 
   log_info("room=%d created by fd=%d (%s)", r->id, p->socket_fd,
            p->player_name);
 }
 
+static void cmd_create_bot(Player *p, Room rooms[], Game games[],
+                           int level, int variant, int salvo) {
+  CMD_SCOPE("cmd_create_bot", p->socket_fd);
+  if (!p->is_identified) {
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
+    strike(p, rooms, games, NULL, NULL);
+    return;
+  }
+  if (p->current_room_id != -1) {
+    net_send_lit(p->socket_fd, "ERROR ALREADY_IN_ROOM\n");
+    strike(p, rooms, games, NULL, NULL);
+    return;
+  }
+
+  Room *r = allocate_room(rooms);
+  if (!r) {
+    net_send_lit(p->socket_fd, "ERROR NO_ROOMS\n");
+    return;
+  }
+  Game *g = game_for_room(r, games);
+  if (!g) {
+    room_reset(r);
+    net_send_lit(p->socket_fd, "ERROR NO_GAME\n");
+    return;
+  }
+
+  // Bot obsadí P2 bez socketu (fd -1, ale slot je UP), takže JOIN i timeout ho ignorují
+  spec_unwatch(p);
+  room_mark_up(r, 0, p->socket_fd, p->player_name);
+  room_mark_up(r, BOT_SLOT, -1, BOT_NAME);
+  r->bot_level = level;
+  r->variant = variant;
+  r->salvo = salvo;
+  r->state = ROOM_FULL;
+  room_set_phase(r, PHASE_SETUP, NULL);
+
+  p->current_room_id = r->id;
+  p->player_slot = 0;
+
+  room_new_game(r, g);
+  if (!bot_setup_fleet(r, g)) {
+    game_reset(g);
+    wal_room_closed(r->id);
+    room_reset(r);
+    p->current_room_id = -1;
+    p->player_slot = -1;
+    net_send_lit(p->socket_fd, "ERROR NO_GAME\n");
+    return;
+  }
+
+  char buf[32];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "CREATED ");
+  wire_int(&w, r->id);
+  wire_char(&w, '\n');
+  net_send(p->socket_fd, w.p, w.len);
+  send_variant_info(p->socket_fd, r);
+  w.len = 0;
+  wire_lit(&w, "JOINED ");
+  wire_int(&w, r->id);
+  wire_lit(&w, " 1\nSETUP\n");
+  net_send(p->socket_fd, w.p, w.len);
+
+  log_info("room=%d created by fd=%d (%s) vs %s bot", r->id, p->socket_fd,
+           p->player_name, bot_level_str(level));
+}
+
 static void cmd_join(Player *p, Room rooms[], Game games[], Player players[],
                      int room_id) {
+  CMD_SCOPE("cmd_join", p->socket_fd);
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
   if (p->current_room_id != -1) {
-    net_send_all(p->socket_fd, "ERROR ALREADY_IN_ROOM\n");
+    net_send_lit(p->socket_fd, "ERROR ALREADY_IN_ROOM\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
   Room *r = find_room_by_id(rooms, room_id);
   if (!r) {
-    net_send_all(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
     return;
   }
 
+  if (mux_slot(r, p->socket_fd) >= 0) { // MUX: do vlastní roomky podruhé ne
+    net_send_lit(p->socket_fd, "ERROR ALREADY_IN_ROOM\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
   if (r->player_names[1][0] != '\0') {
-    net_send_all(p->socket_fd, "ERROR ROOM_FULL\n");
+    net_send_lit(p->socket_fd, "ERROR ROOM_FULL\n");
     return;
   }
   if (r->player_names[0][0] == '\0') {
-    net_send_all(p->socket_fd, "ERROR ROOM_BROKEN\n");
+    net_send_lit(p->socket_fd, "ERROR ROOM_BROKEN\n");
     return;
   }
 
+  spec_unwatch(p);
   room_mark_up(r, 1, p->socket_fd, p->player_name);
   r->state = ROOM_FULL;
-  room_set_phase(r, PHASE_SETUP);
+  room_set_phase(r, PHASE_SETUP, players);
 
   p->current_room_id = r->id;
   p->player_slot = 1;
@@ -263,19 +632,26 @@ static void cmd_join(Player *p, Room rooms[], Game games[], Player players[],
 
   Game *g = game_for_room(r, games);
   if (g && !g->in_use)
-    game_room_init(g, r->id);
+    room_new_game(r, g);
   r->game_active = 1;
 
   // Zpráva pro joinera (P2)
-  char out[128];
-  snprintf(out, sizeof(out), "JOINED %d 2\nSETUP\n", r->id);
-  net_send_all(p->socket_fd, out);
+  char buf[32];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "JOINED ");
+  wire_int(&w, r->id);
+  wire_lit(&w, " 2\n");
+  net_send(p->socket_fd, w.p, w.len);
+  send_variant_info(p->socket_fd, r);
+  net_send_lit(p->socket_fd, "SETUP\n");
 
   // Zpráva pro hosta (P1): posíláme rovnou na uložený fd (nespoléhat na lookup přes Player[])
   if (r->slot_connected[0] && r->player_fds[0] >= 0) {
-    char out2[128];
-    snprintf(out2, sizeof(out2), "JOINED %d 1\nSETUP\n", r->id);
-    net_send_all(r->player_fds[0], out2);
+    w.len = 0;
+    wire_lit(&w, "JOINED ");
+    wire_int(&w, r->id);
+    wire_lit(&w, " 1\nSETUP\n");
+    net_send(r->player_fds[0], w.p, w.len);
   }
 
   log_info("player fd=%d (%s) joined room=%d as P2", p->socket_fd,
@@ -284,77 +660,172 @@ static void cmd_join(Player *p, Room rooms[], Game games[], Player players[],
 
 static void cmd_rejoin(Player *p, Room rooms[], Game games[], Player players[],
                        int room_id) {
+  CMD_SCOPE("cmd_rejoin", p->socket_fd);
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
   if (p->current_room_id != -1) {
-    net_send_all(p->socket_fd, "ERROR ALREADY_IN_ROOM\n");
+    net_send_lit(p->socket_fd, "ERROR ALREADY_IN_ROOM\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
   Room *r = find_room_by_id(rooms, room_id);
   if (!r) {
-    net_send_all(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
     return;
   }
 
   // Slot zjistíme podle nicku, aby se hráč vrátil přesně na své místo
   int slot = room_slot_by_nick(r, p->player_name);
   if (slot < 0) {
-    net_send_all(p->socket_fd, "ERROR REJOIN_DENIED\n");
+    net_send_lit(p->socket_fd, "ERROR REJOIN_DENIED\n");
     return;
   }
   if (r->slot_connected[slot]) {
-    net_send_all(p->socket_fd, "ERROR SLOT_ALREADY_UP\n");
+    net_send_lit(p->socket_fd, "ERROR SLOT_ALREADY_UP\n");
     return;
   }
 
   // Zrušíme starý "ghost" Player záznam (rezervovaný pro rejoin), aby nezůstával viset
   Player *old =
       find_disconnected_player_by_nick(players, p->player_name, r->id, slot);
-  if (old) {
-    old->is_identified = 0;
-    old->player_name[0] = '\0';
-    old->current_room_id = -1;
-    old->player_slot = -1;
-    old->connected = 0;
-    old->disconnected_at = 0;
-    old->invalid_count = 0;
-  }
+  if (old)
+    ghost_release(old);
 
+  spec_unwatch(p);
   room_mark_up(r, slot, p->socket_fd, p->player_name);
 
   p->current_room_id = r->id;
   p->player_slot = slot;
   p->connected = 1;
 
-  char out[128];
-  snprintf(out, sizeof(out), "OK REJOINED %d %d\n", r->id, slot + 1);
-  net_send_all(p->socket_fd, out);
+  char buf[64];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "OK REJOINED ");
+  wire_int(&w, r->id);
+  wire_char(&w, ' ');
+  wire_int(&w, slot + 1);
+  wire_char(&w, '\n');
+  net_send(p->socket_fd, w.p, w.len);
+  send_variant_info(p->socket_fd, r);
 
   Game *g = game_for_room(r, games);
 
   // Po rejoinu pošleme hráči aktuální fázi a případně i state/turn
   if (r->phase == PHASE_SETUP) {
-    net_send_all(p->socket_fd, "SETUP\n");
+    net_send_lit(p->socket_fd, "SETUP\n");
   } else if (r->phase == PHASE_PLAY) {
-    net_send_all(p->socket_fd, "PLAY\n");
+    net_send_lit(p->socket_fd, "PLAY\n");
     if (g)
       game_send_state(g, r, p);
     game_send_turn(g, r, players);
   } else {
-    char ph[64];
-    snprintf(ph, sizeof(ph), "PHASE %s\n", room_phase_str(r->phase));
-    net_send_all(p->socket_fd, ph);
+    w.len = 0;
+    wire_lit(&w, "PHASE ");
+    wire_str(&w, room_phase_str(r->phase));
+    wire_char(&w, '\n');
+    if (r->phase == PHASE_FINISHED && r->rematch[1 - slot])
+      wire_lit(&w, "OPP_REMATCH\n"); // soupeř mezitím chce hrát znovu
+    net_send(p->socket_fd, w.p, w.len);
   }
 
   notify_opponent(r, players, slot, "OPPONENT_UP\n");
   log_info("player '%s' rejoined room=%d slot=%d", p->player_name, r->id, slot);
 }
 
+// RESUME <token> [last_seq]: HELLO + REJOIN + STATE na jeden round trip.
+// Odpověď je jedna dávka: RESUMED <nick> <token> <room> <slot>, u hry navíc
+// VARIANT/PHASE/STATE/desky/tah. last_seq se zatím jen přijímá: server
+// zprávy nečísluje a snapshot stavu zmeškané události nahrazuje.
+static void cmd_resume(Player *p, Room rooms[], Game games[], Player players[],
+                       const char *arg) {
+  CMD_SCOPE("cmd_resume", p->socket_fd);
+  if (p->is_identified) {
+    net_send_lit(p->socket_fd, "ERROR ALREADY_HELLO\n");
+    return;
+  }
+
+  char *end;
+  uint64_t tok = strtoull(arg, &end, 16);
+  unsigned idx = (unsigned)(tok & RESUME_INDEX_MASK);
+  Player *old = (idx < MAX_PLAYERS) ? &players[idx] : NULL;
+  if (end == arg || tok == 0 || !old || old == p || !old->is_identified ||
+      old->resume_token != tok) {
+    net_send_lit(p->socket_fd, "ERROR RESUME_DENIED\n");
+    strike(p, rooms, games, players, NULL); // hádání tokenů
+    return;
+  }
+
+  // Staré spojení ještě žije (klient se přepojil dřív, než jsme výpadek
+  // poznali): token je silnější doklad, staré spojení zavřeme
+  char name[sizeof(p->player_name)];
+  memcpy(name, old->player_name, sizeof(name));
+  if (old->socket_fd >= 0)
+    protocol_disconnect(old, rooms, games, players, "resumed elsewhere");
+
+  Room *r = NULL;
+  int slot = -1;
+  if (old->is_identified && old->current_room_id != -1) {
+    r = find_room_by_id(rooms, old->current_room_id);
+    slot = old->player_slot;
+    if (r && (slot < 0 || slot > 1 || r->slot_connected[slot]))
+      r = NULL;
+  }
+  if (old->is_identified)
+    ghost_release(old);
+
+  memcpy(p->player_name, name, sizeof(name));
+  p->is_identified = 1;
+  p->connected = 1;
+  p->last_ping = 0;
+  p->hb_missed = 0;
+  p->resume_token = resume_token_new(p, players);
+
+  if (r) {
+    spec_unwatch(p);
+    room_mark_up(r, slot, p->socket_fd, p->player_name);
+    p->current_room_id = r->id;
+    p->player_slot = slot;
+  }
+
+  char buf[128];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "RESUMED ");
+  wire_str(&w, p->player_name);
+  wire_char(&w, ' ');
+  wire_hex64(&w, p->resume_token);
+  wire_char(&w, ' ');
+  wire_int(&w, r ? r->id : 0);
+  wire_char(&w, ' ');
+  wire_int(&w, r ? slot + 1 : 0);
+  wire_char(&w, '\n');
+  net_send(p->socket_fd, w.p, w.len);
+
+  if (!r) {
+    log_info("player '%s' resumed fd=%d (lobby)", p->player_name,
+             p->socket_fd);
+    return;
+  }
+
+  // Celý snapshot jen tomuto hráči (game_send_turn by poslal tah i soupeři)
+  send_variant_info(p->socket_fd, r);
+  Game *g = game_for_room(r, games);
+  if (g)
+    game_send_state(g, r, p);
+  if (g && r->phase == PHASE_PLAY && game_all_ready(g) && !g->finished) {
+    if (g->turn == slot)
+      game_send_your_turn(g, p->socket_fd);
+    else
+      net_send_lit(p->socket_fd, "OPP_TURN\n");
+  }
+
+  notify_opponent(r, players, slot, "OPPONENT_UP\n");
+  log_info("player '%s' resumed room=%d slot=%d", p->player_name, r->id, slot);
+}
+
 static void destroy_room(Room *r, Game games[], Player players[]) {
   if (!r)
     return;
@@ -367,24 +838,27 @@ static void destroy_room(Room *r, Game games[], Player players[]) {
     int fd = r->player_fds[slot];
     if (fd >= 0) {
       Player *p = find_player_by_fd(players, fd);
-      if (p) {
+      if (p && p->current_room_id == r->id) { // MUX: jen když je sedadlo načtené
         p->current_room_id = -1;
         p->player_slot = -1;
       }
     }
   }
 
+  spec_room_closed(r, players);
+  wal_room_closed(r->id);
   room_reset(r);
 }
 
 static void cmd_leave(Player *p, Room rooms[], Game games[], Player players[]) {
+  CMD_SCOPE("cmd_leave", p->socket_fd);
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
   if (p->current_room_id == -1) {
-    net_send_all(p->socket_fd, "ERROR NOT_IN_ROOM\n");
+    net_send_lit(p->socket_fd, "ERROR NOT_IN_ROOM\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
@@ -392,16 +866,19 @@ static void cmd_leave(Player *p, Room rooms[], Game games[], Player players[]) {
   int rid = p->current_room_id;
   Room *r = find_room_by_id(rooms, rid);
 
-  char out[128];
-  snprintf(out, sizeof(out), "LEFT %d\n", rid);
-  net_send_all(p->socket_fd, out);
+  char buf[32];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "LEFT ");
+  wire_int(&w, rid);
+  wire_char(&w, '\n');
+  net_send(p->socket_fd, w.p, w.len);
 
   if (r) {
     int opp_slot = (p->player_slot == 0) ? 1 : 0;
 
     int opp_fd = r->player_fds[opp_slot];
     if (opp_fd >= 0) {
-      net_send_all(opp_fd, "OPPONENT_LEFT\n");
+      net_send_lit(opp_fd, "OPPONENT_LEFT\n");
     }
 
     log_info("room=%d destroyed by LEAVE", rid);
@@ -415,43 +892,44 @@ static void cmd_leave(Player *p, Room rooms[], Game games[], Player players[]) {
 
 static void cmd_place(Player *p, Room rooms[], Game games[], Player players[],
                       int x, int y, int len, char dir) {
+  CMD_SCOPE("cmd_place", p->socket_fd);
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
   if (p->current_room_id == -1) {
-    net_send_all(p->socket_fd, "ERROR NOT_IN_ROOM\n");
+    net_send_lit(p->socket_fd, "ERROR NOT_IN_ROOM\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
   Room *r = find_room_by_id(rooms, p->current_room_id);
   if (!r) {
-    net_send_all(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
     return;
   }
   if (r->phase != PHASE_SETUP) {
-    net_send_all(p->socket_fd, "ERROR BAD_STATE\n");
+    net_send_lit(p->socket_fd, "ERROR BAD_STATE\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
   Game *g = game_for_room(r, games);
   if (!g || !g->in_use) {
-    net_send_all(p->socket_fd, "ERROR NO_GAME\n");
+    net_send_lit(p->socket_fd, "ERROR NO_GAME\n");
     return;
   }
 
   // PLACE je povolený pouze uvnitř batch režimu PLACING_START..PLACING_STOP
   if (!p->placing_mode) {
-    net_send_all(p->socket_fd, "ERROR PLACE NOT_PLACING\n");
+    net_send_lit(p->socket_fd, "ERROR PLACE NOT_PLACING\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
-  if (p->pending_count >= PENDING_MAX) {
-    net_send_all(p->socket_fd, "ERROR SHIPS TOO_MANY\n");
+  if (p->pending_count >= g->fleet) {
+    net_send_lit(p->socket_fd, "ERROR SHIPS TOO_MANY\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
@@ -463,228 +941,721 @@ static void cmd_place(Player *p, Room rooms[], Game games[], Player players[],
   ps->dir = dir;
 }
 
+// REMATCH po konci hry: až ho pošlou oba (bot souhlasí vždy), stejná
+// roomka i Game se přeinicializují a jde se rovnou do SETUP -- bez
+// LEAVE/CREATE/JOIN a bez uvolnění slotu roomky
+static void cmd_rematch(Player *p, Room rooms[], Game games[],
+                        Player players[]) {
+  CMD_SCOPE("cmd_rematch", p->socket_fd);
+  if (!p->is_identified) {
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+  if (p->current_room_id == -1) {
+    net_send_lit(p->socket_fd, "ERROR NOT_IN_ROOM\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+
+  Room *r = find_room_by_id(rooms, p->current_room_id);
+  if (!r) {
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    return;
+  }
+  if (r->phase != PHASE_FINISHED) {
+    net_send_lit(p->socket_fd, "ERROR BAD_STATE\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+  Game *g = game_for_room(r, games);
+  if (!g) {
+    net_send_lit(p->socket_fd, "ERROR NO_GAME\n");
+    return;
+  }
+
+  int slot = p->player_slot;
+  r->rematch[slot] = 1;
+  if (r->bot_level)
+    r->rematch[BOT_SLOT] = 1;
+  if (!r->rematch[1 - slot]) {
+    net_send_lit(p->socket_fd, "REMATCH_WAIT\n");
+    notify_opponent(r, players, slot, "OPP_REMATCH\n");
+    return;
+  }
+
+  room_new_game(r, g);
+  if (r->bot_level && !bot_setup_fleet(r, g)) {
+    close_room_now(r, games, players, "NO_GAME");
+    return;
+  }
+  r->rematch[0] = r->rematch[1] = 0;
+  room_set_phase(r, PHASE_SETUP, players);
+
+  for (int s = 0; s < 2; s++) {
+    int fd = r->slot_connected[s] ? r->player_fds[s] : -1;
+    if (fd < 0)
+      continue;
+    pending_reset(find_player_by_fd(players, fd));
+    net_send_lit(fd, "REMATCH\nSETUP\n");
+  }
+  log_info("room=%d rematch", r->id);
+}
+
 static void cmd_placing(Player *p, Room rooms[], Game games[],
                         Player players[]) {
+  CMD_SCOPE("cmd_placing", p->socket_fd);
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
+  // Rozpracovaná flotila je v Player, ne u sedadla: MUX posílá FLEET
+  if (p->mux) {
+    net_send_lit(p->socket_fd, "ERROR UNSUPPORTED\n");
+    return;
+  }
   if (p->current_room_id == -1) {
-    net_send_all(p->socket_fd, "ERROR NOT_IN_ROOM\n");
+    net_send_lit(p->socket_fd, "ERROR NOT_IN_ROOM\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
   Room *r = find_room_by_id(rooms, p->current_room_id);
   if (!r) {
-    net_send_all(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
     return;
   }
   if (r->phase != PHASE_SETUP) {
-    net_send_all(p->socket_fd, "ERROR BAD_STATE\n");
+    net_send_lit(p->socket_fd, "ERROR BAD_STATE\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
   Game *g = game_for_room(r, games);
   if (!g || !g->in_use) {
-    net_send_all(p->socket_fd, "ERROR NO_GAME\n");
+    net_send_lit(p->socket_fd, "ERROR NO_GAME\n");
     return;
   }
 
   // Začátek batch placingu vždy resetne jen board konkrétního hráče,
   // aby se umístění nepřilepovalo na předchozí pokus.
   game_clear_player_setup(g, p->player_slot);
+  wal_clear(r->id, p->player_slot);
   p->placing_mode = 1;
   p->pending_count = 0;
   memset(p->pending, 0, sizeof(p->pending));
 
-  net_send_all(p->socket_fd, "PLACING_START\n");
+  net_send_lit(p->socket_fd, "PLACING_START\n");
+}
+
+// Aplikace celé flotily (PLACING_STOP, FLEET, AUTO_PLACE): validace a zápis
+// naráz, žurnál, ready a případný start hry. Při chybě se deska nemění.
+static int fleet_commit(Player *p, Room *r, Game *g, Room rooms[],
+                        Game games[], Player players[],
+                        const PendingShip ships[], int count) {
+  char err[64];
+  if (!game_place_fleet(g, p->player_slot, ships, count, err, sizeof(err)) ||
+      !game_set_ready(g, p->player_slot, err, sizeof(err))) {
+    char buf[96];
+    Wire w = WIRE_INIT(buf);
+    wire_lit(&w, "ERROR SHIPS ");
+    wire_str(&w, err);
+    wire_char(&w, '\n');
+    net_send(p->socket_fd, w.p, w.len);
+    strike(p, rooms, games, players, NULL);
+    return 0;
+  }
+
+  // Do žurnálu jde až celá úspěšná flotila (neúspěšná se na boardu neprojeví)
+  for (int i = 0; i < count; i++)
+    journal_place(g->journal_id, p->player_slot, ships[i].x, ships[i].y,
+                  ships[i].len, ships[i].dir);
+  journal_ready(g->journal_id, p->player_slot);
+  wal_fleet(r->id, p->player_slot, ships, count);
+
+  net_send_lit(p->socket_fd, "SHIPS_OK\n");
+
+  // Pokud jsou ready oba, přepneme roomku do PLAY a pošleme PLAY všem připojeným
+  if (game_all_ready(g)) {
+    room_set_phase(r, PHASE_PLAY, players);
+
+    for (int slot = 0; slot < 2; slot++) {
+      if (!r->slot_connected[slot])
+        continue;
+      int fd = r->player_fds[slot];
+      if (fd >= 0)
+        net_send_lit(fd, "PLAY\n");
+    }
+
+    // Po startu hry se pošle i informace o tahu (YOUR_TURN/OPP_TURN)
+    game_send_turn(g, r, players);
+
+    char buf[32];
+    Wire w = WIRE_INIT(buf);
+    wire_lit(&w, "SPEC_TURN ");
+    wire_int(&w, g->turn + 1);
+    wire_char(&w, '\n');
+    spec_publish(r, players, wire_cstr(&w));
+  }
+  return 1;
+}
+
+// Společné podmínky příkazů rozmístění: HELLO, roomka ve fázi SETUP, hra.
+// NULL = chyba už byla odeslána.
+static Game *setup_game(Player *p, Room rooms[], Game games[],
+                        Player players[], Room **out_room) {
+  if (!p->is_identified) {
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
+    strike(p, rooms, games, players, NULL);
+    return NULL;
+  }
+  if (p->current_room_id == -1) {
+    net_send_lit(p->socket_fd, "ERROR NOT_IN_ROOM\n");
+    strike(p, rooms, games, players, NULL);
+    return NULL;
+  }
+  Room *r = find_room_by_id(rooms, p->current_room_id);
+  if (!r) {
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    return NULL;
+  }
+  if (r->phase != PHASE_SETUP) {
+    net_send_lit(p->socket_fd, "ERROR BAD_STATE\n");
+    strike(p, rooms, games, players, NULL);
+    return NULL;
+  }
+  Game *g = game_for_room(r, games);
+  if (!g || !g->in_use) {
+    net_send_lit(p->socket_fd, "ERROR NO_GAME\n");
+    return NULL;
+  }
+  *out_room = r;
+  return g;
+}
+
+// FLEET x,y,len,dir;x,y,len,dir;... -- celé rozmístění jedním řádkem
+static void cmd_fleet(Player *p, Room rooms[], Game games[], Player players[],
+                      const char *args) {
+  CMD_SCOPE("cmd_fleet", p->socket_fd);
+  Room *r;
+  Game *g = setup_game(p, rooms, games, players, &r);
+  if (!g)
+    return;
+
+  PendingShip ships[GAME_FLEET_MAX];
+  int count = 0;
+  const char *s = args;
+  while (*s) {
+    int x, y, len, used = 0;
+    char dir;
+    if (count == GAME_FLEET_MAX ||
+        sscanf(s, "%d,%d,%d,%c%n", &x, &y, &len, &dir, &used) != 4 ||
+        (s[used] != ';' && s[used] != '\0')) {
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+      strike(p, rooms, games, players, NULL);
+      return;
+    }
+    ships[count].x = x;
+    ships[count].y = y;
+    ships[count].len = len;
+    ships[count].dir = dir;
+    count++;
+    s += used;
+    if (*s == ';')
+      s++;
+  }
+
+  pending_reset(p); // FLEET ruší rozdělaný PLACING_START
+  fleet_commit(p, r, g, rooms, games, players, ships, count);
+}
+
+// AUTO_PLACE -- server vybere náhodnou legální flotilu a vrátí ji jako
+// "FLEET ..." (stejný formát jako příkaz), pak SHIPS_OK
+static void cmd_auto_place(Player *p, Room rooms[], Game games[],
+                           Player players[]) {
+  CMD_SCOPE("cmd_auto_place", p->socket_fd);
+  Room *r;
+  Game *g = setup_game(p, rooms, games, players, &r);
+  if (!g)
+    return;
+
+  pending_reset(p);
+  if (g->ready[p->player_slot]) {
+    net_send_lit(p->socket_fd, "ERROR SHIPS ALREADY_READY\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+
+  PendingShip ships[GAME_FLEET_MAX];
+  if (!game_random_fleet(g, bot_rng_state(), ships)) {
+    net_send_lit(p->socket_fd, "ERROR SHIPS NO_PLACEMENT\n");
+    return;
+  }
+
+  char buf[32 + GAME_FLEET_MAX * 16];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "FLEET ");
+  for (int i = 0; i < g->fleet; i++) {
+    if (i)
+      wire_char(&w, ';');
+    wire_int(&w, ships[i].x);
+    wire_char(&w, ',');
+    wire_int(&w, ships[i].y);
+    wire_char(&w, ',');
+    wire_int(&w, ships[i].len);
+    wire_char(&w, ',');
+    wire_char(&w, ships[i].dir);
+  }
+  wire_char(&w, '\n');
+  net_send(p->socket_fd, w.p, w.len);
+  fleet_commit(p, r, g, rooms, games, players, ships, g->fleet);
 }
 
 static void cmd_placing_stop(Player *p, Room rooms[], Game games[],
                              Player players[]) {
+  CMD_SCOPE("cmd_placing_stop", p->socket_fd);
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
   if (p->current_room_id == -1) {
-    net_send_all(p->socket_fd, "ERROR NOT_IN_ROOM\n");
+    net_send_lit(p->socket_fd, "ERROR NOT_IN_ROOM\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
   Room *r = find_room_by_id(rooms, p->current_room_id);
   if (!r) {
-    net_send_all(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
     return;
   }
   if (r->phase != PHASE_SETUP) {
-    net_send_all(p->socket_fd, "ERROR BAD_STATE\n");
+    net_send_lit(p->socket_fd, "ERROR BAD_STATE\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
   Game *g = game_for_room(r, games);
   if (!g || !g->in_use) {
-    net_send_all(p->socket_fd, "ERROR NO_GAME\n");
+    net_send_lit(p->socket_fd, "ERROR NO_GAME\n");
     return;
   }
 
   if (!p->placing_mode) {
-    net_send_all(p->socket_fd, "ERROR SHIPS NOT_PLACING\n");
+    net_send_lit(p->socket_fd, "ERROR SHIPS NOT_PLACING\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
-  if (p->pending_count != PENDING_MAX) {
-    net_send_all(p->socket_fd, "ERROR SHIPS INCOMPLETE\n");
+  if (p->pending_count != g->fleet) {
+    net_send_lit(p->socket_fd, "ERROR SHIPS INCOMPLETE\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
-  // Aplikace buffered lodí do hry (až teď se validuje a zapisuje do Game)
-  for (int i = 0; i < p->pending_count; i++) {
-    PendingShip *ps = &p->pending[i];
-    char err[64];
+  // Lodě se zkopírují: fleet_commit může hráče odpojit (strike)
+  PendingShip ships[GAME_FLEET_MAX];
+  int count = p->pending_count;
+  memcpy(ships, p->pending, sizeof(ships[0]) * (size_t)count);
+  pending_reset(p);
+  fleet_commit(p, r, g, rooms, games, players, ships, count);
+}
 
-    if (!game_place_ship(g, p->player_slot, ps->x, ps->y, ps->len, ps->dir, err,
-                         sizeof(err))) {
-      net_send_all(p->socket_fd, "ERROR SHIPS ");
-      net_send_all(p->socket_fd, err);
-      net_send_all(p->socket_fd, "\n");
+static void cmd_ready(Player *p, Room rooms[], Game games[], Player players[]) {
+  CMD_SCOPE("cmd_ready", p->socket_fd);
+  (void)rooms;
+  (void)games;
+  (void)players;
+  if (!p || p->socket_fd < 0)
+    return;
 
-      // Při failu vrátíme board do čistého stavu (jen pro tohoto hráče)
-      game_clear_player_setup(g, p->player_slot);
-      pending_reset(p);
-      strike(p, rooms, games, players, NULL);
-      return;
-    }
-  }
+  net_send_lit(p->socket_fd, "ERROR READY_DISABLED\n");
+}
 
-  pending_reset(p);
+// Výsledek dohrané hry do žebříčku a statistik (game_reset ho jinak zahodí).
+// Hry proti botovi se do ratingu nepočítají.
+static void push_result(const Room *r, const Game *g) {
+  live_counters.games_finished++;
+  if (r->bot_level == BOT_NONE && g->winner >= 0)
+    rating_record(r->player_names[g->winner], r->player_names[1 - g->winner]);
+  if (!stats_enabled())
+    return;
+  GameResult res;
+  memset(&res, 0, sizeof(res));
+  for (int s = 0; s < 2; s++) {
+    memcpy(res.names[s], r->player_names[s], STATS_NAME - 1);
+    res.shots[s] = (uint32_t)g->shots[s];
+    res.hits[s] = (uint32_t)g->hits[s];
+  }
+  res.variant = (uint8_t)g->variant;
+  res.winner = (uint8_t)g->winner;
+  res.bot_level = (uint8_t)r->bot_level;
+  res.started_at = (int64_t)g->started_at;
+  res.ended_at = (int64_t)net_now();
+  stats_push(&res);
+}
 
-  // Interně označíme hráče jako ready (READY command je schválně vypnutý)
-  {
-    char err2[64];
-    if (!game_set_ready(g, p->player_slot, err2, sizeof(err2))) {
-      net_send_all(p->socket_fd, "ERROR SHIPS ");
-      net_send_all(p->socket_fd, err2);
-      net_send_all(p->socket_fd, "\n");
-      strike(p, rooms, games, players, NULL);
-      return;
+// Výsledek výstřelu za souřadnicemi: " WATER", " HIT", " SUNK x y len dir"
+// (celá potopená loď) nebo " " + win; bez '\n'
+static void wire_shot_result(Wire *w, const Game *g, int victim_slot, int x,
+                             int y, int res, const char *win) {
+  if (res == 2) {
+    int sx, sy, slen;
+    char sdir;
+    unsigned char ssid = g->ship_id[victim_slot][y][x];
+    if (game_ship_def_from_sid(g, victim_slot, ssid, &sx, &sy, &slen, &sdir)) {
+      wire_lit(w, " SUNK ");
+      wire_int(w, sx);
+      wire_char(w, ' ');
+      wire_int(w, sy);
+      wire_char(w, ' ');
+      wire_int(w, slen);
+      wire_char(w, ' ');
+      wire_char(w, sdir);
+    } else {
+      wire_lit(w, " HIT");
     }
+  } else if (res == 0) {
+    wire_lit(w, " WATER");
+  } else if (res == 1) {
+    wire_lit(w, " HIT");
+  } else {
+    wire_char(w, ' ');
+    wire_str(w, win);
   }
+}
 
-  net_send_all(p->socket_fd, "SHIPS_OK\n");
+static void wire_spec_shot(Wire *w, const Game *g, int slot, int x, int y,
+                           int res) {
+  wire_lit(w, "SPEC_SHOT ");
+  wire_int(w, slot + 1);
+  wire_char(w, ' ');
+  wire_int(w, x);
+  wire_char(w, ' ');
+  wire_int(w, y);
+  wire_shot_result(w, g, 1 - slot, x, y, res, "WIN");
+  wire_char(w, '\n');
+}
 
-  // Pokud jsou ready oba, přepneme roomku do PLAY a pošleme PLAY všem připojeným
-  if (game_all_ready(g)) {
-    room_set_phase(r, PHASE_PLAY);
+static void wire_spec_turn(Wire *w, const Game *g) {
+  wire_lit(w, "SPEC_TURN ");
+  wire_int(w, g->turn + 1);
+  wire_char(w, '\n');
+}
 
-    for (int slot = 0; slot < 2; slot++) {
-      if (!r->slot_connected[slot])
-        continue;
-      int fd = r->player_fds[slot];
-      if (fd >= 0)
-        net_send_all(fd, "PLAY\n");
+// Důsledky úspěšného výstřelu (žurnál, spectatoři, oba hráči, tah); společné
+// pro hráče i bota, proto se střelec bere ze slotu roomky a ne z Player
+static void shot_effects(Room *r, Game *g, Player players[], int slot, int x,
+                         int y, int res) {
+  int victim_slot = 1 - slot;
+  int shooter_fd = r->slot_connected[slot] ? r->player_fds[slot] : -1;
+
+  journal_shot(g->journal_id, slot, x, y);
+  wal_shot(r->id, slot, x, y);
+  if (res == 3)
+    journal_game_end(g->journal_id, slot);
+
+  // Spectatorům jde výsledek i nový tah jako jedna sdílená zpráva
+  char spec[96];
+  Wire w = WIRE_INIT(spec);
+  wire_spec_shot(&w, g, slot, x, y, res);
+  if (res != 3)
+    wire_spec_turn(&w, g);
+  spec_publish(r, players, wire_cstr(&w));
+
+  if (res == 0) {
+    if (shooter_fd >= 0)
+      net_send_lit(shooter_fd, "WATER\n");
+    notify_opponent(r, players, slot, "OPP_WATER\n");
+  } else if (res == 1) {
+    if (shooter_fd >= 0)
+      net_send_lit(shooter_fd, "HIT\n");
+    notify_opponent(r, players, slot, "OPP_HIT\n");
+  } else if (res == 2) {
+    // Potopení: pošleme definici celé lodě (x y len dir), aby si klient mohl označit vrak
+    unsigned char sid = g->ship_id[victim_slot][y][x];
+    int victim_fd =
+        r->slot_connected[victim_slot] ? r->player_fds[victim_slot] : -1;
+
+    // Bot ani odpojený slot nemá Player záznam, proto lookup jen pro platné fd
+    Player *shooter =
+        (shooter_fd >= 0) ? find_player_by_fd(players, shooter_fd) : NULL;
+    Player *victim =
+        (victim_fd >= 0) ? find_player_by_fd(players, victim_fd) : NULL;
+
+    game_send_sunk_def(g, victim_slot, sid, shooter, victim);
+  } else if (res == 3) {
+    if (shooter_fd >= 0)
+      net_send_lit(shooter_fd, "WIN\n");
+    notify_opponent(r, players, slot, "LOSE\n");
+    room_set_phase(r, PHASE_FINISHED, players);
+    push_result(r, g);
+  }
+
+  game_send_turn(g, r, players);
+}
+
+// Salva jako jedna odpověď na stranu: střelec dostane "SHOT x y výsledek"
+// za každý výstřel, soupeř "OPP_SHOT x y výsledek", obojí i s novým tahem
+// v jednom bufferu; spectatoři SPEC_SHOT řádky a jeden SPEC_TURN
+static void salvo_effects(Room *r, Game *g, Player players[], int slot,
+                          const GameShot shots[], int fired) {
+  int victim_slot = 1 - slot;
+  int won = fired > 0 && shots[fired - 1].res == 3;
+
+  for (int i = 0; i < fired; i++) {
+    journal_shot(g->journal_id, slot, shots[i].x, shots[i].y);
+    wal_shot(r->id, slot, shots[i].x, shots[i].y);
+  }
+  if (won)
+    journal_game_end(g->journal_id, slot);
+
+  char spec[GAME_FLEET_MAX * 48 + 32];
+  Wire w = WIRE_INIT(spec);
+  for (int i = 0; i < fired; i++)
+    wire_spec_shot(&w, g, slot, shots[i].x, shots[i].y, shots[i].res);
+  if (!won)
+    wire_spec_turn(&w, g);
+  spec_publish(r, players, wire_cstr(&w));
+
+  for (int side = 0; side < 2; side++) {
+    int s = side ? victim_slot : slot;
+    int fd = r->slot_connected[s] ? r->player_fds[s] : -1;
+    if (fd < 0)
+      continue; // bot nebo odpojený hráč (dožene se přes STATE)
+
+    char buf[GAME_FLEET_MAX * 48 + 32];
+    Wire m = WIRE_INIT(buf);
+    for (int i = 0; i < fired; i++) {
+      wire_str(&m, side ? "OPP_SHOT " : "SHOT ");
+      wire_int(&m, shots[i].x);
+      wire_char(&m, ' ');
+      wire_int(&m, shots[i].y);
+      wire_shot_result(&m, g, victim_slot, shots[i].x, shots[i].y,
+                       shots[i].res, side ? "LOSE" : "WIN");
+      wire_char(&m, '\n');
+    }
+    if (!won && g->turn == s) {
+      wire_lit(&m, "YOUR_TURN ");
+      wire_int(&m, g->salvo_left);
+      wire_char(&m, '\n');
+    } else if (!won) {
+      wire_lit(&m, "OPP_TURN\n");
     }
+    net_send(fd, m.p, m.len);
+  }
 
-    // Po startu hry se pošle i informace o tahu (YOUR_TURN/OPP_TURN)
-    game_send_turn(g, r, players);
+  if (won) {
+    room_set_phase(r, PHASE_FINISHED, players);
+    push_result(r, g);
   }
 }
 
-static void cmd_ready(Player *p, Room rooms[], Game games[], Player players[]) {
-  (void)rooms;
-  (void)games;
-  (void)players;
-  if (!p || p->socket_fd < 0)
+static void bot_take_turn(Room *r, Game *g, Player players[]) {
+  TRACE_SCOPE("bot_take_turn", r->id);
+  if (!r->bot_level || !g->in_use || g->finished || !game_all_ready(g))
+    return;
+  if (g->turn != BOT_SLOT)
+    return;
+
+  char err[64];
+  if (g->salvo) {
+    GameShot shots[GAME_FLEET_MAX];
+    int count = g->salvo_left;
+    if (bot_choose_salvo(g, BOT_SLOT, r->bot_level, bot_rng_state(), shots,
+                         count) != count)
+      return;
+    int fired = game_salvo(g, BOT_SLOT, shots, count, err, sizeof(err));
+    if (fired < 0) {
+      log_error("room=%d bot salvo rejected: %s", r->id, err);
+      return;
+    }
+    salvo_effects(r, g, players, BOT_SLOT, shots, fired);
+    return;
+  }
+
+  int x, y;
+  if (!bot_choose_shot(g, BOT_SLOT, r->bot_level, bot_rng_state(), &x, &y))
     return;
 
-  net_send_all(p->socket_fd, "ERROR READY_DISABLED\n");
+  int res = game_shoot(g, BOT_SLOT, x, y, err, sizeof(err));
+  if (res < 0) {
+    log_error("room=%d bot shot %d %d rejected: %s", r->id, x, y, err);
+    return;
+  }
+  shot_effects(r, g, players, BOT_SLOT, x, y, res);
 }
 
-static void cmd_shoot(Player *p, Room rooms[], Game games[], Player players[],
-                      int x, int y) {
+// Společné podmínky SHOOT a SALVO: HELLO, roomka ve fázi PLAY, hra.
+// NULL = chyba už byla odeslána.
+static Game *play_game(Player *p, Room rooms[], Game games[],
+                       Player players[], Room **out_room) {
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, players, NULL);
-    return;
+    return NULL;
   }
   if (p->current_room_id == -1) {
-    net_send_all(p->socket_fd, "ERROR NOT_IN_ROOM\n");
+    net_send_lit(p->socket_fd, "ERROR NOT_IN_ROOM\n");
     strike(p, rooms, games, players, NULL);
-    return;
+    return NULL;
   }
 
   Room *r = find_room_by_id(rooms, p->current_room_id);
   if (!r) {
-    net_send_all(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
-    return;
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    return NULL;
   }
   if (r->phase != PHASE_PLAY) {
-    net_send_all(p->socket_fd, "ERROR BAD_STATE\n");
+    net_send_lit(p->socket_fd, "ERROR BAD_STATE\n");
     strike(p, rooms, games, players, NULL);
-    return;
+    return NULL;
   }
 
   Game *g = game_for_room(r, games);
   if (!g || !g->in_use) {
-    net_send_all(p->socket_fd, "ERROR NO_GAME\n");
+    net_send_lit(p->socket_fd, "ERROR NO_GAME\n");
+    return NULL;
+  }
+  *out_room = r;
+  return g;
+}
+
+// "ERROR <cmd> <kód z jádra hry>" + strike
+static void send_shot_error(Player *p, Room rooms[], Game games[],
+                            Player players[], const char *cmd,
+                            const char *err) {
+  char buf[96];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "ERROR ");
+  wire_str(&w, cmd);
+  wire_char(&w, ' ');
+  wire_str(&w, err);
+  wire_char(&w, '\n');
+  net_send(p->socket_fd, w.p, w.len);
+  strike(p, rooms, games, players, NULL);
+}
+
+static void cmd_shoot(Player *p, Room rooms[], Game games[], Player players[],
+                      int x, int y) {
+  CMD_SCOPE("cmd_shoot", p->socket_fd);
+  Room *r;
+  Game *g = play_game(p, rooms, games, players, &r);
+  if (!g)
+    return;
+  if (g->salvo) {
+    send_shot_error(p, rooms, games, players, "SHOOT", "SALVO_REQUIRED");
     return;
   }
 
   char err[64];
   int res = game_shoot(g, p->player_slot, x, y, err, sizeof(err));
   if (res < 0) {
-    char out[96];
-    snprintf(out, sizeof(out), "ERROR SHOOT %s\n", err);
-    net_send_all(p->socket_fd, out);
-    strike(p, rooms, games, players, NULL);
+    send_shot_error(p, rooms, games, players, "SHOOT", err);
     return;
   }
 
-  if (res == 0) {
-    net_send_all(p->socket_fd, "WATER\n");
-    notify_opponent(r, players, p->player_slot, "OPP_WATER\n");
-  } else if (res == 1) {
-    net_send_all(p->socket_fd, "HIT\n");
-    notify_opponent(r, players, p->player_slot, "OPP_HIT\n");
-  } else if (res == 2) {
-    // Potopení: pošleme definici celé lodě (x y len dir), aby si klient mohl označit vrak
-    int victim_slot = 1 - p->player_slot;
-    unsigned char sid = g->ship_id[victim_slot][y][x];
+  shot_effects(r, g, players, p->player_slot, x, y, res);
 
-    // Pozor: tady předpokládáme, že Player[] je indexované podle fd (u tebe to tak evidentně je)
-    Player *opponent = &players[r->player_fds[victim_slot]];
+  // Proti botovi: bot odpoví hned ve stejném průchodu smyčkou
+  bot_take_turn(r, g, players);
+}
 
-    game_send_sunk_def(g, victim_slot, sid, p, opponent);
-  } else if (res == 3) {
-    net_send_all(p->socket_fd, "WIN\n");
-    notify_opponent(r, players, p->player_slot, "LOSE\n");
-    room_set_phase(r, PHASE_FINISHED);
+// SALVO x1 y1 x2 y2 ... -- jeden výstřel za každou vlastní živou loď;
+// buď projde celá salva, nebo nic (game_salvo ověří všechno předem)
+static void cmd_salvo(Player *p, Room rooms[], Game games[], Player players[],
+                      const char *args) {
+  CMD_SCOPE("cmd_salvo", p->socket_fd);
+  Room *r;
+  Game *g = play_game(p, rooms, games, players, &r);
+  if (!g)
+    return;
+
+  GameShot shots[GAME_FLEET_MAX];
+  int count = 0;
+  const char *s = args;
+  while (*s) {
+    int x, y, used = 0;
+    if (count == GAME_FLEET_MAX ||
+        sscanf(s, "%d %d%n", &x, &y, &used) != 2 ||
+        (s[used] != ' ' && s[used] != '\0')) {
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+      strike(p, rooms, games, players, NULL);
+      return;
+    }
+    shots[count].x = x;
+    shots[count].y = y;
+    count++;
+    s += used;
+    while (*s == ' ')
+      s++;
   }
 
-  game_send_turn(g, r, players);
+  char err[64];
+  int fired = game_salvo(g, p->player_slot, shots, count, err, sizeof(err));
+  if (fired < 0) {
+    send_shot_error(p, rooms, games, players, "SALVO", err);
+    return;
+  }
+
+  salvo_effects(r, g, players, p->player_slot, shots, fired);
+  bot_take_turn(r, g, players);
+}
+
+static void cmd_watch(Player *p, Room rooms[], Game games[], Player players[],
+                      int room_id) {
+  CMD_SCOPE("cmd_watch", p->socket_fd);
+  if (!p->is_identified) {
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+  if (p->current_room_id != -1) {
+    net_send_lit(p->socket_fd, "ERROR ALREADY_IN_ROOM\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+
+  Room *r = find_room_by_id(rooms, room_id);
+  if (!r) {
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    return;
+  }
+
+  spec_watch(p, r, game_for_room(r, games));
+  log_info("player fd=%d (%s) watching room=%d", p->socket_fd, p->player_name,
+           r->id);
+}
+
+static void cmd_unwatch(Player *p, Room rooms[], Game games[],
+                        Player players[]) {
+  CMD_SCOPE("cmd_unwatch", p->socket_fd);
+  if (p->watching_room_id == -1) {
+    net_send_lit(p->socket_fd, "ERROR NOT_WATCHING\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
+  spec_unwatch(p);
+  net_send_lit(p->socket_fd, "UNWATCHED\n");
 }
 
 static void cmd_state(Player *p, Room rooms[], Game games[]) {
+  CMD_SCOPE("cmd_state", p->socket_fd);
   if (!p->is_identified) {
-    net_send_all(p->socket_fd, "ERROR MUST_HELLO\n");
+    net_send_lit(p->socket_fd, "ERROR MUST_HELLO\n");
     strike(p, rooms, games, NULL, NULL);
     return;
   }
   if (p->current_room_id == -1) {
-    net_send_all(p->socket_fd, "ERROR NOT_IN_ROOM\n");
+    net_send_lit(p->socket_fd, "ERROR NOT_IN_ROOM\n");
     strike(p, rooms, games, NULL, NULL);
     return;
   }
 
   Room *r = find_room_by_id(rooms, p->current_room_id);
   if (!r) {
-    net_send_all(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
+    net_send_lit(p->socket_fd, "ERROR ROOM_NOT_FOUND\n");
     return;
   }
   Game *g = game_for_room(r, games);
@@ -694,41 +1665,106 @@ static void cmd_state(Player *p, Room rooms[], Game games[]) {
 
 // --- public API ---
 
-void protocol_handle_line(Player *p, Room rooms[], Game games[],
-                          Player players[], const char *line) {
-  log_info("rx fd=%d line='%s'", p->socket_fd, line);
+// Při přetížení odložitelné příkazy: dotazy lobby a spectate (BUSY), při
+// CRITICAL i zakládání nových her. Příkazy rozehraných her a PONG nikdy.
+static int cmd_deferrable(const char *cmd, int level) {
+  if (level == LOAD_OK)
+    return 0;
+  if (strcmp(cmd, "LIST") == 0 || strcmp(cmd, "WATCH") == 0 ||
+      strcmp(cmd, "LEADERBOARD") == 0 || strcmp(cmd, "RANK") == 0)
+    return 1;
+  return level == LOAD_CRITICAL && strcmp(cmd, "CREATE") == 0;
+}
 
+static void handle_command(Player *p, Room rooms[], Game games[],
+                           Player players[], const char *line) {
   char cmd[32] = {0};
   if (sscanf(line, "%31s", cmd) != 1) {
-    net_send_all(p->socket_fd, "ERROR BAD_COMMAND\n");
+    net_send_lit(p->socket_fd, "ERROR BAD_COMMAND\n");
     strike(p, rooms, games, players, NULL);
     return;
   }
 
+  PROBE3(command, p->socket_fd, (const char *)cmd, line);
+
+  if (cmd_deferrable(cmd, load_level())) {
+    load_send_busy(p->socket_fd); // bez strike: klient za nic nemůže
+    return;
+  }
+
   if (strcmp(cmd, "HELLO") == 0) {
     const char *sp = strchr(line, ' ');
     if (!sp) {
-      net_send_all(p->socket_fd, "ERROR BAD_ARGS\n");
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
       strike(p, rooms, games, players, NULL);
       return;
     }
-    cmd_hello(p, sp + 1);
+    cmd_hello(p, players, sp + 1);
+    return;
+  }
+  if (strcmp(cmd, "RESUME") == 0) {
+    const char *sp = strchr(line, ' ');
+    if (!sp) {
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+      strike(p, rooms, games, players, NULL);
+      return;
+    }
+    cmd_resume(p, rooms, games, players, sp + 1);
     return;
   }
 
   if (strcmp(cmd, "LIST") == 0) {
-    cmd_list(p, rooms, games, players);
+    cmd_list(p, rooms, games, players, line);
+    return;
+  }
+  if (strcmp(cmd, "LEADERBOARD") == 0) {
+    cmd_leaderboard(p, rooms, games, players, line);
+    return;
+  }
+  if (strcmp(cmd, "RANK") == 0) {
+    cmd_rank(p, rooms, games, players, line);
     return;
   }
   if (strcmp(cmd, "CREATE") == 0) {
-    cmd_create(p, rooms, games);
+    // CREATE [variant] [SALVO] [BOT [easy|hard]] -- argumenty v libovolném
+    // pořadí
+    char a[4][16] = {{0}};
+    int na = sscanf(line, "CREATE %15s %15s %15s %15s", a[0], a[1], a[2],
+                    a[3]);
+    int variant = GAME_VARIANT_CLASSIC, bot = 0, level = BOT_EASY, bad = 0;
+    int salvo = 0;
+
+    for (int i = 0; i < na; i++) {
+      int v = game_variant_from_str(a[i]);
+      if (v >= 0) {
+        variant = v;
+      } else if (strcmp(a[i], "SALVO") == 0 || strcmp(a[i], "salvo") == 0) {
+        salvo = 1;
+      } else if (strcmp(a[i], "BOT") == 0 || strcmp(a[i], "bot") == 0) {
+        bot = 1;
+      } else if (bot && bot_level_from_str(a[i]) != BOT_NONE) {
+        level = bot_level_from_str(a[i]);
+      } else {
+        bad = 1;
+      }
+    }
+    if (bad) {
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+      strike(p, rooms, games, players, NULL);
+      return;
+    }
+
+    if (bot)
+      cmd_create_bot(p, rooms, games, level, variant, salvo);
+    else
+      cmd_create(p, rooms, games, variant, salvo);
     return;
   }
 
   if (strcmp(cmd, "JOIN") == 0) {
     int rid = -1;
     if (sscanf(line, "JOIN %d", &rid) != 1) {
-      net_send_all(p->socket_fd, "ERROR BAD_ARGS\n");
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
       strike(p, rooms, games, players, NULL);
       return;
     }
@@ -739,7 +1775,7 @@ void protocol_handle_line(Player *p, Room rooms[], Game games[],
   if (strcmp(cmd, "REJOIN") == 0) {
     int rid = -1;
     if (sscanf(line, "REJOIN %d", &rid) != 1) {
-      net_send_all(p->socket_fd, "ERROR BAD_ARGS\n");
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
       strike(p, rooms, games, players, NULL);
       return;
     }
@@ -747,12 +1783,27 @@ void protocol_handle_line(Player *p, Room rooms[], Game games[],
     return;
   }
 
+  if (strcmp(cmd, "WATCH") == 0) {
+    int rid = -1;
+    if (sscanf(line, "WATCH %d", &rid) != 1) {
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+      strike(p, rooms, games, players, NULL);
+      return;
+    }
+    cmd_watch(p, rooms, games, players, rid);
+    return;
+  }
+  if (strcmp(cmd, "UNWATCH") == 0) {
+    cmd_unwatch(p, rooms, games, players);
+    return;
+  }
+
   if (strcmp(cmd, "PONG") == 0) {
     p->hb_missed = 0;
     return;
   }
   if (strcmp(cmd, "PING") == 0) {
-    net_send_all(p->socket_fd, "PONG\n");
+    net_send_lit(p->socket_fd, "PONG\n");
     return;
   }
 
@@ -768,12 +1819,26 @@ void protocol_handle_line(Player *p, Room rooms[], Game games[],
     cmd_placing_stop(p, rooms, games, players);
     return;
   }
+  if (strcmp(cmd, "FLEET") == 0) {
+    const char *sp = strchr(line, ' ');
+    if (!sp) {
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+      strike(p, rooms, games, players, NULL);
+      return;
+    }
+    cmd_fleet(p, rooms, games, players, sp + 1);
+    return;
+  }
+  if (strcmp(cmd, "AUTO_PLACE") == 0) {
+    cmd_auto_place(p, rooms, games, players);
+    return;
+  }
 
   if (strcmp(cmd, "PLACE") == 0) {
     int x, y, len;
     char dir;
     if (sscanf(line, "PLACE %d %d %d %c", &x, &y, &len, &dir) != 4) {
-      net_send_all(p->socket_fd, "ERROR BAD_ARGS\n");
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
       strike(p, rooms, games, players, NULL);
       return;
     }
@@ -789,96 +1854,195 @@ void protocol_handle_line(Player *p, Room rooms[], Game games[],
   if (strcmp(cmd, "SHOOT") == 0) {
     int x, y;
     if (sscanf(line, "SHOOT %d %d", &x, &y) != 2) {
-      net_send_all(p->socket_fd, "ERROR BAD_ARGS\n");
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
       strike(p, rooms, games, players, NULL);
       return;
     }
     cmd_shoot(p, rooms, games, players, x, y);
     return;
   }
+  if (strcmp(cmd, "SALVO") == 0) {
+    const char *sp = strchr(line, ' ');
+    if (!sp) {
+      net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+      strike(p, rooms, games, players, NULL);
+      return;
+    }
+    cmd_salvo(p, rooms, games, players, sp + 1);
+    return;
+  }
 
   if (strcmp(cmd, "STATE") == 0) {
     cmd_state(p, rooms, games);
     return;
   }
+  if (strcmp(cmd, "REMATCH") == 0) {
+    cmd_rematch(p, rooms, games, players);
+    return;
+  }
+  if (strcmp(cmd, "MUX") == 0) {
+    cmd_mux(p, rooms, games, players);
+    return;
+  }
 
-  net_send_all(p->socket_fd, "ERROR BAD_COMMAND\n");
+  net_send_lit(p->socket_fd, "ERROR BAD_COMMAND\n");
   strike(p, rooms, games, players, NULL);
 }
 
-void protocol_process_incoming(Player *p, Room rooms[], Game games[],
-                               Player players[]) {
-  ssize_t r =
-      recv(p->socket_fd, p->rx_buffer + p->rx_len, BUF_SIZE - p->rx_len, 0);
+// "@rid příkaz" od MUX spojení: sedadlo v roomce se na dobu příkazu načte
+// do Player, takže handlery pracují jako s běžným hráčem
+static void mux_line(Player *p, Room rooms[], Game games[], Player players[],
+                     const char *line) {
+  int rid = -1, off = 0;
+  if (sscanf(line, "@%d %n", &rid, &off) != 1) {
+    net_send_lit(p->socket_fd, "ERROR BAD_ARGS\n");
+    strike(p, rooms, games, players, NULL);
+    return;
+  }
 
-  if (r == 0) {
-    log_info("fd=%d disconnected (soft)", p->socket_fd);
+  net_tag_room(rid);
+  Room *r = find_room_by_id(rooms, rid);
+  int slot = r ? mux_slot(r, p->socket_fd) : -1;
+  if (slot < 0) {
+    // Bez striku: roomka mohla právě skončit (ROOM_CLOSED se míjí s
+    // příkazem, který už byl na cestě)
+    net_send_lit(p->socket_fd, "ERROR NOT_IN_ROOM\n");
+    return;
+  }
 
-    if (p->current_room_id != -1) {
-      Room *rm = find_room_by_id(rooms, p->current_room_id);
-      if (rm && p->player_slot >= 0) {
-        if (rm->phase == PHASE_SETUP || rm->phase == PHASE_PLAY) {
-          room_mark_down(rm, p->player_slot);
-          notify_opponent(rm, players, p->player_slot, "OPPONENT_DOWN\n");
-          player_soft_disconnect(p);
-          return;
-        }
+  p->current_room_id = rid;
+  p->player_slot = slot;
+  handle_command(p, rooms, games, players, line + off);
+}
 
-        // Okamžité zavření roomky mimo SETUP/PLAY
-        log_info("room=%d phase=%s: immediate close on disconnect", rm->id,
-                 room_phase_str(rm->phase));
-        room_mark_down(rm, p->player_slot);
-        player_soft_disconnect(p); // slot zůstane jako disconnected pro případné cleanup
-        close_room_now(rm, games, players, "DISCONNECT");
-        return;
-      }
-    }
+void protocol_handle_line(Player *p, Room rooms[], Game games[],
+                          Player players[], const char *line) {
+  TRACE_SCOPE("dispatch", p->socket_fd);
+  log_info("rx fd=%d line='%s'", p->socket_fd, line);
 
-    player_reset(p);
+  live_counters.commands++;
+  int fd = p->socket_fd, mux = p->mux;
+  if (mux && line[0] == '@') {
+    mux_line(p, rooms, games, players, line);
+  } else {
+    // Zprávy MUX protějškům nesou roomku příkazu; kdo v roomce není, tu,
+    // do které ho příkaz posadí (CREATE/JOIN)
+    if (p->current_room_id != -1)
+      net_tag_room(p->current_room_id);
+    else
+      net_tag_follow(&p->current_room_id);
+    handle_command(p, rooms, games, players, line);
+  }
+  net_tag_clear();
+
+  if (mux && p->socket_fd == fd) {
+    p->current_room_id = -1; // sedadlo zůstává jen v roomce
+    p->player_slot = -1;
+  } else if (mux) {
+    // Spojení zaniklo uprostřed příkazu (TOO_MANY_ERRORS): ostatní sedadla
+    mux_drop_seats(fd, rooms, games, players, "kick");
+  }
+}
+
+void protocol_process_incoming(Player *p, Room rooms[], Game games[],
+                               Player players[]) {
+  char *rx = net_rx_buf(p->socket_fd);
+  if (!rx) {
+    log_error("fd=%d no rx buffer", p->socket_fd);
+    protocol_disconnect(p, rooms, games, players, "no rx buffer");
+    return;
+  }
+
+  TraceSpan rs = trace_begin("recv", p->socket_fd);
+  ssize_t r = recv(p->socket_fd, rx + p->rx_len, BUF_SIZE - p->rx_len, 0);
+  trace_end(&rs);
+
+  if (r == 0) {
+    capture_conn_close(p->socket_fd);
+    protocol_disconnect(p, rooms, games, players, "disconnect");
     return;
   }
 
   if (r < 0) {
     if (errno == EINTR)
       return;
+    log_error("fd=%d recv error", p->socket_fd);
+    capture_conn_close(p->socket_fd);
+    protocol_disconnect(p, rooms, games, players, "recv error");
+    return;
+  }
 
-    log_error("fd=%d recv error -> soft disconnect", p->socket_fd);
+  capture_received(p->socket_fd, rx, p->rx_len, p->rx_len + (size_t)r);
+  p->rx_len += (size_t)r;
+  protocol_process_pending(p, rooms, games, players);
+}
 
-    if (p->current_room_id != -1) {
-      Room *rm = find_room_by_id(rooms, p->current_room_id);
-      if (rm && p->player_slot >= 0) {
-        if (rm->phase == PHASE_SETUP || rm->phase == PHASE_PLAY) {
-          room_mark_down(rm, p->player_slot);
-          notify_opponent(rm, players, p->player_slot, "OPPONENT_DOWN\n");
-          player_soft_disconnect(p);
-          return;
-        }
+static uint64_t mono_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
 
-        log_info("room=%d phase=%s: immediate close on recv error", rm->id,
-                 room_phase_str(rm->phase));
-        room_mark_down(rm, p->player_slot);
-        player_soft_disconnect(p);
-        close_room_now(rm, games, players, "DISCONNECT");
-        return;
-      }
-    }
+// Token bucket: protocol_rate_cmds tokenů za sekundu, nejvýš RATE_BURST naráz;
+// MUX spojení má (1 + počet sedadel) násobek, jako by každá hra měla svoje
+static int rate_take(Player *p, int scale) {
+  if (protocol_rate_cmds <= 0)
+    return 1; // vypnuto (--rate-limit=0, přehrávání zachyceného provozu)
+  uint64_t now = mono_ms();
+  uint32_t burst = RATE_BURST * 1000u * (uint32_t)scale;
+  if (p->rl_last_ms == 0) {
+    p->rl_tokens = burst;
+    p->rl_last_ms = now;
+  }
+
+  uint64_t refill =
+      (now - p->rl_last_ms) * (uint64_t)protocol_rate_cmds * (uint64_t)scale;
+  p->rl_last_ms = now;
+  if (p->rl_tokens > burst) // sedadel ubylo
+    p->rl_tokens = burst;
+  if (refill > burst - p->rl_tokens)
+    p->rl_tokens = burst;
+  else
+    p->rl_tokens += (uint32_t)refill;
+
+  if (p->rl_tokens < 1000u)
+    return 0;
+  p->rl_tokens -= 1000u;
+  return 1;
+}
 
-    player_reset(p);
+void protocol_process_pending(Player *p, Room rooms[], Game games[],
+                              Player players[]) {
+  // Rozsekání TCP streamu na řádky zakončené '\n'. Za jednu iteraci smyčky
+  // zpracujeme nejvýš LINES_PER_ITER řádků a jen když je token; zbytek zůstane
+  // v bufferu a hlavní smyčka ho dožene v dalším kole (round-robin)
+  TRACE_SCOPE("framing", p->socket_fd);
+  int scale = p->mux ? 1 + mux_seat_count(rooms, p->socket_fd) : 1;
+  int budget = LINES_PER_ITER * scale;
+  p->rx_pending = RX_IDLE;
+  char *rx = net_rx_buf(p->socket_fd);
+  if (!rx)
     return;
-  }
 
-  p->rx_len += (size_t)r;
-
-  // Rozsekání TCP streamu na řádky zakončené '\n'
   size_t start = 0;
   for (size_t i = 0; i < p->rx_len; i++) {
-    if (p->rx_buffer[i] == '\n') {
+    if (rx[i] == '\n') {
+      if (budget == 0) {
+        p->rx_pending = RX_PENDING_BUDGET;
+        break;
+      }
+      if (!rate_take(p, scale)) {
+        p->rx_pending = RX_PENDING_RATE;
+        break;
+      }
+      budget--;
+
       size_t line_len = i - start;
       char line[1024];
       if (line_len >= sizeof(line))
         line_len = sizeof(line) - 1;
 
-      memcpy(line, p->rx_buffer + start, line_len);
+      memcpy(line, rx + start, line_len);
       line[line_len] = '\0';
 
       protocol_handle_line(p, rooms, games, players, line);
@@ -890,15 +2054,20 @@ void protocol_process_incoming(Player *p, Room rooms[], Game games[],
   }
 
   // Zbytek nedokončené řádky přesuneme na začátek bufferu
-  if (start > 0) {
+  // (handler mohl buffer mezitím vyprázdnit, např. při zavření roomky)
+  if (start > p->rx_len) {
+    p->rx_len = 0;
+    p->rx_pending = RX_IDLE;
+  } else if (start > 0) {
     size_t rem = p->rx_len - start;
-    memmove(p->rx_buffer, p->rx_buffer + start, rem);
+    memmove(rx, rx + start, rem);
     p->rx_len = rem;
   }
 
   // Když klient nikdy neposílá '\n', buffer se naplní -> kick
-  if (p->rx_len == BUF_SIZE) {
-    net_send_all(p->socket_fd, "ERROR LINE_TOO_LONG\n");
+  // (plný buffer s odloženými celými řádky je jen backpressure, ne chyba)
+  if (p->rx_len == BUF_SIZE && p->rx_pending == RX_IDLE) {
+    net_send_lit(p->socket_fd, "ERROR LINE_TOO_LONG\n");
     log_error("fd=%d line too long -> hard disconnect", p->socket_fd);
 
     if (p->current_room_id != -1) {
@@ -906,16 +2075,55 @@ void protocol_process_incoming(Player *p, Room rooms[], Game games[],
       if (rm)
         destroy_room(rm, games, players);
     }
+    if (p->mux)
+      mux_drop_seats(p->socket_fd, rooms, games, players, "line too long");
     player_reset(p);
   }
 }
 
-static void heartbeat_soft_disconnect(Player *p, Room rooms[], Game games[],
-                                      Player players[]) {
-  if (!p)
-    return;
+// Hráč ve hře: při zátěži má přednost před lobby. MUX spojení má mimo
+// příkaz current_room_id == -1, ve hře je, když drží nějaké sedadlo.
+static int in_game(const Player *p, const Room rooms[]) {
+  if (p->current_room_id != -1)
+    return 1;
+  return p->mux && mux_seat_count(rooms, p->socket_fd) > 0;
+}
 
-  log_info("fd=%d heartbeat timeout -> soft disconnect", p->socket_fd);
+void protocol_serve(Room rooms[], Game games[], Player players[],
+                    const fd_set *readable, int level, int start) {
+  // Průchod se určí předem: kdo v prvním odejde do lobby (LEAVE), nesmí
+  // přijít na řadu znovu -- FD_ISSET platí dál a recv by na prázdném
+  // socketu zablokoval celou smyčku
+  unsigned char pass_of[MAX_PLAYERS];
+  int passes = (level == LOAD_OK) ? 1 : 2;
+  for (int i = 0; i < MAX_PLAYERS; i++)
+    pass_of[i] = (passes == 2 && !in_game(&players[i], rooms));
+
+  for (int pass = 0; pass < passes; pass++) {
+    for (int k = 0; k < MAX_PLAYERS; k++) {
+      int i = (start + k) % MAX_PLAYERS;
+      Player *p = &players[i];
+      if (p->socket_fd < 0 || pass_of[i] != pass)
+        continue;
+
+      if (p->rx_pending != RX_IDLE) {
+        protocol_process_pending(p, rooms, games, players);
+      } else if (readable && FD_ISSET(p->socket_fd, readable)) {
+        protocol_process_incoming(p, rooms, games, players);
+      }
+    }
+  }
+}
+
+static void disconnect_player(Player *p, Room rooms[], Game games[],
+                              Player players[], const char *why) {
+  log_info("fd=%d %s -> soft disconnect", p->socket_fd, why);
+
+  if (p->mux) {
+    mux_drop_seats(p->socket_fd, rooms, games, players, why);
+    player_reset(p);
+    return;
+  }
 
   if (p->current_room_id != -1) {
     Room *rm = find_room_by_id(rooms, p->current_room_id);
@@ -928,12 +2136,12 @@ static void heartbeat_soft_disconnect(Player *p, Room rooms[], Game games[],
         return;
       }
 
-      // Okamžité zavření roomky mimo SETUP/PLAY (stejné jako recv==0)
-      log_info("room=%d phase=%s: immediate close on heartbeat timeout", rm->id,
-               room_phase_str(rm->phase));
+      // Okamžité zavření roomky mimo SETUP/PLAY
+      log_info("room=%d phase=%s: immediate close on %s", rm->id,
+               room_phase_str(rm->phase), why);
 
       room_mark_down(rm, p->player_slot);
-      player_soft_disconnect(p);
+      player_soft_disconnect(p); // slot zůstane jako disconnected pro případné cleanup
       close_room_now(rm, games, players, "DISCONNECT");
       return;
     }
@@ -942,8 +2150,98 @@ static void heartbeat_soft_disconnect(Player *p, Room rooms[], Game games[],
   player_reset(p);
 }
 
+void protocol_disconnect(Player *p, Room rooms[], Game games[],
+                         Player players[], const char *why) {
+  // Společná cesta pro recv()==0, chybu recv() i heartbeat timeout
+  if (!p)
+    return;
+  net_tag_room(p->current_room_id); // OPPONENT_DOWN pro MUX soupeře
+  disconnect_player(p, rooms, games, players, why);
+  net_tag_clear();
+}
+
+void protocol_tick(Room rooms[], Game games[], Player players[]) {
+  // Periodická údržba: hlídá reconnect timeout a v případě vypršení roomku uklidí
+  time_t now = net_now();
+
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    Room *r = &rooms[i];
+    if (r->state == ROOM_EMPTY)
+      continue;
+    net_tag_room(r->id); // zprávy MUX hráčům téhle roomky
+
+    // Dohraná roomka bez REMATCH a roomka bez soupeře se recyklují
+    double idle = difftime(now, r->phase_since);
+    if ((r->phase == PHASE_FINISHED && idle >= ROOM_FINISHED_IDLE_SEC) ||
+        (r->state == ROOM_WAITING && r->phase == PHASE_LOBBY &&
+         idle >= ROOM_WAITING_IDLE_SEC)) {
+      log_info("room=%d %s idle %.0fs -> reclaim", r->id,
+               room_phase_str(r->phase), idle);
+      close_room_now(r, games, players, "IDLE");
+      continue;
+    }
+
+    for (int slot = 0; slot < 2; slot++) {
+      if (r->slot_connected[slot]) // slot je UP
+        continue;
+      if (r->slot_down_since[slot] == 0) // nemáme čas výpadku
+        continue;
+      if (r->player_names[slot][0] == '\0') // není tam vůbec hráč
+        continue;
+
+      double dt = difftime(now, r->slot_down_since[slot]);
+      if (dt < RECONNECT_GRACE_SEC)
+        continue;
+
+      // Grace vypršela: informujeme protivníka a zavíráme roomku
+      int opp = (slot == 0) ? 1 : 0;
+      if (r->slot_connected[opp] && r->player_fds[opp] >= 0) {
+        Player *op = find_player_by_fd(players, r->player_fds[opp]);
+        if (op) {
+          net_send_lit(op->socket_fd, "OPPONENT_TIMEOUT\n");
+          net_send_lit(op->socket_fd, "ROOM_CLOSED TIMEOUT\n");
+          net_send_lit(op->socket_fd, "RETURNED_TO_LOBBY\n");
+        }
+      }
+
+      log_info("room=%d slot=%d timeout -> destroy", r->id, slot);
+
+      // Zrušíme hru navázanou na roomku (stejný index jako v rooms[])
+      Game *g = game_for_room(r, games);
+      game_reset(g);
+
+      // Odpojíme VŠECHNY hráče navázané na tuto roomku:
+      // - připojeným pošleme info a vrátíme je do lobby
+      // - ghost sloty pro rejoin tvrdě uvolníme (player_reset)
+      for (int pi = 0; pi < MAX_PLAYERS; pi++) {
+        Player *pp = &players[pi];
+        if (pp->is_identified && seated_in(pp, r)) {
+          if (pp->socket_fd >= 0) {
+            net_send_lit(pp->socket_fd, "ROOM_CLOSED TIMEOUT\n");
+            net_send_lit(pp->socket_fd, "RETURNED_TO_LOBBY\n");
+
+            // připojený hráč: fd necháme být, jen zrušíme vazbu na roomku
+            pp->current_room_id = -1;
+            pp->player_slot = -1;
+          } else {
+            // ghost slot: uvolníme celý záznam, aby se dal znovu použít
+            player_reset(pp);
+          }
+        }
+      }
+
+      spec_room_closed(r, players);
+      wal_room_closed(r->id);
+      room_reset(r);
+      break;
+    }
+  }
+  net_tag_clear();
+}
+
 void protocol_heartbeat_tick(Room rooms[], Game games[], Player players[]) {
-  time_t now = time(NULL);
+  TRACE_SCOPE("heartbeat", 0);
+  time_t now = net_now();
 
   for (int i = 0; i < MAX_PLAYERS; i++) {
     Player *p = &players[i];
@@ -954,13 +2252,18 @@ void protocol_heartbeat_tick(Room rooms[], Game games[], Player players[]) {
 
     // Heartbeat: periodicky pošleme PING, čekáme na PONG. Když nepřijde několikrát po sobě, odpojíme.
     if (p->last_ping == 0 || (now - p->last_ping) >= HB_INTERVAL_SEC) {
-      net_send_all(p->socket_fd, "PING\n");
+      net_send_lit(p->socket_fd, "PING\n");
       p->last_ping = now;
 
-      p->hb_missed++;
+      // Zpožděný PONG může být vina přetíženého serveru: nepočítáme ho
+      if (load_level() != LOAD_CRITICAL) {
+        if (p->hb_missed > 0) // předchozí PING zůstal bez PONGu
+          PROBE2(hb__miss, p->socket_fd, p->hb_missed);
+        p->hb_missed++;
+      }
 
       if (p->hb_missed >= HB_MAX_MISSES) {
-        heartbeat_soft_disconnect(p, rooms, games, players);
+        protocol_disconnect(p, rooms, games, players, "heartbeat timeout");
       }
     }
   }
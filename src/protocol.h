@@ -3,11 +3,32 @@
 #include "game.h"
 #include "lobby.h"
 #include "net.h"
+#include <sys/select.h>
+
+// Úklid v protocol_tick: dohraná roomka bez REMATCH a roomka, ve které
+// host marně čeká na soupeře, se po takové době zavřou (ROOM_CLOSED IDLE)
+#define ROOM_FINISHED_IDLE_SEC 60
+#define ROOM_WAITING_IDLE_SEC 600
+
+// Příkazů za sekundu na spojení (token bucket); 0 = bez omezení
+extern int protocol_rate_cmds;
 
 void protocol_handle_line(Player *p, Room rooms[], Game games[],
                           Player players[], const char *line);
 void protocol_process_incoming(Player *p, Room rooms[], Game games[],
                                Player players[]);
+void protocol_process_pending(Player *p, Room rooms[], Game games[],
+                              Player players[]);
+// Data od hráčů za jednu iteraci: round-robin od start, aby nikdo nebyl
+// trvale první; kdo má odložené řádky, dostane další dávku z bufferu. Při
+// zátěži (level != LOAD_OK) jdou nejdřív hráči ve hře, lobby po nich; každý
+// nejvýš jednou. readable = výsledek select() nebo NULL.
+void protocol_serve(Room rooms[], Game games[], Player players[],
+                    const fd_set *readable, int level, int start);
 void protocol_heartbeat_tick(Room rooms[], Game games[], Player players[]);
-static void heartbeat_soft_disconnect(Player *p, Room rooms[], Game games[],
-                                      Player players[]);
+void protocol_tick(Room rooms[], Game games[], Player players[]);
+
+// Odpojení hráče (EOF, chyba, heartbeat): v SETUP/PLAY jen "down" + grace,
+// jinak zavření roomky. why jde do logu.
+void protocol_disconnect(Player *p, Room rooms[], Game games[],
+                         Player players[], const char *why);
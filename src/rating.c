@@ -0,0 +1,298 @@
+#include "rating.h"
+#include "log.h"
+#include "net.h"
+#include "wire.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Rated {
+  char name[32];
+  int rating;
+  unsigned games;
+  unsigned wins;
+  int bpos; // pozice v poli koše
+} Rated;
+
+// Hráči jednoho ratingu; pořadí uvnitř koše je libovolné, takže mazání je
+// výměna s posledním a i-tý hráč koše je přímý index (stránka od offsetu)
+typedef struct Bucket {
+  int *ids;
+  int count, cap;
+} Bucket;
+
+static Rated *rp = NULL; // hráči (index = id)
+static int rp_count = 0, rp_cap = 0;
+
+static int *slots = NULL; // hash nick -> index+1 (0 = prázdné), otevřené adresování
+static int slot_cap = 0;
+
+// Koš = rating; Fenwick indexuje sestupně (pozice 1 = nejvyšší rating),
+// prefix tedy počítá hráče s ratingem >= daného
+static Bucket buckets[RATING_MAX];
+static int fen[RATING_MAX + 1];
+
+static char top_cache[64 + RATING_TOP_N * 80];
+static size_t top_len = 0; // 0 = neplatná cache
+
+static inline int fen_pos(int rating) { return RATING_MAX - rating; }
+
+static void fen_add(int pos, int d) {
+  for (; pos <= RATING_MAX; pos += pos & -pos)
+    fen[pos] += d;
+}
+
+static int fen_prefix(int pos) {
+  int s = 0;
+  for (; pos > 0; pos -= pos & -pos)
+    s += fen[pos];
+  return s;
+}
+
+// Nejmenší pozice, jejíž prefix > k (k-tý hráč v pořadí od 0)
+static int fen_find(int k) {
+  int pos = 0;
+  for (int step = RATING_MAX; step > 0; step >>= 1) {
+    if (pos + step <= RATING_MAX && fen[pos + step] <= k) {
+      pos += step;
+      k -= fen[pos];
+    }
+  }
+  return pos + 1;
+}
+
+static uint32_t name_hash(const char *s) {
+  uint32_t h = 2166136261u; // FNV-1a
+  for (; *s; s++)
+    h = (h ^ (unsigned char)*s) * 16777619u;
+  return h;
+}
+
+static int find(const char *nick) {
+  if (!slot_cap)
+    return -1;
+  for (uint32_t i = name_hash(nick);; i++) {
+    int s = slots[i & (slot_cap - 1)];
+    if (s == 0)
+      return -1;
+    if (strcmp(rp[s - 1].name, nick) == 0)
+      return s - 1;
+  }
+}
+
+static int grow(void) {
+  if (rp_count == rp_cap) {
+    int cap = rp_cap ? rp_cap * 2 : 1024;
+    Rated *n = realloc(rp, sizeof(*rp) * (size_t)cap);
+    if (!n)
+      return 0;
+    rp = n;
+    rp_cap = cap;
+  }
+  // Hash tabulka nejvýš z poloviny plná
+  if ((rp_count + 1) * 2 > slot_cap) {
+    int cap = slot_cap ? slot_cap * 2 : 2048;
+    int *n = calloc((size_t)cap, sizeof(*n));
+    if (!n)
+      return 0;
+    for (int i = 0; i < rp_count; i++) {
+      uint32_t h = name_hash(rp[i].name);
+      while (n[h & (cap - 1)])
+        h++;
+      n[h & (cap - 1)] = i + 1;
+    }
+    free(slots);
+    slots = n;
+    slot_cap = cap;
+  }
+  return 1;
+}
+
+static void bucket_unlink(int id) {
+  Rated *p = &rp[id];
+  Bucket *b = &buckets[p->rating];
+  int last = b->ids[--b->count];
+  b->ids[p->bpos] = last;
+  rp[last].bpos = p->bpos;
+  fen_add(fen_pos(p->rating), -1);
+}
+
+static int bucket_link(int id) {
+  Rated *p = &rp[id];
+  Bucket *b = &buckets[p->rating];
+  if (b->count == b->cap) {
+    int cap = b->cap ? b->cap * 2 : 16;
+    int *n = realloc(b->ids, sizeof(*n) * (size_t)cap);
+    if (!n)
+      return 0;
+    b->ids = n;
+    b->cap = cap;
+  }
+  p->bpos = b->count;
+  b->ids[b->count++] = id;
+  fen_add(fen_pos(p->rating), 1);
+  return 1;
+}
+
+static int get_or_add(const char *nick) {
+  int id = find(nick);
+  if (id >= 0)
+    return id;
+  if (!grow()) {
+    log_error("rating: out of memory (%d players)", rp_count);
+    return -1;
+  }
+
+  id = rp_count++;
+  Rated *p = &rp[id];
+  memset(p, 0, sizeof(*p));
+  strncpy(p->name, nick, sizeof(p->name) - 1);
+  p->rating = RATING_START;
+  if (!bucket_link(id)) {
+    rp_count--;
+    log_error("rating: out of memory (%d players)", rp_count);
+    return -1;
+  }
+
+  uint32_t h = name_hash(p->name);
+  while (slots[h & (slot_cap - 1)])
+    h++;
+  slots[h & (slot_cap - 1)] = id + 1;
+  return id;
+}
+
+static void set_rating(int id, int rating) {
+  if (rating < 0)
+    rating = 0;
+  if (rating > RATING_MAX - 1)
+    rating = RATING_MAX - 1;
+  if (rating == rp[id].rating)
+    return;
+  int old = rp[id].rating;
+  bucket_unlink(id);
+  rp[id].rating = rating;
+  if (!bucket_link(id)) { // bez paměti zůstane starý rating
+    rp[id].rating = old;
+    bucket_link(id); // místo po odebrání v koši zůstalo
+  }
+}
+
+void rating_record(const char *winner, const char *loser) {
+  if (!winner || !loser || !winner[0] || !loser[0] ||
+      strcmp(winner, loser) == 0)
+    return;
+  int w = get_or_add(winner);
+  int l = get_or_add(loser);
+  if (w < 0 || l < 0)
+    return;
+
+  // Elo: očekávaný výsledek vítěze, změna zaokrouhlená, aspoň 1 bod
+  double ew = 1.0 / (1.0 + pow(10.0, (rp[l].rating - rp[w].rating) / 400.0));
+  int delta = (int)lround(RATING_K * (1.0 - ew));
+  if (delta < 1)
+    delta = 1;
+
+  set_rating(w, rp[w].rating + delta);
+  set_rating(l, rp[l].rating - delta);
+  rp[w].games++;
+  rp[w].wins++;
+  rp[l].games++;
+  top_len = 0;
+}
+
+int rating_players(void) { return rp_count; }
+
+int rating_rank(const char *nick, int *rank, int *rating) {
+  int id = find(nick);
+  if (id < 0)
+    return 0;
+  if (rank)
+    *rank = 1 + fen_prefix(fen_pos(rp[id].rating) - 1);
+  if (rating)
+    *rating = rp[id].rating;
+  return 1;
+}
+
+static size_t render_page(char *buf, size_t cap, int offset, int count) {
+  if (offset > rp_count)
+    offset = rp_count;
+  if (count > rp_count - offset)
+    count = rp_count - offset;
+
+  Wire w = {buf, 0, cap, 0};
+  wire_lit(&w, "LEADERBOARD ");
+  wire_int(&w, rp_count);
+  wire_char(&w, ' ');
+  wire_int(&w, offset);
+  wire_char(&w, ' ');
+  wire_int(&w, count);
+  wire_char(&w, '\n');
+  if (count <= 0)
+    return w.len;
+
+  // Začátek stránky přes Fenwick, dál se jde po koších dolů
+  int pos = fen_find(offset);
+  int before = fen_prefix(pos - 1); // hráči s vyšším ratingem
+  const Bucket *b = &buckets[RATING_MAX - pos];
+  int i = offset - before;
+
+  for (int n = 0; n < count; n++, i++) {
+    if (i == b->count) { // další neprázdný koš
+      before += b->count;
+      pos = fen_find(before);
+      b = &buckets[RATING_MAX - pos];
+      i = 0;
+    }
+    const Rated *p = &rp[b->ids[i]];
+    wire_lit(&w, "LB ");
+    wire_int(&w, before + 1);
+    wire_char(&w, ' ');
+    wire_str(&w, p->name);
+    wire_char(&w, ' ');
+    wire_int(&w, p->rating);
+    wire_char(&w, ' ');
+    wire_uint(&w, p->games);
+    wire_char(&w, ' ');
+    wire_uint(&w, p->wins);
+    wire_char(&w, '\n');
+  }
+  return w.len;
+}
+
+void rating_send_leaderboard(int fd, int offset, int count) {
+  if (offset < 0)
+    offset = 0;
+  if (count <= 0 || count > RATING_PAGE_MAX)
+    count = (count <= 0) ? RATING_TOP_N : RATING_PAGE_MAX;
+
+  if (offset == 0 && count == RATING_TOP_N) {
+    if (top_len == 0)
+      top_len = render_page(top_cache, sizeof(top_cache), 0, RATING_TOP_N);
+    net_send(fd, top_cache, top_len);
+    return;
+  }
+
+  char buf[64 + RATING_PAGE_MAX * 80];
+  net_send(fd, buf, render_page(buf, sizeof(buf), offset, count));
+}
+
+void rating_send_rank(int fd, const char *nick) {
+  int rank, rating;
+  if (!rating_rank(nick, &rank, &rating)) {
+    net_send_lit(fd, "ERROR NOT_RATED\n");
+    return;
+  }
+  char buf[96];
+  Wire w = WIRE_INIT(buf);
+  wire_lit(&w, "RANK ");
+  wire_int(&w, rank);
+  wire_char(&w, ' ');
+  wire_int(&w, rating);
+  wire_char(&w, ' ');
+  wire_int(&w, rp_count);
+  wire_char(&w, ' ');
+  wire_str(&w, nick);
+  wire_char(&w, '\n');
+  net_send(fd, w.p, w.len);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Elo rating hráčů a žebříček. Pořadí drží Fenwickův strom nad koši ratingu
+// (jeden koš = jeden bod), takže RANK i začátek stránky LEADERBOARD stojí
+// O(log RATING_MAX) bez ohledu na počet hráčů; hráči se stejným ratingem
+// jsou v poli svého koše. Nejčastější dotaz (první stránka)
+// se drží předserializovaný a přestaví se až po změně ratingu.
+
+#define RATING_MAX 4096    // ratingy 0..RATING_MAX-1 (= počet košů)
+#define RATING_START 1500
+#define RATING_K 32        // Elo K-faktor
+#define RATING_PAGE_MAX 50 // nejvíc řádků na jeden LEADERBOARD
+#define RATING_TOP_N 10    // výchozí (cachovaná) stránka
+
+// Výsledek hry: oba hráči se případně založí s RATING_START
+void rating_record(const char *winner, const char *loser);
+
+// 1 = hráč má rating; rank = 1 + počet hráčů s vyšším ratingem
+int rating_rank(const char *nick, int *rank, int *rating);
+int rating_players(void);
+
+// "LEADERBOARD <total> <offset> <n>" + n x "LB <rank> <nick> <rating> <games> <wins>"
+void rating_send_leaderboard(int fd, int offset, int count);
+// "RANK <rank> <rating> <total> <nick>" nebo ERROR NOT_RATED
+void rating_send_rank(int fd, const char *nick);
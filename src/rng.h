@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// Rychlý nekryptografický generátor (xorshift64*); stav drží volající,
+// takže každé vlákno / simulace může mít vlastní
+static inline uint64_t rng_next(uint64_t *s) {
+  uint64_t x = *s;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *s = x;
+  return x * 0x2545F4914F6CDD1Dull;
+}
+
+static inline unsigned rng_below(uint64_t *s, unsigned n) {
+  return (unsigned)((rng_next(s) >> 32) % n);
+}
+
+static inline void rng_seed(uint64_t *s, uint64_t seed) {
+  *s = seed ? seed : 0x9E3779B97F4A7C15ull;
+}
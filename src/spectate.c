@@ -0,0 +1,221 @@
+#include "spectate.h"
+#include "log.h"
+#include "trace.h"
+#include "wire.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int spec_delay_sec = SPECTATE_DELAY_SEC;
+
+// Zpožděný přenos: zprávy roomky čekají v jednom logu na roomku a do front
+// diváků jdou, až dozrají. Ve frontě spojení (OUTQ_MAX) je tak jen to, co se
+// už smí odeslat, a limit pomalého čtenáře měří čtení, ne délku zpoždění.
+// Divák dostává zprávy logu od doručení svého úvodního snímku (spec_feed)
+// do doručení WATCH_END, takže roomka zavřená a hned znovu obsazená pod
+// stejným id se mu nepomíchá s novou.
+typedef struct SpecDelayed {
+  SharedBuf *b;
+  uint32_t watch; // != 0: úvodní snímek pro divákovo WATCH s tímto id
+  int fd;         // komu je snímek určen
+  int end;        // WATCH_END: po doručení divák z logu odchází
+} SpecDelayed;
+
+typedef struct SpecLog {
+  SpecDelayed *items; // kruhový buffer, roste podle potřeby
+  int cap;
+  int head;
+  int count;
+} SpecLog;
+
+static SpecLog spec_logs[MAX_ROOMS];
+static uint32_t spec_watch_seq;
+
+static void spec_drop_slow(Player *p) {
+  // Fronta je plná: spectator nestíhá číst, přestane sledovat (hráče to neblokuje)
+  log_warn("fd=%d spectator too slow -> unwatch room=%d", p->socket_fd,
+           p->watching_room_id);
+  spec_unwatch(p);
+  net_send_lit(p->socket_fd, "WATCH_END SLOW\n");
+}
+
+static void spec_log_push(const Room *r, SharedBuf *b, uint32_t watch, int fd,
+                          int end) {
+  int idx = room_index(r);
+  if (idx < 0)
+    return;
+  SpecLog *l = &spec_logs[idx];
+  if (l->count == l->cap) {
+    if (l->cap >= SPEC_LOG_MAX) {
+      log_warn("room=%d delayed spectator log full, message dropped", r->id);
+      return;
+    }
+    int cap = l->cap ? 2 * l->cap : 64;
+    SpecDelayed *items = malloc((size_t)cap * sizeof(*items));
+    if (!items)
+      return;
+    for (int i = 0; i < l->count; i++)
+      items[i] = l->items[(l->head + i) % l->cap];
+    free(l->items);
+    l->items = items;
+    l->cap = cap;
+    l->head = 0;
+  }
+  SpecDelayed e = {b, watch, fd, end};
+  l->items[(l->head + l->count) % l->cap] = e;
+  l->count++;
+  sbuf_retain(b);
+}
+
+void spec_watch(Player *p, const Room *r, const Game *g) {
+  if (!p || !r)
+    return;
+
+  spec_unwatch(p);
+  p->watching_room_id = r->id;
+
+  char out[32];
+  Wire w = WIRE_INIT(out);
+  wire_lit(&w, "WATCHING ");
+  wire_int(&w, r->id);
+  wire_char(&w, '\n');
+  net_send(p->socket_fd, w.p, w.len);
+
+  // Úvodní snímek jde stejnou cestou jako živé události, takže platí i zpoždění
+  char snap[2048];
+  Wire sw = WIRE_INIT(snap);
+  wire_lit(&sw, "SPEC_PHASE ");
+  wire_str(&sw, room_phase_str(r->phase));
+  wire_char(&sw, '\n');
+  if (g && g->in_use) {
+    if (r->phase == PHASE_PLAY) {
+      wire_lit(&sw, "SPEC_TURN ");
+      wire_int(&sw, g->turn + 1);
+      wire_char(&sw, '\n');
+    }
+    sw.len += (size_t)game_render_public(g, snap + sw.len,
+                                         (int)(sizeof(snap) - sw.len));
+  }
+
+  SharedBuf *b = sbuf_new(snap, sw.len, net_now() + spec_delay_sec);
+  if (!b)
+    return;
+  if (spec_delay_sec > 0) {
+    if (++spec_watch_seq == 0)
+      spec_watch_seq = 1;
+    p->spec_watch = spec_watch_seq;
+    spec_log_push(r, b, p->spec_watch, p->socket_fd, 0);
+  } else if (!outq_push(&p->outq, b)) {
+    spec_drop_slow(p);
+  }
+  sbuf_release(b);
+}
+
+void spec_unwatch(Player *p) {
+  if (!p)
+    return;
+  p->watching_room_id = -1;
+  p->spec_watch = 0;
+  p->spec_feed = 0;
+  p->lobby_sub = 0; // fronta je jedna: končí i odběr lobby
+  outq_clear(&p->outq);
+}
+
+static void publish(const Room *r, Player players[], const char *msg, int end) {
+  if (!r || !players || !msg)
+    return;
+
+  // Zprávu serializujeme až u prvního diváka a jen jednou; ostatní dostanou odkaz
+  SharedBuf *b = NULL;
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    Player *p = &players[i];
+    if (p->socket_fd < 0 || p->watching_room_id != r->id)
+      continue;
+
+    if (!b) {
+      b = sbuf_new(msg, strlen(msg), net_now() + spec_delay_sec);
+      if (!b)
+        return;
+      if (spec_delay_sec > 0) {
+        spec_log_push(r, b, 0, -1, end); // diváky vybere až doručení
+        break;
+      }
+    }
+    if (!outq_push(&p->outq, b))
+      spec_drop_slow(p);
+  }
+  sbuf_release(b);
+}
+
+void spec_publish(const Room *r, Player players[], const char *msg) {
+  publish(r, players, msg, 0);
+}
+
+void spec_room_closed(const Room *r, Player players[]) {
+  if (!r || !players)
+    return;
+
+  char msg[32];
+  Wire w = WIRE_INIT(msg);
+  wire_lit(&w, "WATCH_END ");
+  wire_int(&w, r->id);
+  wire_char(&w, '\n');
+  publish(r, players, wire_cstr(&w), 1);
+
+  // Frontu (i zpožděný log) necháváme doběhnout, jen zrušíme vazbu na roomku
+  for (int i = 0; i < MAX_PLAYERS; i++)
+    if (players[i].watching_room_id == r->id)
+      players[i].watching_room_id = -1;
+}
+
+// Dozrálé zprávy logu roomky idx do front jejích diváků
+static void spec_log_deliver(int idx, Player players[], time_t now) {
+  SpecLog *l = &spec_logs[idx];
+  while (l->count > 0) {
+    SpecDelayed *e = &l->items[l->head];
+    if (e->b->ready_at > now)
+      break;
+
+    if (e->watch) {
+      // Snímek platí, jen dokud divák neodešel (spec_unwatch nuluje spec_watch)
+      Player *p = find_player_by_fd(players, e->fd);
+      if (p && p->spec_watch == e->watch) {
+        p->spec_watch = 0;
+        p->spec_feed = idx + 1;
+        if (!outq_push(&p->outq, e->b))
+          spec_drop_slow(p);
+      }
+    } else {
+      for (int i = 0; i < MAX_PLAYERS; i++) {
+        Player *p = &players[i];
+        if (p->socket_fd < 0 || p->spec_feed != idx + 1)
+          continue;
+        if (!outq_push(&p->outq, e->b)) {
+          spec_drop_slow(p);
+          continue;
+        }
+        if (e->end)
+          p->spec_feed = 0;
+      }
+    }
+
+    sbuf_release(e->b);
+    l->head = (l->head + 1) % l->cap;
+    l->count--;
+  }
+}
+
+void spec_flush(Player players[]) {
+  TRACE_SCOPE("flush_spectators", 0);
+  time_t now = net_now();
+  if (spec_delay_sec > 0)
+    for (int i = 0; i < MAX_ROOMS; i++)
+      spec_log_deliver(i, players, now);
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    Player *p = &players[i];
+    if (p->socket_fd < 0 || p->outq.count == 0)
+      continue;
+    if (outq_flush(&p->outq, p->socket_fd, now) < 0)
+      outq_clear(&p->outq); // chyba socketu; odpojení vyřeší recv()
+  }
+}
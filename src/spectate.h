@@ -0,0 +1,20 @@
+#pragma once
+
+#include "game.h"
+#include "lobby.h"
+#include "net.h"
+
+// Výchozí zpoždění přenosu pro spectatory (0 = živě)
+#define SPECTATE_DELAY_SEC 0
+// Nejvýš zpráv čekajících na zpoždění v logu jedné roomky (pojistka proti
+// extrémnímu --watch-delay); nad limit se zprávy zahazují
+#define SPEC_LOG_MAX 65536
+
+extern int spec_delay_sec;
+
+void spec_watch(Player *p, const Room *r, const Game *g);
+void spec_unwatch(Player *p);
+
+void spec_publish(const Room *r, Player players[], const char *msg);
+void spec_room_closed(const Room *r, Player players[]);
+void spec_flush(Player players[]);
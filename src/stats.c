@@ -0,0 +1,180 @@
+#define _POSIX_C_SOURCE 200112L
+#include "stats.h"
+#include "common.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static StatsFile *sf = NULL;
+static pthread_t st_thread;
+static int st_stop = 0;
+
+// SPSC fronta: head posouvá jen smyčka, tail jen vlákno statistik.
+// Každý index má vlastní cache line, aby si strany nepřetahovaly řádek.
+static GameResult ring[STATS_RING];
+static _Alignas(CACHE_LINE) uint32_t ring_head;
+static _Alignas(CACHE_LINE) uint32_t ring_tail;
+static _Alignas(CACHE_LINE) uint64_t dropped;
+
+int stats_enabled(void) { return sf != NULL; }
+
+uint64_t stats_dropped(void) { return dropped; }
+
+int stats_push(const GameResult *res) {
+  if (!sf)
+    return 0;
+  uint32_t h = ring_head;
+  uint32_t t = __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE);
+  if (h - t == STATS_RING) {
+    dropped++;
+    return 0;
+  }
+  ring[h & (STATS_RING - 1)] = *res;
+  __atomic_store_n(&ring_head, h + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+// --- vlákno statistik ---
+
+static uint32_t name_hash(const char *s) {
+  uint32_t h = 2166136261u; // FNV-1a
+  for (; *s; s++)
+    h = (h ^ (unsigned char)*s) * 16777619u;
+  return h;
+}
+
+// Slot hráče v tabulce (lineární sondování); NULL = tabulka plná
+static PlayerStats *player_slot(const char *name) {
+  uint32_t i = name_hash(name);
+  for (int probe = 0; probe < STATS_MAX_PLAYERS; probe++, i++) {
+    PlayerStats *ps = &sf->players[i & (STATS_MAX_PLAYERS - 1)];
+    if (ps->name[0] == '\0') {
+      memcpy(ps->name, name, STATS_NAME - 1);
+      return ps;
+    }
+    if (strncmp(ps->name, name, STATS_NAME) == 0)
+      return ps;
+  }
+  return NULL;
+}
+
+static void apply(const GameResult *res) {
+  for (int slot = 0; slot < 2; slot++) {
+    if (res->names[slot][0] == '\0')
+      continue;
+    PlayerStats *ps = player_slot(res->names[slot]);
+    if (!ps) {
+      sf->table_full++;
+      continue;
+    }
+    ps->games++;
+    if (res->winner == slot)
+      ps->wins++;
+    ps->shots += res->shots[slot];
+    ps->hits += res->hits[slot];
+    if (res->ended_at > res->started_at)
+      ps->play_sec += (uint64_t)(res->ended_at - res->started_at);
+    ps->last_played = res->ended_at;
+  }
+  sf->history[sf->history_next % STATS_HISTORY] = *res;
+  sf->history_next++;
+  sf->games++;
+}
+
+static int drain(void) {
+  uint32_t t = ring_tail;
+  uint32_t h = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+  int n = 0;
+  for (; t != h; t++, n++)
+    apply(&ring[t & (STATS_RING - 1)]);
+  __atomic_store_n(&ring_tail, t, __ATOMIC_RELEASE);
+  return n;
+}
+
+static void *stats_main(void *arg) {
+  (void)arg;
+  struct timespec ts = {0, STATS_COMMIT_MS * 1000000L};
+  for (;;) {
+    int stop = __atomic_load_n(&st_stop, __ATOMIC_ACQUIRE);
+    // Všechno, co se za periodu nasbíralo, jde na disk jedním msync
+    if (drain() > 0)
+      msync(sf, sizeof(*sf), MS_SYNC);
+    if (stop)
+      break;
+    nanosleep(&ts, NULL);
+  }
+  return NULL;
+}
+
+int stats_open(const char *path) {
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    log_error("stats: cannot open '%s' (errno=%d)", path, errno);
+    return 0;
+  }
+
+  struct stat st;
+  int fresh = (fstat(fd, &st) == 0 && st.st_size == 0);
+  if (fresh && ftruncate(fd, sizeof(StatsFile)) != 0) {
+    log_error("stats: cannot size '%s' (errno=%d)", path, errno);
+    close(fd);
+    return 0;
+  }
+  if (!fresh && st.st_size != (off_t)sizeof(StatsFile)) {
+    log_error("stats: '%s' has unexpected size, refusing", path);
+    close(fd);
+    return 0;
+  }
+
+  void *m = mmap(NULL, sizeof(StatsFile), PROT_READ | PROT_WRITE, MAP_SHARED,
+                 fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) {
+    log_error("stats: mmap '%s' failed (errno=%d)", path, errno);
+    return 0;
+  }
+
+  StatsFile *f = m;
+  if (fresh) {
+    f->magic = STATS_MAGIC;
+    f->version = STATS_VERSION;
+    f->max_players = STATS_MAX_PLAYERS;
+    f->history_size = STATS_HISTORY;
+  } else if (f->magic != STATS_MAGIC || f->version != STATS_VERSION ||
+             f->max_players != STATS_MAX_PLAYERS ||
+             f->history_size != STATS_HISTORY) {
+    log_error("stats: '%s' is not a compatible stats file", path);
+    munmap(m, sizeof(StatsFile));
+    return 0;
+  }
+
+  sf = f;
+  st_stop = 0;
+  if (pthread_create(&st_thread, NULL, stats_main, NULL) != 0) {
+    log_error("stats: cannot start thread");
+    munmap(m, sizeof(StatsFile));
+    sf = NULL;
+    return 0;
+  }
+  log_info("stats: '%s' (%llu games so far)", path,
+           (unsigned long long)f->games);
+  return 1;
+}
+
+void stats_close(void) {
+  if (!sf)
+    return;
+  __atomic_store_n(&st_stop, 1, __ATOMIC_RELEASE);
+  pthread_join(st_thread, NULL);
+  if (dropped)
+    log_warn("stats: %llu result(s) dropped (queue full)",
+             (unsigned long long)dropped);
+  munmap(sf, sizeof(*sf));
+  sf = NULL;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// Statistiky dohraných her. Smyčka výsledek jen vloží do lock-free SPSC
+// fronty (stats_push); vlákno na pozadí ho započítá do per-hráčských
+// součtů a historie v mmapovaném souboru a zapisuje (msync) po dávkách.
+
+#define STATS_MAGIC 0x54535342u // "BSST"
+#define STATS_VERSION 1
+#define STATS_RING 4096         // fronta výsledků (mocnina dvou)
+#define STATS_MAX_PLAYERS 4096  // sloty tabulky hráčů (mocnina dvou)
+#define STATS_HISTORY 1024      // posledních N her v souboru
+#define STATS_COMMIT_MS 200     // perioda vybírání fronty = skupinový commit
+#define STATS_NAME 32
+
+typedef struct GameResult {
+  char names[2][STATS_NAME];
+  uint8_t variant;
+  uint8_t winner; // slot vítěze
+  uint8_t bot_level;
+  uint8_t pad;
+  uint32_t shots[2];
+  uint32_t hits[2];
+  int64_t started_at; // unix time začátku PLAY
+  int64_t ended_at;
+} GameResult;
+
+typedef struct PlayerStats {
+  char name[STATS_NAME]; // "" = volný slot
+  uint32_t games;
+  uint32_t wins;
+  uint64_t shots;
+  uint64_t hits; // přesnost = hits / shots
+  uint64_t play_sec;
+  int64_t last_played;
+} PlayerStats;
+
+// Obsah souboru (mapuje se celý); hlavička se mění jen z vlákna statistik
+typedef struct StatsFile {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t max_players;
+  uint32_t history_size;
+  uint64_t games;        // započítaných her celkem
+  uint64_t history_next; // pořadí další hry; index = history_next % STATS_HISTORY
+  uint64_t table_full;   // hry, jejichž hráč se do tabulky nevešel
+  PlayerStats players[STATS_MAX_PLAYERS];
+  GameResult history[STATS_HISTORY];
+} StatsFile;
+
+int stats_open(const char *path); // namapuje soubor a spustí vlákno
+void stats_close(void);           // dočerpá frontu, msync, ukončí vlákno
+int stats_enabled(void);
+
+// Jediné, co platí smyčka: kopie do fronty. 0 = fronta plná, výsledek zahozen
+int stats_push(const GameResult *res);
+uint64_t stats_dropped(void);
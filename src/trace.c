@@ -0,0 +1,147 @@
+#define _POSIX_C_SOURCE 200112L
+#include "trace.h"
+#include "log.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct TraceEvent {
+  const char *name;
+  uint64_t ts;  // ns od startu trasování
+  uint64_t dur; // ns
+  int arg;
+} TraceEvent;
+
+typedef struct TraceBuf {
+  TraceEvent ev[TRACE_BUF_EVENTS];
+  int head;  // další volná pozice
+  int count; // platných záznamů (<= TRACE_BUF_EVENTS)
+  int tid;
+} TraceBuf;
+
+int trace_on = 0;
+
+static uint64_t trace_epoch = 0;
+static const char *rotate_base = NULL;
+static int rotate_seq = 0;
+static int dump_seq = 0;
+static int next_tid = 1;
+static volatile sig_atomic_t dump_requested = 0;
+
+// Buffer vlákna se alokuje až při prvním spanu (vlákna bez spanů nic nestojí)
+static _Thread_local TraceBuf *tbuf = NULL;
+
+uint64_t trace_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static TraceBuf *thread_buf(void) {
+  if (!tbuf) {
+    tbuf = malloc(sizeof(*tbuf));
+    if (!tbuf)
+      return NULL;
+    tbuf->head = 0;
+    tbuf->count = 0;
+    tbuf->tid = __atomic_fetch_add(&next_tid, 1, __ATOMIC_RELAXED);
+  }
+  return tbuf;
+}
+
+static int write_json(const char *path, TraceBuf *b) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    log_error("trace: cannot write '%s'", path);
+    return 0;
+  }
+
+  fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  int first = (b->head - b->count + TRACE_BUF_EVENTS) % TRACE_BUF_EVENTS;
+  for (int i = 0; i < b->count; i++) {
+    const TraceEvent *e = &b->ev[(first + i) % TRACE_BUF_EVENTS];
+    fprintf(f,
+            "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+            "\"pid\":%d,\"tid\":%d,\"args\":{\"fd\":%d}}\n",
+            i ? "," : "", e->name, (double)e->ts / 1000.0,
+            (double)e->dur / 1000.0, (int)getpid(), b->tid, e->arg);
+  }
+  fprintf(f, "]}\n");
+  fclose(f);
+  return 1;
+}
+
+static void rotate_out(TraceBuf *b) {
+  // Rotace: PATH.0 .. PATH.(KEEP-1), nejstarší se přepisuje
+  char path[512];
+  snprintf(path, sizeof(path), "%s.%d", rotate_base,
+           rotate_seq % TRACE_ROTATE_KEEP);
+  rotate_seq++;
+  write_json(path, b);
+  b->head = 0;
+  b->count = 0;
+}
+
+void trace_record(const char *name, uint64_t t0, uint64_t t1, int arg) {
+  TraceBuf *b = thread_buf();
+  if (!b)
+    return;
+
+  // Bez rotace je buffer kruhový (drží posledních TRACE_BUF_EVENTS spanů)
+  if (b->count == TRACE_BUF_EVENTS && rotate_base)
+    rotate_out(b);
+
+  TraceEvent *e = &b->ev[b->head];
+  e->name = name;
+  e->ts = t0 - trace_epoch;
+  e->dur = t1 - t0;
+  e->arg = arg;
+  b->head = (b->head + 1) % TRACE_BUF_EVENTS;
+  if (b->count < TRACE_BUF_EVENTS)
+    b->count++;
+}
+
+static void on_sigusr1(int sig) {
+  (void)sig;
+  dump_requested = 1;
+}
+
+void trace_enable(const char *rotate_path) {
+  trace_epoch = trace_now_ns();
+  rotate_base = rotate_path;
+  trace_on = 1;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_sigusr1;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0; // select() se přeruší (EINTR) a smyčka hned dumpne
+  sigaction(SIGUSR1, &sa, NULL);
+
+  if (rotate_path)
+    log_info("tracing on, rotating into '%s.N'", rotate_path);
+  else
+    log_info("tracing on, dump with: kill -USR1 %d", (int)getpid());
+}
+
+void trace_request_dump(void) { dump_requested = 1; }
+
+void trace_poll(void) {
+  // Volá hlavní smyčka: dump na vyžádání se zapíše mimo obsluhu signálu
+  if (!trace_on || !dump_requested)
+    return;
+  dump_requested = 0;
+
+  TraceBuf *b = thread_buf();
+  if (!b)
+    return;
+  char path[64];
+  snprintf(path, sizeof(path), "trace-%d-%d.json", (int)getpid(), dump_seq++);
+  if (write_json(path, b))
+    log_info("trace: %d spans written to '%s'", b->count, path);
+  b->head = 0;
+  b->count = 0;
+}
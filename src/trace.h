@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+// Volitelné trasování (Chrome trace-event JSON). Vypnuté = jedna větev na span.
+// Spany se ukládají do paměťového bufferu vlákna; na disk jdou buď na
+// vyžádání (SIGUSR1 -> trace_poll), nebo rotací souborů při zaplnění.
+
+#define TRACE_BUF_EVENTS 65536
+#define TRACE_ROTATE_KEEP 4
+
+typedef struct TraceSpan {
+  const char *name;
+  uint64_t t0; // 0 = trasování vypnuté
+  int arg;
+} TraceSpan;
+
+extern int trace_on;
+
+void trace_enable(const char *rotate_path);
+void trace_request_dump(void);
+void trace_poll(void);
+
+uint64_t trace_now_ns(void);
+void trace_record(const char *name, uint64_t t0, uint64_t t1, int arg);
+
+static inline TraceSpan trace_begin(const char *name, int arg) {
+  TraceSpan s = {name, trace_on ? trace_now_ns() : 0, arg};
+  return s;
+}
+
+static inline void trace_end(TraceSpan *s) {
+  if (s->t0)
+    trace_record(s->name, s->t0, trace_now_ns(), s->arg);
+}
+
+// Span přes celý blok: konec se zapíše automaticky při opuštění scope
+// (i přes return uprostřed handleru)
+#define TRACE_SCOPE(name, arg)                                                 \
+  TraceSpan trace_scope_ __attribute__((cleanup(trace_end))) =                 \
+      trace_begin((name), (arg))
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Transport: jediné místo, kde protokol/hra sahá na "vnější svět".
+// Spojení je identifikováno číslem (u socketů fd, jinde libovolné id >= 0).
+// Výchozí je transport_socket; testy a simulátor si dosadí vlastní.
+typedef struct Transport {
+  const char *name;
+
+  // Zapíše až len bajtů. nonblock=1 -> nesmí čekat (vrací -1 + EAGAIN).
+  // Vrací počet zapsaných bajtů, nebo -1 a errno jako send().
+  ssize_t (*send)(int conn, const char *data, size_t len, int nonblock);
+
+  void (*close)(int conn);
+
+  // Hodiny pro timeouty (reconnect grace, heartbeat, zpožděný WATCH)
+  time_t (*now)(void);
+} Transport;
+
+extern const Transport transport_socket;
+
+void net_set_transport(const Transport *t);
+const Transport *net_transport(void);
+
+ssize_t net_send_some(int conn, const char *data, size_t len);
+void net_close(int conn);
+time_t net_now(void);
@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200112L
+#include "transport_mem.h"
+#include <errno.h>
+#include <string.h>
+
+typedef struct MemConn {
+  int open;
+  size_t len;
+  char out[MEM_OUT_SIZE + 1]; // +1 pro '\0' (strstr v transport_mem_contains)
+} MemConn;
+
+static MemConn conns[MEM_MAX_CONN];
+static time_t clock_now;
+static uint64_t total_bytes, total_msgs;
+
+static ssize_t mem_send(int conn, const char *data, size_t len, int nonblock) {
+  (void)nonblock; // paměť se nikdy "nezaplní"
+  if (conn < 0 || conn >= MEM_MAX_CONN || !conns[conn].open) {
+    errno = EPIPE;
+    return -1;
+  }
+
+  MemConn *c = &conns[conn];
+  total_bytes += len;
+  total_msgs++;
+
+  // Drží se jen posledních MEM_OUT_SIZE bajtů
+  if (len >= MEM_OUT_SIZE) {
+    memcpy(c->out, data + len - MEM_OUT_SIZE, MEM_OUT_SIZE);
+    c->len = MEM_OUT_SIZE;
+  } else {
+    if (c->len + len > MEM_OUT_SIZE) {
+      // Zahodí se aspoň polovina, aby se memmove neplatil u každé zprávy
+      size_t drop = c->len + len - MEM_OUT_SIZE;
+      if (drop < MEM_OUT_SIZE / 2)
+        drop = MEM_OUT_SIZE / 2;
+      if (drop > c->len)
+        drop = c->len;
+      memmove(c->out, c->out + drop, c->len - drop);
+      c->len -= drop;
+    }
+    memcpy(c->out + c->len, data, len);
+    c->len += len;
+  }
+  c->out[c->len] = '\0';
+  return (ssize_t)len;
+}
+
+static void mem_close(int conn) {
+  if (conn >= 0 && conn < MEM_MAX_CONN)
+    conns[conn].open = 0;
+}
+
+static time_t mem_now(void) { return clock_now; }
+
+const Transport transport_mem = {"mem", mem_send, mem_close, mem_now};
+
+void transport_mem_reset(time_t start) {
+  memset(conns, 0, sizeof(conns));
+  clock_now = start;
+  total_bytes = 0;
+  total_msgs = 0;
+}
+
+void transport_mem_advance(int sec) { clock_now += sec; }
+
+int transport_mem_open(int conn) {
+  if (conn < 0 || conn >= MEM_MAX_CONN)
+    return 0;
+  conns[conn].open = 1;
+  conns[conn].len = 0;
+  conns[conn].out[0] = '\0';
+  return 1;
+}
+
+int transport_mem_is_closed(int conn) {
+  return conn < 0 || conn >= MEM_MAX_CONN || !conns[conn].open;
+}
+
+const char *transport_mem_output(int conn, size_t *len) {
+  if (conn < 0 || conn >= MEM_MAX_CONN) {
+    if (len)
+      *len = 0;
+    return "";
+  }
+  if (len)
+    *len = conns[conn].len;
+  return conns[conn].out;
+}
+
+void transport_mem_clear(int conn) {
+  if (conn < 0 || conn >= MEM_MAX_CONN)
+    return;
+  conns[conn].len = 0;
+  conns[conn].out[0] = '\0';
+}
+
+int transport_mem_contains(int conn, const char *needle) {
+  if (conn < 0 || conn >= MEM_MAX_CONN)
+    return 0;
+  return strstr(conns[conn].out, needle) != NULL;
+}
+
+uint64_t transport_mem_bytes(void) { return total_bytes; }
+
+uint64_t transport_mem_messages(void) { return total_msgs; }
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "transport.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// In-memory transport: výstup každého spojení jde do vlastního bufferu,
+// čas je virtuální a posouvá ho volající. Pro simulátor a offline testy.
+
+#define MEM_MAX_CONN 256
+#define MEM_OUT_SIZE 8192 // drží se konec výstupu (aspoň půlka), starší data se zahazují
+
+extern const Transport transport_mem;
+
+void transport_mem_reset(time_t start);
+void transport_mem_advance(int sec);
+
+// Připraví spojení (id = index 0..MEM_MAX_CONN-1); vrací 0 při špatném id
+int transport_mem_open(int conn);
+int transport_mem_is_closed(int conn);
+
+const char *transport_mem_output(int conn, size_t *len);
+void transport_mem_clear(int conn);
+int transport_mem_contains(int conn, const char *needle);
+
+uint64_t transport_mem_bytes(void);
+uint64_t transport_mem_messages(void);
@@ -0,0 +1,638 @@
+#define _POSIX_C_SOURCE 200112L
+#include "wal.h"
+#include "bot.h"
+#include "common.h"
+#include "journal.h"
+#include "log.h"
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Epochy: snapshot epochy E = stav na začátku logu epochy E. Log epochy E
+// leží v souboru wal[E & 1], snapshot ve slotu E & 1. Nový snapshot se
+// píše do slotu, který zrovna neplatí; hlavička (current) se přepne až po
+// msync dat a fdatasync celého předchozího logu.
+
+typedef struct WalSnapSlot {
+  uint64_t epoch;
+  Room rooms[MAX_ROOMS];
+  Game games[MAX_ROOMS];
+} WalSnapSlot;
+
+typedef struct WalSnapFile {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t room_size; // sizeof(Room)/sizeof(Game): snapshot je binární kopie
+  uint32_t game_size;
+  uint32_t max_rooms;
+  int32_t room_base;
+  uint64_t current; // epocha platného slotu
+  WalSnapSlot slot[2];
+} WalSnapFile;
+
+typedef struct WalHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t epoch;
+  uint64_t prev_len; // platná délka logu předchozí epochy (díra = konec)
+} WalHeader;
+
+// Blok = jeden write(): délka payloadu, FNV-1a payloadu, záznamy
+#define WAL_BLOCK_HDR 8
+
+long wal_snapshot_bytes = WAL_SNAPSHOT_BYTES;
+WalRecovery wal_recovery;
+int wal_crash_at = WAL_CRASH_NONE;
+
+static WalSnapFile *w_snap = NULL;
+static int w_fd[2] = {-1, -1};
+static int w_broken = 0;
+static unsigned char w_buf[WAL_BUF_SIZE];
+static size_t w_len = WAL_BLOCK_HDR;
+static uint64_t w_file_len[2]; // délka souborů logu (jen smyčka)
+static uint64_t w_snap_ms;     // kdy vznikl poslední snapshot
+
+// Sdílené s vláknem: epocha a počty zapsaných bajtů zvyšuje jen smyčka,
+// pending (epocha snapshotu čekajícího na msync) nuluje jen vlákno
+static pthread_t w_thread;
+static int w_running = 0;
+static int w_stop = 0;
+static _Alignas(CACHE_LINE) uint64_t w_epoch;
+static _Alignas(CACHE_LINE) uint64_t w_written[2];
+static _Alignas(CACHE_LINE) uint64_t w_pending;
+
+static uint64_t mono_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static uint32_t fnv1a(const unsigned char *p, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+  p[0] = (unsigned char)v;
+  p[1] = (unsigned char)(v >> 8);
+  p[2] = (unsigned char)(v >> 16);
+  p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+int wal_enabled(void) { return w_snap != NULL && !w_broken; }
+
+// --- zápis ---
+
+static int write_all(int fd, const unsigned char *s, size_t len) {
+  while (len > 0) {
+    ssize_t w = write(fd, s, len);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      return 0;
+    }
+    s += w;
+    len -= (size_t)w;
+  }
+  return 1;
+}
+
+// Nasbírané záznamy jako jeden blok do logu aktuální epochy
+static void flush_block(void) {
+  if (w_len == WAL_BLOCK_HDR || w_broken)
+    return;
+  size_t payload = w_len - WAL_BLOCK_HDR;
+  put_u32(w_buf, (uint32_t)payload);
+  put_u32(w_buf + 4, fnv1a(w_buf + WAL_BLOCK_HDR, payload));
+
+  int i = (int)(w_epoch & 1);
+  if (!write_all(w_fd[i], w_buf, w_len)) {
+    log_error("wal: write failed (errno=%d), room journal disabled", errno);
+    w_broken = 1;
+    return;
+  }
+  w_file_len[i] += w_len;
+  __atomic_store_n(&w_written[i], w_written[i] + w_len, __ATOMIC_RELEASE);
+  w_len = WAL_BLOCK_HDR;
+}
+
+// Místo pro záznam; NULL = WAL vypnutý
+static unsigned char *reserve(size_t need) {
+  if (!w_snap || w_broken)
+    return NULL;
+  if (w_len + need > sizeof(w_buf))
+    flush_block();
+  return w_broken ? NULL : w_buf + w_len;
+}
+
+static void commit(unsigned char *end) { w_len = (size_t)(end - w_buf); }
+
+static unsigned char *put_name(unsigned char *p, const char *s) {
+  size_t n = 0;
+  while (n < sizeof(((Room *)0)->player_names[0]) - 1 && s[n])
+    n++;
+  *p++ = (unsigned char)n;
+  memcpy(p, s, n);
+  return p + n;
+}
+
+void wal_room(const Room *r) {
+  unsigned char *p = reserve(1 + 6 * 10 + 2 * 32);
+  if (!p)
+    return;
+  *p++ = WR_ROOM;
+  p += varint_put(p, (uint64_t)r->id);
+  p += varint_put(p, (uint64_t)r->state);
+  p += varint_put(p, (uint64_t)r->phase);
+  p += varint_put(p, (uint64_t)r->variant);
+  p += varint_put(p, (uint64_t)r->bot_level);
+  p += varint_put(p, (uint64_t)r->salvo);
+  p = put_name(p, r->player_names[0]);
+  p = put_name(p, r->player_names[1]);
+  commit(p);
+}
+
+void wal_game(const Room *r) {
+  unsigned char *p = reserve(1 + 3 * 10);
+  if (!p)
+    return;
+  *p++ = WR_GAME;
+  p += varint_put(p, (uint64_t)r->id);
+  p += varint_put(p, (uint64_t)r->variant);
+  p += varint_put(p, (uint64_t)r->salvo);
+  commit(p);
+}
+
+void wal_fleet(int room_id, int slot, const PendingShip ships[], int count) {
+  if (count < 0 || count > GAME_FLEET_MAX)
+    return;
+  unsigned char *p = reserve(1 + 3 * 10 + (size_t)count * 4 * 10);
+  if (!p)
+    return;
+  *p++ = WR_FLEET;
+  p += varint_put(p, (uint64_t)room_id);
+  p += varint_put(p, (uint64_t)slot);
+  p += varint_put(p, (uint64_t)count);
+  for (int i = 0; i < count; i++) {
+    p += varint_put(p, (uint64_t)ships[i].x);
+    p += varint_put(p, (uint64_t)ships[i].y);
+    p += varint_put(p, (uint64_t)ships[i].len);
+    *p++ = (ships[i].dir == 'V' || ships[i].dir == 'v') ? 1 : 0;
+  }
+  commit(p);
+}
+
+void wal_clear(int room_id, int slot) {
+  unsigned char *p = reserve(1 + 2 * 10);
+  if (!p)
+    return;
+  *p++ = WR_CLEAR;
+  p += varint_put(p, (uint64_t)room_id);
+  p += varint_put(p, (uint64_t)slot);
+  commit(p);
+}
+
+void wal_shot(int room_id, int slot, int x, int y) {
+  unsigned char *p = reserve(1 + 2 * 10);
+  if (!p)
+    return;
+  *p++ = WR_SHOT;
+  p += varint_put(p, (uint64_t)room_id);
+  p += varint_put(p, ((uint64_t)y << 6) | ((uint64_t)x << 1) | (uint64_t)slot);
+  commit(p);
+}
+
+void wal_room_closed(int room_id) {
+  unsigned char *p = reserve(1 + 10);
+  if (!p)
+    return;
+  *p++ = WR_CLOSE;
+  p += varint_put(p, (uint64_t)room_id);
+  commit(p);
+}
+
+// --- vlákno fdatasync / snapshot ---
+
+static void *wal_main(void *arg) {
+  (void)arg;
+  uint64_t synced[2] = {w_written[0], w_written[1]};
+  struct timespec ts = {0, WAL_SYNC_MS * 1000000L};
+  for (;;) {
+    int stop = __atomic_load_n(&w_stop, __ATOMIC_ACQUIRE);
+    uint64_t pend = __atomic_load_n(&w_pending, __ATOMIC_ACQUIRE);
+    uint64_t e = __atomic_load_n(&w_epoch, __ATOMIC_ACQUIRE);
+
+    // Starší log první: novější epocha bez konce té předchozí nemá cenu
+    for (int k = 1; k >= 0; k--) {
+      int i = (int)((e + (uint64_t)k) & 1);
+      uint64_t wr = __atomic_load_n(&w_written[i], __ATOMIC_ACQUIRE);
+      if (wr != synced[i]) {
+        fdatasync(w_fd[i]);
+        synced[i] = wr;
+      }
+    }
+
+    // Předchozí log je celý na disku -> snapshot může začít platit
+    if (pend && wal_crash_at != WAL_CRASH_HOLD_SWITCH) {
+      msync(w_snap, sizeof(*w_snap), MS_SYNC);
+      w_snap->current = pend;
+      msync(w_snap, sizeof(*w_snap), MS_SYNC);
+      __atomic_store_n(&w_pending, 0, __ATOMIC_RELEASE);
+    }
+
+    if (stop)
+      break;
+    nanosleep(&ts, NULL);
+  }
+  return NULL;
+}
+
+// Snapshot epochy n do slotu, který zrovna neplatí (current se nemění)
+static void fill_slot(uint64_t n, const Room rooms[], const Game games[]) {
+  WalSnapSlot *s = &w_snap->slot[n & 1];
+  s->epoch = n;
+  memcpy(s->rooms, rooms, sizeof(s->rooms));
+  memcpy(s->games, games, sizeof(s->games));
+}
+
+// Prázdný log epochy n s hlavičkou. Soubor smí držet jen log, který už
+// platný snapshot nepotřebuje.
+static int start_log(uint64_t n, uint64_t prev_len) {
+  int i = (int)(n & 1);
+  WalHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, WAL_MAGIC, 4);
+  h.version = WAL_VERSION;
+  h.epoch = n;
+  h.prev_len = prev_len;
+  if (ftruncate(w_fd[i], 0) != 0 ||
+      !write_all(w_fd[i], (const unsigned char *)&h, sizeof(h))) {
+    log_error("wal: cannot start epoch %llu (errno=%d), room journal disabled",
+              (unsigned long long)n, errno);
+    w_broken = 1;
+    return 0;
+  }
+  w_file_len[i] = sizeof(h);
+  __atomic_store_n(&w_written[i], w_written[i] + sizeof(h), __ATOMIC_RELEASE);
+  __atomic_store_n(&w_epoch, n, __ATOMIC_RELEASE);
+  w_snap_ms = mono_ms();
+  return 1;
+}
+
+void wal_flush(const Room rooms[], const Game games[]) {
+  if (!w_snap || w_broken)
+    return;
+  flush_block();
+
+  // Další snapshot, až je log dost dlouhý (nebo starý) a předchozí dosedl
+  int i = (int)(w_epoch & 1);
+  uint64_t logged = w_file_len[i] - sizeof(WalHeader);
+  if (logged == 0 || __atomic_load_n(&w_pending, __ATOMIC_ACQUIRE))
+    return;
+  if ((long)logged < wal_snapshot_bytes &&
+      mono_ms() - w_snap_ms < WAL_SNAPSHOT_SEC * 1000u)
+    return;
+
+  // Soubor epochy n drží log n - 2, ten platný snapshot n - 1 nepotřebuje;
+  // snapshot začne platit, až vlákno dosynchronizuje starý log (pending)
+  TRACE_SCOPE("wal_snapshot", (int)logged);
+  uint64_t n = w_epoch + 1;
+  fill_slot(n, rooms, games);
+  if (start_log(n, w_file_len[i]))
+    __atomic_store_n(&w_pending, n, __ATOMIC_RELEASE);
+}
+
+// --- obnova ---
+
+static Room *room_at(Room rooms[], uint64_t id) {
+  long idx = (long)id - lobby_room_base - 1;
+  return (idx >= 0 && idx < MAX_ROOMS) ? &rooms[idx] : NULL;
+}
+
+static int get_name(const unsigned char **p, const unsigned char *end,
+                    char *out, size_t outsz) {
+  if (*p >= end)
+    return 0;
+  size_t n = **p;
+  (*p)++;
+  if (n >= outsz || (size_t)(end - *p) < n)
+    return 0;
+  memcpy(out, *p, n);
+  out[n] = '\0';
+  *p += n;
+  return 1;
+}
+
+// Jeden záznam; -1 = poškozený payload, 0 = hra ho odmítla, 1 = OK
+static int apply(const unsigned char **pp, const unsigned char *end,
+                 Room rooms[], Game games[]) {
+  const unsigned char *p = *pp;
+  int tag = *p++;
+  uint64_t id, v[5];
+  char err[64];
+  if (!varint_get(&p, end, &id))
+    return -1;
+  Room *r = room_at(rooms, id);
+  Game *g = r ? &games[r - rooms] : NULL;
+  int ok = (r != NULL);
+
+  switch (tag) {
+  case WR_ROOM: {
+    char names[2][sizeof(r->player_names[0])] = {{0}};
+    for (int k = 0; k < 5; k++)
+      if (!varint_get(&p, end, &v[k]))
+        return -1;
+    if (!get_name(&p, end, names[0], sizeof(names[0])) ||
+        !get_name(&p, end, names[1], sizeof(names[1])))
+      return -1;
+    if (r) {
+      r->id = (int)id;
+      r->state = (RoomState)v[0];
+      r->phase = (RoomPhase)v[1];
+      r->variant = (int)v[2];
+      r->bot_level = (int)v[3];
+      r->salvo = (int)v[4];
+      memcpy(r->player_names, names, sizeof(names));
+      lobby_room_changed(r);
+    }
+    break;
+  }
+  case WR_GAME:
+    if (!varint_get(&p, end, &v[0]) || !varint_get(&p, end, &v[1]))
+      return -1;
+    if (r) {
+      game_room_init(g, (int)id, (int)v[0]);
+      g->salvo = (int)v[1]; // výstřely salvy se přehrají po jednom
+      r->game_active = 1;
+    }
+    break;
+  case WR_FLEET: {
+    PendingShip ships[GAME_FLEET_MAX];
+    if (!varint_get(&p, end, &v[0]) || !varint_get(&p, end, &v[1]) ||
+        v[1] > GAME_FLEET_MAX)
+      return -1;
+    for (uint64_t k = 0; k < v[1]; k++) {
+      if (!varint_get(&p, end, &v[2]) || !varint_get(&p, end, &v[3]) ||
+          !varint_get(&p, end, &v[4]) || p >= end)
+        return -1;
+      ships[k].x = (int)v[2];
+      ships[k].y = (int)v[3];
+      ships[k].len = (int)v[4];
+      ships[k].dir = *p++ ? 'V' : 'H';
+    }
+    ok = r && game_place_fleet(g, (int)v[0], ships, (int)v[1], err,
+                               sizeof(err)) &&
+         game_set_ready(g, (int)v[0], err, sizeof(err));
+    break;
+  }
+  case WR_CLEAR:
+    if (!varint_get(&p, end, &v[0]))
+      return -1;
+    if (r)
+      game_clear_player_setup(g, (int)v[0]);
+    break;
+  case WR_SHOT:
+    if (!varint_get(&p, end, &v[0]))
+      return -1;
+    ok = r && game_shoot(g, (int)(v[0] & 1), (int)((v[0] >> 1) & 31),
+                         (int)(v[0] >> 6), err, sizeof(err)) >= 0;
+    break;
+  case WR_CLOSE:
+    if (r) {
+      game_reset(g);
+      room_reset(r);
+    }
+    break;
+  default:
+    return -1;
+  }
+  *pp = p;
+  return ok;
+}
+
+// Přehraje log epochy `epoch`; vrací jeho platnou délku (0 = není to on)
+static uint64_t replay_file(int fd, uint64_t epoch, uint64_t prev_len,
+                            int check_prev, Room rooms[], Game games[]) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(WalHeader))
+    return 0;
+  size_t size = (size_t)st.st_size;
+  const unsigned char *m = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (m == MAP_FAILED)
+    return 0;
+
+  WalHeader h;
+  memcpy(&h, m, sizeof(h));
+  if (memcmp(h.magic, WAL_MAGIC, 4) != 0 || h.version != WAL_VERSION ||
+      h.epoch != epoch || (check_prev && h.prev_len != prev_len)) {
+    munmap((void *)m, size);
+    return 0;
+  }
+
+  // Useknutý nebo rozbitý blok = konec logu (zápis nestihl dosednout)
+  size_t off = sizeof(h);
+  while (size - off >= WAL_BLOCK_HDR) {
+    uint32_t len = get_u32(m + off);
+    const unsigned char *p = m + off + WAL_BLOCK_HDR;
+    if (len > size - off - WAL_BLOCK_HDR || fnv1a(p, len) != get_u32(m + off + 4))
+      break;
+    const unsigned char *end = p + len;
+    int rc = 1;
+    while (p < end && (rc = apply(&p, end, rooms, games)) >= 0) {
+      wal_recovery.records++;
+      if (rc == 0)
+        wal_recovery.rejected++;
+    }
+    if (rc < 0) {
+      // Součet sedí, ale záznam nejde přečíst: jiný formát, dál nejdeme
+      log_warn("wal: undecodable record in epoch %llu at offset %zu",
+               (unsigned long long)epoch, off);
+      break;
+    }
+    off += WAL_BLOCK_HDR + len;
+    wal_recovery.bytes += WAL_BLOCK_HDR + (long)len;
+  }
+  munmap((void *)m, size);
+  return off;
+}
+
+// Po restartu nikdo není připojený: lidské sloty jsou DOWN a čekají na
+// REJOIN (grace běží od startu), bot ve svém slotu zůstává UP
+static void mark_all_down(Room rooms[], Game games[]) {
+  time_t now = net_now();
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    Room *r = &rooms[i];
+    games[i].journal_id = 0;
+    if (r->state == ROOM_EMPTY)
+      continue;
+    wal_recovery.rooms++;
+    r->phase_since = now; // úklid nečinných roomek počítá od startu
+    r->rematch[0] = r->rematch[1] = 0;
+    for (int s = 0; s < 2; s++) {
+      r->player_fds[s] = -1;
+      if (r->bot_level && s == BOT_SLOT) {
+        r->slot_connected[s] = 1;
+        r->slot_down_since[s] = 0;
+        continue;
+      }
+      r->slot_connected[s] = 0;
+      r->slot_down_since[s] = r->player_names[s][0] ? now : 0;
+    }
+  }
+}
+
+static int open_snapshot(const char *path, Room rooms[], Game games[]) {
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    log_error("wal: cannot open '%s' (errno=%d)", path, errno);
+    return 0;
+  }
+  struct stat st;
+  int fresh = (fstat(fd, &st) == 0 && st.st_size == 0);
+  if (fresh && ftruncate(fd, sizeof(WalSnapFile)) != 0) {
+    log_error("wal: cannot size '%s' (errno=%d)", path, errno);
+    close(fd);
+    return 0;
+  }
+  if (!fresh && st.st_size != (off_t)sizeof(WalSnapFile)) {
+    log_error("wal: '%s' has unexpected size, refusing", path);
+    close(fd);
+    return 0;
+  }
+  void *m = mmap(NULL, sizeof(WalSnapFile), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) {
+    log_error("wal: mmap '%s' failed (errno=%d)", path, errno);
+    return 0;
+  }
+
+  WalSnapFile *f = m;
+  if (fresh) {
+    // Epocha 1 = prázdný server; logy zatím nepatří žádné epoše
+    f->magic = WAL_SNAP_MAGIC;
+    f->version = WAL_VERSION;
+    f->room_size = sizeof(Room);
+    f->game_size = sizeof(Game);
+    f->max_rooms = MAX_ROOMS;
+    f->room_base = lobby_room_base;
+    f->slot[1].epoch = 1;
+    memcpy(f->slot[1].rooms, rooms, sizeof(f->slot[1].rooms));
+    memcpy(f->slot[1].games, games, sizeof(f->slot[1].games));
+    f->current = 1;
+    msync(f, sizeof(*f), MS_SYNC);
+  } else if (f->magic != WAL_SNAP_MAGIC || f->version != WAL_VERSION ||
+             f->room_size != sizeof(Room) || f->game_size != sizeof(Game) ||
+             f->max_rooms != MAX_ROOMS || f->room_base != lobby_room_base ||
+             f->slot[f->current & 1].epoch != f->current) {
+    log_error("wal: '%s' is not a compatible snapshot", path);
+    munmap(m, sizeof(WalSnapFile));
+    return 0;
+  }
+  w_snap = f;
+  return 1;
+}
+
+int wal_open(const char *prefix, Room rooms[], Game games[]) {
+  char path[512];
+  uint64_t t0 = mono_ms();
+  memset(&wal_recovery, 0, sizeof(wal_recovery));
+
+  snprintf(path, sizeof(path), "%s.snap", prefix);
+  if (!open_snapshot(path, rooms, games))
+    return 0;
+  for (int i = 0; i < 2; i++) {
+    snprintf(path, sizeof(path), "%s.wal%d", prefix, i);
+    w_fd[i] = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (w_fd[i] < 0) {
+      log_error("wal: cannot open '%s' (errno=%d)", path, errno);
+      wal_close();
+      return 0;
+    }
+  }
+
+  // Snapshot + log jeho epochy + případně log další epochy, pokud se
+  // přepnutí snapshotu před pádem nestihlo (navazuje bez díry)
+  uint64_t s = w_snap->current;
+  const WalSnapSlot *slot = &w_snap->slot[s & 1];
+  memcpy(rooms, slot->rooms, sizeof(slot->rooms));
+  memcpy(games, slot->games, sizeof(slot->games));
+  wal_recovery.epoch = s;
+
+  uint64_t len = replay_file(w_fd[s & 1], s, 0, 0, rooms, games);
+  if (len)
+    replay_file(w_fd[(s + 1) & 1], s + 1, len, 1, rooms, games);
+  mark_all_down(rooms, games);
+
+  // Obnovený stav hned jako nový snapshot (synchronně, vlákno ještě neběží).
+  // Epocha n má jinou paritu než s (slot platného snapshotu) a je vyšší než
+  // každý log na disku (nejvýš s + 1). Soubor logu n může držet právě
+  // přehraný log s + 1, proto se vyprázdní až po přepnutí snapshotu; pád
+  // mezi tím nevadí, log s cizí epochou replay_file ignoruje.
+  uint64_t n = s + 3;
+  w_broken = 0;
+  w_len = WAL_BLOCK_HDR;
+  w_written[0] = w_written[1] = 0;
+  fill_slot(n, rooms, games);
+  msync(w_snap, sizeof(*w_snap), MS_SYNC);
+  w_snap->current = n;
+  msync(w_snap, sizeof(*w_snap), MS_SYNC);
+  if (wal_crash_at == WAL_CRASH_RECOVERY)
+    _exit(0);
+  if (!start_log(n, 0)) {
+    wal_close();
+    return 0;
+  }
+  fdatasync(w_fd[n & 1]);
+
+  w_stop = 0;
+  w_pending = 0;
+  if (pthread_create(&w_thread, NULL, wal_main, NULL) != 0) {
+    log_error("wal: cannot start thread");
+    wal_close();
+    return 0;
+  }
+  w_running = 1;
+
+  wal_recovery.seconds = (double)(mono_ms() - t0) / 1000.0;
+  log_info("wal: '%s' recovered %d room(s) from epoch %llu + %ld record(s) "
+           "(%ld B) in %.3f s%s",
+           prefix, wal_recovery.rooms, (unsigned long long)s,
+           wal_recovery.records, wal_recovery.bytes, wal_recovery.seconds,
+           wal_recovery.rejected ? " [some records rejected]" : "");
+  return 1;
+}
+
+void wal_close(void) {
+  if (!w_snap)
+    return;
+  if (w_fd[0] >= 0 && w_fd[1] >= 0) {
+    flush_block();
+    if (w_running) {
+      __atomic_store_n(&w_stop, 1, __ATOMIC_RELEASE);
+      pthread_join(w_thread, NULL);
+      w_running = 0;
+    }
+  }
+  for (int i = 0; i < 2; i++) {
+    if (w_fd[i] >= 0)
+      close(w_fd[i]);
+    w_fd[i] = -1;
+  }
+  munmap(w_snap, sizeof(*w_snap));
+  w_snap = NULL;
+}
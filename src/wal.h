@@ -0,0 +1,74 @@
+#pragma once
+
+#include "game.h"
+#include "lobby.h"
+#include <stdint.h>
+
+// Write-ahead log stavu roomek a her, aby pád serveru nezahodil rozehrané
+// hry. Každá změna (založení, join, flotila, výstřel, fáze, zrušení) je
+// logický záznam; smyčka ho zapíše (write) na konci iterace, vlákno na
+// pozadí dělá fdatasync po dávkách (WAL_SYNC_MS). Občas se celé rooms[] a
+// games[] (POD) zkopírují do mmapovaného snapshotu a log začne znovu.
+//
+// Soubory: PREFIX.snap (dva sloty snapshotu, hlavička ukazuje na platný),
+// PREFIX.wal0 a PREFIX.wal1 (střídají se podle epochy). Po startu se
+// obnoví snapshot + ocas logu a všechny lidské sloty jsou DOWN (REJOIN).
+
+#define WAL_MAGIC "BSW1"
+#define WAL_SNAP_MAGIC 0x50534253u // "BSSP"
+#define WAL_VERSION 2
+#define WAL_BUF_SIZE (64 * 1024)
+#define WAL_SYNC_MS 50         // skupinový fdatasync
+#define WAL_SNAPSHOT_SEC 30    // nejpozději po takové době nový snapshot
+#define WAL_SNAPSHOT_BYTES (4 << 20)
+
+// Záznam: varint délka, payload (tag + varinty, jména jako délka + bajty),
+// 4 B kontrolní součet payloadu (FNV-1a) -- useknutý ocas se pozná
+typedef enum {
+  WR_ROOM = 1,  // id, state, phase, variant, bot_level, salvo, jména P1, P2
+  WR_GAME = 2,  // id, variant, salvo (game_room_init)
+  WR_FLEET = 3, // id, slot, počet, počet x (x, y, len, dir) -> flotila + ready
+  WR_CLEAR = 4, // id, slot (PLACING_START)
+  WR_SHOT = 5,  // id, (y << 6 | x << 1 | slot)
+  WR_CLOSE = 6  // id
+} WalTag;
+
+extern long wal_snapshot_bytes; // práh velikosti logu pro nový snapshot
+
+// Obnoví rooms[]/games[] (musí být čerstvě resetované) a spustí zápis.
+// 0 = soubory nejdou otevřít nebo patří jiné konfiguraci.
+int wal_open(const char *prefix, Room rooms[], Game games[]);
+void wal_close(void); // dopíše buffer, fdatasync, ukončí vlákno
+int wal_enabled(void);
+
+void wal_room(const Room *r);
+void wal_game(const Room *r);
+void wal_fleet(int room_id, int slot, const PendingShip ships[], int count);
+void wal_clear(int room_id, int slot);
+void wal_shot(int room_id, int slot, int x, int y);
+void wal_room_closed(int room_id);
+
+// Z hlavní smyčky: zápis bufferu, případně nový snapshot
+void wal_flush(const Room rooms[], const Game games[]);
+
+// Statistika poslední obnovy (pro log a protosim)
+typedef struct WalRecovery {
+  uint64_t epoch;   // epocha snapshotu, ze kterého se vycházelo
+  long records;     // přehraných záznamů
+  long bytes;       // přehraných bajtů logu
+  long rejected;    // záznamů, které hra odmítla
+  int rooms;        // obsazených roomek po obnově
+  double seconds;
+} WalRecovery;
+
+extern WalRecovery wal_recovery;
+
+// Jen pro protosim --wal-bench: simulovaný pád v kritických místech
+typedef enum {
+  WAL_CRASH_NONE = 0,
+  WAL_CRASH_HOLD_SWITCH, // vlákno nepřepne snapshot (pád, než to stihlo)
+  WAL_CRASH_RECOVERY     // _exit ve wal_open po přepnutí snapshotu, před
+                         // vyprázdněním logu
+} WalCrash;
+
+extern int wal_crash_at;
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Skládání odpovědí bez snprintf: literály mají délku známou při překladu,
+// čísla jdou přes rychlé itoa. Buffer dodává volající (typicky na zásobníku),
+// nic se nealokuje. Co se nevejde, se ořízne (full = 1).
+typedef struct Wire {
+  char *p;
+  size_t len;
+  size_t cap;
+  int full;
+} Wire;
+
+#define WIRE_INIT(buf) {(buf), 0, sizeof(buf), 0}
+
+static inline void wire_put(Wire *w, const char *s, size_t n) {
+  if (w->len + n > w->cap) {
+    n = w->cap - w->len;
+    w->full = 1;
+  }
+  memcpy(w->p + w->len, s, n);
+  w->len += n;
+}
+
+// Jen pro řetězcové literály ("" s zajistí, že se jinam nepoužije)
+#define wire_lit(w, s) wire_put((w), "" s, sizeof(s) - 1)
+
+static inline void wire_str(Wire *w, const char *s) {
+  wire_put(w, s, strlen(s));
+}
+
+static inline void wire_char(Wire *w, char c) {
+  if (w->len < w->cap)
+    w->p[w->len++] = c;
+  else
+    w->full = 1;
+}
+
+static inline void wire_uint(Wire *w, unsigned v) {
+  char tmp[10];
+  int n = 0;
+  do {
+    tmp[sizeof(tmp) - 1 - n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  wire_put(w, tmp + sizeof(tmp) - n, (size_t)n);
+}
+
+static inline void wire_int(Wire *w, int v) {
+  if (v < 0) {
+    wire_char(w, '-');
+    wire_uint(w, 0u - (unsigned)v);
+  } else {
+    wire_uint(w, (unsigned)v);
+  }
+}
+
+// Pevně 16 hex číslic (tokeny)
+static inline void wire_hex64(Wire *w, uint64_t v) {
+  char tmp[16];
+  for (int i = 15; i >= 0; i--, v >>= 4)
+    tmp[i] = "0123456789abcdef"[v & 15];
+  wire_put(w, tmp, sizeof(tmp));
+}
+
+// Řetězec s '\0' (pro API, která chtějí C string, např. spec_publish)
+static inline const char *wire_cstr(Wire *w) {
+  if (w->len == w->cap) {
+    w->len--;
+    w->full = 1;
+  }
+  w->p[w->len] = '\0';
+  return w->p;
+}
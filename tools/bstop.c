@@ -0,0 +1,164 @@
+#define _POSIX_C_SOURCE 200112L
+#include "live.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// "top" pro server: čte snímek, který server s --live=NAME publikuje do
+// sdílené paměti. Segment se mapuje jen pro čtení, server o čtenáři neví.
+
+#define BSTOP_STALE_SEC 5 // snímek starší než tohle = server stojí / neběží
+
+static const char *phase_name[] = {"LOBBY", "SETUP", "PLAY", "FINISHED"};
+static const char *variant_name[] = {"CLASSIC", "QUICK", "LARGE"};
+static const char *load_name[] = {"OK", "BUSY", "CRITICAL"};
+
+#define NAME_OF(tab, i)                                                        \
+  (((i) >= 0 && (size_t)(i) < sizeof(tab) / sizeof(tab[0])) ? tab[i] : "?")
+
+// Konzistentní kopie pod seqlockem; 0 = server pořád zapisuje
+static int snapshot(const LiveFile *lf, LiveFile *out) {
+  for (int tries = 0; tries < 1000; tries++) {
+    uint32_t s1 = __atomic_load_n(&lf->seq, __ATOMIC_ACQUIRE);
+    if (s1 & 1u) {
+      sched_yield();
+      continue;
+    }
+    memcpy(out, lf, sizeof(*out));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&lf->seq, __ATOMIC_RELAXED) == s1)
+      return 1;
+  }
+  return 0;
+}
+
+static void show(const LiveFile *s, const LiveFile *prev, double dt) {
+  time_t now = time(NULL);
+  int stale = now - s->updated_at > BSTOP_STALE_SEC;
+
+  printf("bstop  pid %d  up %llds  load %s (lag %d ms)%s\n", s->pid,
+         (long long)(s->updated_at - s->started_at),
+         NAME_OF(load_name, s->load_level), s->lag_ms,
+         stale ? "  [STALE]" : "");
+
+  const LiveCounters *c = &s->counters;
+  printf("conn +%llu -%llu rejected  commands %llu", (unsigned long long)c->accepted,
+         (unsigned long long)c->rejected, (unsigned long long)c->commands);
+  if (prev && dt > 0)
+    printf(" (%.0f/s)", (double)(c->commands - prev->counters.commands) / dt);
+  printf("  games %llu  loop %llu\n\n", (unsigned long long)c->games_finished,
+         (unsigned long long)c->iterations);
+
+  printf("%-5s %-8s %-8s %-3s %-18s %-18s %-4s %-11s %-11s %-4s\n", "ROOM",
+         "PHASE", "VARIANT", "BOT", "P1", "P2", "TURN", "SHOTS/HITS",
+         "ALIVE", "SPEC");
+  for (uint32_t i = 0; i < s->max_rooms && i < MAX_ROOMS; i++) {
+    const LiveRoom *r = &s->rooms[i];
+    if (r->id < 0)
+      continue;
+    char p[2][LIVE_NAME + 16];
+    for (int k = 0; k < 2; k++) {
+      if (!r->names[k][0])
+        snprintf(p[k], sizeof(p[k]), "-");
+      else if (r->slot_up[k])
+        snprintf(p[k], sizeof(p[k]), "%.12s UP", r->names[k]);
+      else
+        snprintf(p[k], sizeof(p[k]), "%.12s DN%ds", r->names[k],
+                 r->down_sec[k]);
+    }
+    char turn[16] = "-", sh[24], al[24];
+    if (r->turn >= 0)
+      snprintf(turn, sizeof(turn), "P%d", r->turn + 1);
+    snprintf(sh, sizeof(sh), "%d/%d %d/%d", r->shots[0], r->hits[0],
+             r->shots[1], r->hits[1]);
+    snprintf(al, sizeof(al), "%d %d", r->ships_alive[0], r->ships_alive[1]);
+    printf("%-5d %-8s %-8s %-3s %-18s %-18s %-4s %-11s %-11s %-4d\n", r->id,
+           NAME_OF(phase_name, r->phase), NAME_OF(variant_name, r->variant),
+           r->bot_level ? "yes" : "-", p[0], p[1], turn, sh, al, r->spectators);
+  }
+
+  printf("\n%-5s %-16s %-5s %-4s %-5s %-6s %-7s %-7s %-5s\n", "FD", "NICK",
+         "ROOM", "SLOT", "WATCH", "HB_AGE", "HB_MISS", "STRIKES", "OUTQ");
+  for (uint32_t i = 0; i < s->max_players && i < MAX_PLAYERS; i++) {
+    const LivePlayer *p = &s->players[i];
+    if (p->fd < 0 && !p->identified)
+      continue;
+    char fd[16];
+    if (p->fd >= 0)
+      snprintf(fd, sizeof(fd), "%d", p->fd);
+    else
+      snprintf(fd, sizeof(fd), "DN%d", p->down_sec); // ghost čeká na REJOIN
+    printf("%-5s %-16.16s %-5d %-4d %-5d %-6d %-7d %-7d %-5d\n", fd,
+           p->identified ? p->name : "(hello?)", p->room, p->slot, p->watching,
+           p->hb_age, p->hb_missed, p->strikes, p->outq);
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *name = NULL;
+  double interval = 1.0;
+  int once = 0, bad = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--interval=", 11) == 0)
+      interval = atof(argv[i] + 11);
+    else if (strcmp(argv[i], "--once") == 0)
+      once = 1;
+    else if (argv[i][0] != '-' && !name)
+      name = argv[i];
+    else
+      bad = 1;
+  }
+  if (bad || !name || interval <= 0) {
+    fprintf(stderr, "Usage: %s SHM_NAME [--interval=SEC] [--once]\n"
+                    "       (server started with --live=SHM_NAME)\n",
+            argv[0]);
+    return 1;
+  }
+
+  char path[64];
+  snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+  int fd = shm_open(path, O_RDONLY, 0);
+  if (fd < 0) {
+    fprintf(stderr, "bstop: shm '%s': %s\n", path, strerror(errno));
+    return 1;
+  }
+  const LiveFile *lf =
+      mmap(NULL, sizeof(LiveFile), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (lf == MAP_FAILED) {
+    fprintf(stderr, "bstop: mmap '%s': %s\n", path, strerror(errno));
+    return 1;
+  }
+  if (__atomic_load_n(&lf->magic, __ATOMIC_ACQUIRE) != LIVE_MAGIC ||
+      lf->version != LIVE_VERSION) {
+    fprintf(stderr, "bstop: '%s' is not a compatible live segment\n", path);
+    return 1;
+  }
+
+  static LiveFile cur, prev;
+  int have_prev = 0;
+  struct timespec ts = {(time_t)interval,
+                        (long)((interval - (double)(time_t)interval) * 1e9)};
+  for (;;) {
+    if (!snapshot(lf, &cur)) {
+      fprintf(stderr, "bstop: no consistent snapshot (writer stuck?)\n");
+      return 1;
+    }
+    if (!once)
+      printf("\033[H\033[2J"); // jako top: překreslit obrazovku
+    show(&cur, have_prev ? &prev : NULL, interval);
+    fflush(stdout);
+    if (once)
+      return 0;
+    prev = cur;
+    have_prev = 1;
+    nanosleep(&ts, NULL);
+  }
+}
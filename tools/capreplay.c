@@ -0,0 +1,377 @@
+#define _POSIX_C_SOURCE 200112L
+#include "capture.h"
+#include "journal.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Přehrání provozu zachyceného serverem (--capture=PATH) proti běžícímu
+// serveru: každé zachycené spojení = vlastní socket, řádky odchází buď
+// v zaznamenaném tempu (--speed=X násobí rychlost), nebo hned (--fast).
+// Latence = od odeslání příkazu do prvního bajtu, který potom na stejném
+// spojení přijde (PONG se nepočítá, na ten server neodpovídá). Na serveru
+// s výchozím rate limitem se --fast zadrhne o token bucket: --rate-limit=0.
+// --fast neposílá ve stejném pořadí, v jakém server odpovídal (příkazy
+// různých spojení se předbíhají), počet ERROR odpovědí ukazuje, jak moc se
+// přehrávání od záznamu rozešlo.
+
+#define CR_DRAIN_MS 500 // po posledním řádku ještě čekáme na odpovědi
+#define CR_MAX_CONN 4096
+
+typedef struct Rec {
+  uint64_t t_us; // od začátku záznamu
+  int conn;
+  int kind;
+  uint32_t off, len; // CAP_LINE: řádek v načteném souboru
+} Rec;
+
+typedef struct Conn {
+  int fd;         // -1 = nepřipojeno / zavřeno serverem
+  uint64_t sent;  // čas nejstaršího příkazu bez odpovědi, 0 = nic nečeká
+} Conn;
+
+static const char *target_host, *target_unix;
+static int target_port;
+
+static Conn conns[CR_MAX_CONN];
+static int nactive; // otevřených socketů (pro poll)
+
+static uint64_t *lat;
+static size_t nlat, lat_cap;
+static uint64_t rx_bytes, rx_errors, sent_lines, skipped_lines;
+static uint64_t connect_failed, kicked;
+static uint64_t last_rx; // čas posledního přijatého bajtu
+
+static uint64_t mono_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static unsigned char *load_file(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  struct stat st;
+  unsigned char *buf = NULL;
+  if (fstat(fileno(f), &st) == 0 && (buf = malloc((size_t)st.st_size + 1)) &&
+      fread(buf, 1, (size_t)st.st_size, f) != (size_t)st.st_size) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  *len = buf ? (size_t)st.st_size : 0;
+  return buf;
+}
+
+// Rozbalí záznamy; useknutý ocas (server spadl uprostřed zápisu) se zahodí,
+// stejně tak všechno od prvního nesmyslného záznamu (i řádek nad
+// CAPTURE_LINE_MAX, send_line ho skládá v bufferu na zásobníku)
+static Rec *parse(const unsigned char *buf, size_t len, size_t *count) {
+  size_t cap = 1024, n = 0;
+  Rec *recs = malloc(cap * sizeof(Rec));
+  const unsigned char *p = buf + 4, *end = buf + len;
+  uint64_t t = 0, dt, tag, l;
+
+  while (recs && p < end) {
+    if (!varint_get(&p, end, &dt) || !varint_get(&p, end, &tag))
+      break;
+    Rec r = {t + dt, (int)(tag >> 2), (int)(tag & 3), 0, 0};
+    if (r.kind == CAP_LINE) {
+      if (!varint_get(&p, end, &l) || l > (uint64_t)(end - p) ||
+          l > CAPTURE_LINE_MAX)
+        break;
+      r.off = (uint32_t)(p - buf);
+      r.len = (uint32_t)l;
+      p += l;
+    }
+    if (r.conn >= CR_MAX_CONN || r.kind > CAP_CLOSE)
+      break;
+    t = r.t_us;
+    if (n == cap) {
+      Rec *nr = realloc(recs, 2 * cap * sizeof(Rec));
+      if (!nr)
+        break;
+      recs = nr;
+      cap *= 2;
+    }
+    recs[n++] = r;
+  }
+  *count = n;
+  return recs;
+}
+
+static int dial(void) {
+  int fd;
+  if (target_unix) {
+    struct sockaddr_un a = {0};
+    a.sun_family = AF_UNIX;
+    snprintf(a.sun_path, sizeof(a.sun_path), "%s", target_unix);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0) {
+      close(fd);
+      return -1;
+    }
+  } else {
+    struct sockaddr_in a = {0};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(target_port);
+    inet_pton(AF_INET, target_host, &a.sin_addr);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0) {
+      close(fd);
+      return -1;
+    }
+    int one = 1;
+    if (fd >= 0)
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  if (fd >= 0)
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+static void conn_close(Conn *c) {
+  if (c->fd < 0)
+    return;
+  close(c->fd);
+  c->fd = -1;
+  c->sent = 0;
+  nactive--;
+}
+
+static void add_latency(uint64_t us) {
+  if (nlat == lat_cap) {
+    size_t cap = lat_cap ? 2 * lat_cap : 4096;
+    uint64_t *nl = realloc(lat, cap * sizeof(uint64_t));
+    if (!nl)
+      return;
+    lat = nl;
+    lat_cap = cap;
+  }
+  lat[nlat++] = us;
+}
+
+// Přečte všechno, co je na socketech, nejvýš timeout_ms čekání
+static void pump(int timeout_ms) {
+  static struct pollfd pfd[CR_MAX_CONN];
+  static int idx[CR_MAX_CONN];
+  int n = 0;
+  for (int i = 0; i < CR_MAX_CONN && n < nactive; i++) {
+    if (conns[i].fd < 0)
+      continue;
+    pfd[n].fd = conns[i].fd;
+    pfd[n].events = POLLIN;
+    idx[n++] = i;
+  }
+  if (poll(pfd, (nfds_t)n, timeout_ms) <= 0)
+    return;
+
+  uint64_t now = mono_us();
+  char buf[16384 + 1];
+  for (int k = 0; k < n; k++) {
+    if (!(pfd[k].revents & (POLLIN | POLLHUP | POLLERR)))
+      continue;
+    Conn *c = &conns[idx[k]];
+    for (;;) {
+      ssize_t r = recv(c->fd, buf, sizeof(buf) - 1, 0);
+      if (r > 0) {
+        rx_bytes += (uint64_t)r;
+        last_rx = now;
+        buf[r] = '\0'; // ERROR na hranici dvou recv() se nezapočítá
+        for (const char *e = buf; (e = strstr(e, "ERROR ")); e += 6)
+          rx_errors++;
+        if (c->sent) {
+          add_latency(now - c->sent);
+          c->sent = 0;
+        }
+        continue;
+      }
+      if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      if (r < 0 && errno == EINTR)
+        continue;
+      kicked++; // server spojení zavřel (strike, heartbeat, ...)
+      conn_close(c);
+      break;
+    }
+  }
+}
+
+static void send_line(Conn *c, const unsigned char *s, size_t len) {
+  char line[CAPTURE_LINE_MAX + 1];
+  memcpy(line, s, len);
+  line[len++] = '\n';
+
+  size_t done = 0;
+  while (done < len && c->fd >= 0) {
+    ssize_t w = send(c->fd, line + done, len - done, MSG_NOSIGNAL);
+    if (w > 0) {
+      done += (size_t)w;
+    } else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      pump(1); // server nestíhá číst: mezitím vybíráme odpovědi
+    } else if (w < 0 && errno == EINTR) {
+      continue;
+    } else {
+      kicked++;
+      conn_close(c);
+    }
+  }
+  if (c->fd < 0)
+    return;
+  sent_lines++;
+  if (!c->sent && !(len >= 5 && memcmp(line, "PONG", 4) == 0))
+    c->sent = mono_us();
+}
+
+static int cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static double pct_ms(double q) {
+  if (nlat == 0)
+    return 0.0;
+  size_t i = (size_t)((double)nlat * q);
+  if (i >= nlat)
+    i = nlat - 1;
+  return (double)lat[i] / 1000.0;
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  double speed = 1.0;
+  int fast = 0, bad = 0, npos = 0;
+  const char *pos[2] = {NULL, NULL};
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--fast") == 0)
+      fast = 1;
+    else if (strncmp(argv[i], "--speed=", 8) == 0)
+      speed = atof(argv[i] + 8);
+    else if (strncmp(argv[i], "--unix=", 7) == 0)
+      target_unix = argv[i] + 7;
+    else if (argv[i][0] != '-' && !path)
+      path = argv[i];
+    else if (argv[i][0] != '-' && npos < 2)
+      pos[npos++] = argv[i];
+    else
+      bad = 1;
+  }
+  if (!target_unix && npos == 2) {
+    target_host = pos[0];
+    target_port = atoi(pos[1]);
+  }
+  if (bad || !path || speed <= 0 || (!target_unix && target_port <= 0) ||
+      (target_unix && npos)) {
+    fprintf(stderr,
+            "Usage: %s CAPTURE_FILE <ip> <port> [--fast | --speed=X]\n"
+            "       %s CAPTURE_FILE --unix=PATH [--fast | --speed=X]\n"
+            "       (CAPTURE_FILE from server --capture=PATH)\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+
+  size_t len;
+  unsigned char *buf = load_file(path, &len);
+  if (!buf || len < 4 || memcmp(buf, CAPTURE_MAGIC, 4) != 0) {
+    fprintf(stderr, "capreplay: '%s' is not a capture file\n", path);
+    return 1;
+  }
+  size_t nrec;
+  Rec *recs = parse(buf, len, &nrec);
+  if (!recs) {
+    fprintf(stderr, "capreplay: out of memory\n");
+    return 1;
+  }
+  for (int i = 0; i < CR_MAX_CONN; i++)
+    conns[i].fd = -1;
+
+  uint64_t opens = 0, lines = 0;
+  uint64_t t0 = mono_us();
+  for (size_t i = 0; i < nrec; i++) {
+    const Rec *r = &recs[i];
+    Conn *c = &conns[r->conn];
+
+    // Zaznamenané tempo: mezitím vybíráme odpovědi
+    if (!fast) {
+      uint64_t due = t0 + (uint64_t)((double)r->t_us / speed), now;
+      while ((now = mono_us()) < due)
+        pump((int)((due - now + 999) / 1000));
+    } else if ((i & 63) == 0) {
+      pump(0);
+    }
+
+    switch (r->kind) {
+    case CAP_OPEN:
+      conn_close(c); // server zavřel spojení sám a číslo se recykluje
+      opens++;
+      if ((c->fd = dial()) < 0)
+        connect_failed++;
+      else
+        nactive++;
+      break;
+    case CAP_LINE:
+      lines++;
+      if (c->fd < 0)
+        skipped_lines++;
+      else
+        send_line(c, buf + r->off, r->len);
+      break;
+    case CAP_CLOSE:
+      conn_close(c);
+      break;
+    }
+  }
+  uint64_t t_send = mono_us(); // všechno odesláno
+
+  // Dobrat odpovědi: konec = CR_DRAIN_MS ticha na všech spojeních. Čas
+  // běhu končí posledním přijatým bajtem (u --fast server ještě dlouho
+  // zpracovává, co se mu nahrnulo do socketů).
+  for (;;) {
+    uint64_t quiet = mono_us() - (last_rx > t_send ? last_rx : t_send);
+    if (nactive == 0 || quiet >= CR_DRAIN_MS * 1000u)
+      break;
+    pump((int)((CR_DRAIN_MS * 1000u - quiet + 999) / 1000));
+  }
+  for (int i = 0; i < CR_MAX_CONN; i++)
+    conn_close(&conns[i]);
+
+  uint64_t t_end = last_rx > t_send ? last_rx : t_send;
+  double dt = (double)(t_end - t0) / 1e6;
+  double span = nrec ? (double)recs[nrec - 1].t_us / 1e6 : 0.0;
+  qsort(lat, nlat, sizeof(uint64_t), cmp_u64);
+
+  printf("capture:  %zu records, %llu connections, %llu lines, %.3f s "
+         "recorded\n",
+         nrec, (unsigned long long)opens, (unsigned long long)lines, span);
+  printf("replay:   %s, %.3f s (%.0f lines/s)\n",
+         fast ? "as fast as possible" : "recorded pace", dt,
+         dt > 0 ? (double)sent_lines / dt : 0.0);
+  printf("sent:     %llu lines, %llu skipped (connection gone), %llu connect "
+         "failures, %llu closed by server\n",
+         (unsigned long long)sent_lines, (unsigned long long)skipped_lines,
+         (unsigned long long)connect_failed, (unsigned long long)kicked);
+  printf("received: %llu bytes, %llu ERROR replies\n",
+         (unsigned long long)rx_bytes, (unsigned long long)rx_errors);
+  printf("latency:  %zu samples, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, "
+         "max %.3f ms\n",
+         nlat, pct_ms(0.50), pct_ms(0.90), pct_ms(0.99), pct_ms(1.0));
+
+  free(recs);
+  free(buf);
+  free(lat);
+  return connect_failed ? 2 : 0;
+}
@@ -0,0 +1,1493 @@
+#define _POSIX_C_SOURCE 200112L
+#include "bot.h"
+#include "game.h"
+#include "load.h"
+#include "lobby.h"
+#include "log.h"
+#include "net.h"
+#include "protocol.h"
+#include "rating.h"
+#include "spectate.h"
+#include "stats.h"
+#include "transport_mem.h"
+#include "wal.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Deterministický simulátor: protokol a hra běží nad transport_mem bez
+// jediného socketu. Výchozí režim měří propustnost protocol_handle_line(),
+// --timeout-test ověřuje heartbeat a reconnect grace s virtuálními hodinami,
+// --overload-test odkládání práce při přetížení, --resume-test RESUME tokeny,
+// --rematch-test REMATCH a úklid nečinných roomek, --salvo-test režim salvy,
+// --lobby-test odběr seznamu roomek (LIST SUBSCRIBE), --mux-test mnoho her
+// na jednom spojení (MUX), --watch-test zpožděný přenos spectatorům,
+// --scan-bench měří periodické skeny přes pole hráčů a roomek,
+// --rank-bench dotazy na žebříček nad velkou populací hráčů,
+// --wal-bench obnovu roomek ze snapshotu a logu po "pádu" i pádu v obnově.
+
+#define SIM_START_TIME 1000000 // virtuální čas na začátku (nesmí být 0)
+
+static Player players[MAX_PLAYERS];
+static Room rooms[MAX_ROOMS];
+static Game games[MAX_ROOMS];
+
+static long sim_cmds;
+static int sim_poll; // po kolika výstřelech si hráč vyžádá STATE (0 = nikdy)
+
+typedef enum { PLACE_BATCH, PLACE_FLEET, PLACE_AUTO } PlaceMode;
+static int sim_place = PLACE_BATCH; // jak si hráči rozmisťují flotilu
+static int sim_rematch; // další hra páru přes REMATCH místo LEAVE/CREATE/JOIN
+static int sim_salvo;   // roomky CREATE ... SALVO, tah = jeden SALVO příkaz
+static int sim_lobby;   // klientů v lobby, kteří sledují seznam roomek
+static int sim_lobby_poll; // ... dotazováním LIST místo LIST SUBSCRIBE
+
+static void sim_init(void) {
+  net_set_transport(&transport_mem);
+  net_set_buffered(1);
+  transport_mem_reset(SIM_START_TIME);
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    memset(&players[i], 0, sizeof(players[i]));
+    players[i].socket_fd = -1;
+    player_reset(&players[i]);
+  }
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    room_reset(&rooms[i]);
+    game_reset(&games[i]);
+  }
+}
+
+// Obdoba accept() v main.c: spojení id == index hráče
+static Player *sim_connect(int i) {
+  Player *p = &players[i];
+  transport_mem_open(i);
+  p->socket_fd = i;
+  p->current_room_id = -1;
+  p->player_slot = -1;
+  p->watching_room_id = -1;
+  p->connected = 1;
+  return p;
+}
+
+static void sim_line(Player *p, const char *line) {
+  protocol_handle_line(p, rooms, games, players, line);
+  // Jako konec iterace smyčky serveru
+  lobby_publish(rooms, players);
+  if (sim_lobby)
+    spec_flush(players);
+  net_flush_all();
+  sim_cmds++;
+}
+
+static void sim_linef(Player *p, const char *fmt, int a, int b) {
+  char line[64];
+  snprintf(line, sizeof(line), fmt, a, b);
+  sim_line(p, line);
+}
+
+static Room *sim_room_of(const Player *p) {
+  return p->current_room_id > 0 ? find_room_by_id(rooms, p->current_room_id)
+                                : NULL;
+}
+
+static Game *sim_game_of(const Player *p) {
+  Room *r = sim_room_of(p);
+  return r ? &games[room_index(r)] : NULL;
+}
+
+// Lodě vodorovně na sudých řádcích od x=0 (vejde se do všech variant)
+static void sim_place_fleet(Player *p, int variant) {
+  const GameVariant *v = &game_variants[variant];
+  char line[64];
+  if (sim_place == PLACE_AUTO) {
+    sim_line(p, "AUTO_PLACE");
+    return;
+  }
+  if (sim_place == PLACE_FLEET) {
+    char fleet[32 + GAME_FLEET_MAX * 16];
+    int len = snprintf(fleet, sizeof(fleet), "FLEET ");
+    for (int i = 0; i < v->fleet; i++)
+      len += snprintf(fleet + len, sizeof(fleet) - (size_t)len, "%s0,%d,%d,H",
+                      i ? ";" : "", i * 2, v->ship_len[i]);
+    sim_line(p, fleet);
+    return;
+  }
+  sim_line(p, "PLACING_START");
+  for (int i = 0; i < v->fleet; i++) {
+    snprintf(line, sizeof(line), "PLACE 0 %d %d H", i * 2, v->ship_len[i]);
+    sim_line(p, line);
+  }
+  sim_line(p, "PLACING_STOP");
+}
+
+// --- benchmark ---
+
+typedef enum {
+  PAIR_HELLO,
+  PAIR_CREATE,
+  PAIR_JOIN,
+  PAIR_PLACE,
+  PAIR_PLAY,
+  PAIR_LEAVE,
+  PAIR_DONE
+} PairStage;
+
+typedef struct Pair {
+  Player *p[2];
+  int stage;
+  int shot[2]; // index dalšího výstřelu ve "sweepu" každého hráče
+  int off[2];
+  int games_left;
+} Pair;
+
+static const char *variant_cmd[GAME_VARIANT_COUNT] = {"CREATE", "CREATE QUICK",
+                                                      "CREATE LARGE"};
+
+// Jeden krok páru = typicky jeden příkaz; páry se střídají jako na serveru
+static void pair_step(Pair *pr, int variant) {
+  Player *a = pr->p[0], *b = pr->p[1];
+  if (a->socket_fd < 0 || b->socket_fd < 0) {
+    pr->stage = PAIR_DONE; // server pár odpojil (chyba simulátoru/protokolu)
+    return;
+  }
+  switch (pr->stage) {
+  case PAIR_HELLO:
+    sim_linef(a, "HELLO sim%d", a->socket_fd, 0);
+    sim_linef(b, "HELLO sim%d", b->socket_fd, 0);
+    pr->stage = PAIR_CREATE;
+    break;
+  case PAIR_CREATE:
+    if (sim_salvo) {
+      char line[32];
+      snprintf(line, sizeof(line), "%s SALVO", variant_cmd[variant]);
+      sim_line(a, line);
+    } else {
+      sim_line(a, variant_cmd[variant]);
+    }
+    pr->stage = sim_room_of(a) ? PAIR_JOIN : PAIR_CREATE;
+    break;
+  case PAIR_JOIN:
+    sim_linef(b, "JOIN %d", a->current_room_id, 0);
+    pr->stage = PAIR_PLACE;
+    break;
+  case PAIR_PLACE:
+    sim_place_fleet(a, variant);
+    sim_place_fleet(b, variant);
+    pr->shot[0] = pr->shot[1] = 0;
+    pr->stage = PAIR_PLAY;
+    break;
+  case PAIR_PLAY: {
+    Game *g = sim_game_of(a);
+    if (!g || g->finished || pr->shot[0] >= g->n * g->n * 2) {
+      pr->stage = PAIR_LEAVE;
+      break;
+    }
+    // Permutace buněk krokem 7 (nesoudělné s 64, 100 i 256)
+    int s = g->turn, cells = g->n * g->n;
+    if (sim_salvo) {
+      char line[16 + GAME_FLEET_MAX * 8];
+      int len = snprintf(line, sizeof(line), "SALVO");
+      for (int k = 0; k < g->salvo_left; k++) {
+        int c = (pr->shot[s]++ * 7 + pr->off[s]) % cells;
+        len += snprintf(line + len, sizeof(line) - (size_t)len, " %d %d",
+                        c % g->n, c / g->n);
+      }
+      sim_line(pr->p[s], line);
+      break;
+    }
+    int c = (pr->shot[s]++ * 7 + pr->off[s]) % cells;
+    sim_linef(pr->p[s], "SHOOT %d %d", c % g->n, c / g->n);
+    if (sim_poll > 0 && pr->shot[s] % sim_poll == 0)
+      sim_line(pr->p[s], "STATE"); // klient, který si překresluje celou desku
+    break;
+  }
+  case PAIR_LEAVE:
+    if (sim_rematch && pr->games_left > 1 && sim_room_of(a) &&
+        sim_room_of(a)->phase == PHASE_FINISHED) {
+      sim_line(a, "REMATCH");
+      sim_line(b, "REMATCH");
+      pr->games_left--;
+      pr->stage = PAIR_PLACE;
+      break;
+    }
+    sim_line(a, "LEAVE");
+    if (b->current_room_id != -1) // LEAVE ruší celou roomku, b už je v lobby
+      sim_line(b, "LEAVE");
+    pr->stage = (--pr->games_left > 0) ? PAIR_CREATE : PAIR_DONE;
+    break;
+  }
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int bench(int total_games, int npairs, int variant) {
+  sim_init();
+
+  Pair pairs[MAX_PLAYERS / 2];
+  int per_pair = (total_games + npairs - 1) / npairs;
+  for (int i = 0; i < npairs; i++) {
+    pairs[i].p[0] = sim_connect(2 * i);
+    pairs[i].p[1] = sim_connect(2 * i + 1);
+    pairs[i].stage = PAIR_HELLO;
+    pairs[i].off[0] = i % 5;
+    pairs[i].off[1] = 3 + i % 7;
+    pairs[i].games_left = per_pair;
+  }
+
+  // Lobby klienti: odběr jednou na začátku, nebo LIST v každém kole
+  int first_lobby = 2 * npairs;
+  for (int i = 0; i < sim_lobby; i++) {
+    Player *p = sim_connect(first_lobby + i);
+    sim_linef(p, "HELLO lobby%d", i, 0);
+    if (!sim_lobby_poll)
+      sim_line(p, "LIST SUBSCRIBE");
+  }
+
+  double t0 = now_sec();
+  int active = npairs;
+  while (active > 0) {
+    active = 0;
+    for (int i = 0; i < npairs; i++) {
+      if (pairs[i].stage == PAIR_DONE)
+        continue;
+      pair_step(&pairs[i], variant);
+      active++;
+    }
+    for (int i = 0; sim_lobby_poll && i < sim_lobby; i++) {
+      sim_line(&players[first_lobby + i], "LIST");
+      transport_mem_clear(first_lobby + i);
+    }
+  }
+  double dt = now_sec() - t0;
+
+
+  int dropped = 0;
+  for (int i = 0; i < 2 * npairs + sim_lobby; i++)
+    if (players[i].socket_fd < 0)
+      dropped++;
+
+  printf("[%s%s] pairs=%d games=%d commands=%ld\n",
+         game_variants[variant].name, sim_salvo ? " SALVO" : "", npairs,
+         per_pair * npairs, sim_cmds);
+  printf("  time:   %.3f s (%.0f commands/s, %.0f ns/command)\n", dt,
+         sim_cmds / dt, dt / (double)sim_cmds * 1e9);
+  printf("  output: %llu messages, %llu bytes\n",
+         (unsigned long long)transport_mem_messages(),
+         (unsigned long long)transport_mem_bytes());
+  if (sim_lobby)
+    printf("  lobby:  %d client(s) %s\n", sim_lobby,
+           sim_lobby_poll ? "polling LIST every round" : "subscribed");
+  if (dropped) {
+    printf("  %d player(s) disconnected by server!\n", dropped);
+    return 2;
+  }
+  return 0;
+}
+
+// --- cena skenů přes všechny hráče/roomky ---
+
+#define SCAN_EVICT_SIZE (16 << 20) // větší než L2/L3 -> skeny začínají "za studena"
+
+typedef enum { SCAN_HEARTBEAT, SCAN_FIND, SCAN_TICK, SCAN_KINDS } ScanKind;
+
+static const char *scan_name[SCAN_KINDS] = {"heartbeat tick", "find_player_by_fd",
+                                            "reconnect tick"};
+
+static void scan_once(int kind) {
+  switch (kind) {
+  case SCAN_HEARTBEAT:
+    protocol_heartbeat_tick(rooms, games, players);
+    break;
+  case SCAN_FIND:
+    if (find_player_by_fd(players, -2)) // vždy mine -> projde všechny
+      abort();
+    break;
+  default:
+    protocol_tick(rooms, games, players);
+    break;
+  }
+}
+
+// Průměrná doba jednoho skenu v ns; cold = před každým skenem vyhodit cache
+// (tak to vypadá na serveru, kde tick běží jednou za sekundu)
+static double scan_time(int kind, long rounds, unsigned char *evict) {
+  double total = 0;
+  for (long k = 0; k < rounds; k++) {
+    if (evict) {
+      for (size_t i = 0; i < SCAN_EVICT_SIZE; i += 64)
+        evict[i]++;
+    }
+    double t0 = now_sec();
+    scan_once(kind);
+    total += now_sec() - t0;
+  }
+  return total / (double)rounds * 1e9;
+}
+
+// Plný server (všichni připojení, všechny roomky obsazené) a opakovaně jen
+// periodické skeny; hodiny stojí, takže heartbeat nic neposílá
+static int scan_bench(long rounds) {
+  sim_init();
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    Player *p = sim_connect(i);
+    sim_linef(p, "HELLO scan%d", i, 0);
+  }
+  for (int i = 0; i + 1 < MAX_PLAYERS; i += 2) {
+    sim_line(&players[i], "CREATE");
+    sim_linef(&players[i + 1], "JOIN %d", players[i].current_room_id, 0);
+  }
+  protocol_heartbeat_tick(rooms, games, players); // první PING všem
+  net_flush_all();
+
+  unsigned char *evict = calloc(1, SCAN_EVICT_SIZE);
+  if (!evict)
+    return 1;
+
+  printf("scan cost (%d players, %d rooms, sizeof Player=%zu Room=%zu):\n",
+         MAX_PLAYERS, MAX_ROOMS, sizeof(Player), sizeof(Room));
+  for (int kind = 0; kind < SCAN_KINDS; kind++) {
+    int items = (kind == SCAN_TICK) ? MAX_ROOMS : MAX_PLAYERS;
+    double hot = scan_time(kind, rounds, NULL) / items;
+    double cold = scan_time(kind, rounds / 100 + 1, evict) / items;
+    // ns/položku * 10000 / 1000 = us na 10k hráčů (roomek)
+    printf("  %-18s hot %6.2f ns/item, cold %6.2f ns/item "
+           "(%6.1f us per 10k cold)\n",
+           scan_name[kind], hot, cold, cold * 10);
+  }
+  free(evict);
+  return 0;
+}
+
+// --- žebříček ---
+
+static uint64_t rank_rng = 88172645463325252ull;
+
+static unsigned rank_rand(unsigned n) {
+  rank_rng ^= rank_rng << 13; // xorshift64
+  rank_rng ^= rank_rng >> 7;
+  rank_rng ^= rank_rng << 17;
+  return (unsigned)(rank_rng % n);
+}
+
+// Populace s náhodnými výsledky her, pak RANK a stránky LEADERBOARD;
+// pořadí se na závěr ověří proti histogramu ratingů spočtenému hrubou silou
+static int rank_bench(int nplayers) {
+  char a[32], b[32];
+  long ngames = (long)nplayers * 4;
+
+  double t0 = now_sec();
+  for (long k = 0; k < ngames; k++) {
+    unsigned i = (k < nplayers) ? (unsigned)k : rank_rand((unsigned)nplayers);
+    unsigned j = rank_rand((unsigned)nplayers);
+    if (i == j)
+      continue;
+    snprintf(a, sizeof(a), "r%u", i);
+    snprintf(b, sizeof(b), "r%u", j);
+    // Nižší id vyhrává častěji -> rozprostřené ratingy
+    if (rank_rand(4) == 0 ? i > j : i < j)
+      rating_record(a, b);
+    else
+      rating_record(b, a);
+  }
+  double t_rec = now_sec() - t0;
+
+  enum { QUERIES = 1000000 };
+  int rank, rating;
+  long sum = 0;
+  t0 = now_sec();
+  for (int k = 0; k < QUERIES; k++) {
+    snprintf(a, sizeof(a), "r%u", rank_rand((unsigned)nplayers));
+    if (rating_rank(a, &rank, &rating))
+      sum += rank;
+  }
+  double t_rank = now_sec() - t0;
+
+  sim_init();
+  Player *p = sim_connect(0);
+  sim_line(p, "HELLO ranker");
+  net_flush_all();
+  enum { PAGES = 100000 };
+  char line[64];
+  t0 = now_sec();
+  for (int k = 0; k < PAGES; k++) {
+    int off = (k & 1) ? (int)rank_rand((unsigned)rating_players()) : 0;
+    snprintf(line, sizeof(line), "LEADERBOARD %d %d", off,
+             (k & 1) ? RATING_PAGE_MAX : RATING_TOP_N);
+    protocol_handle_line(p, rooms, games, players, line);
+    if ((k & 63) == 63)
+      net_flush_all();
+  }
+  double t_page = now_sec() - t0;
+
+  printf("rating: %d players, %ld games\n", rating_players(), ngames);
+  printf("  record:      %7.1f ns/game\n", t_rec / (double)ngames * 1e9);
+  printf("  RANK:        %7.1f ns/query (incl. snprintf, checksum %ld)\n",
+         t_rank / QUERIES * 1e9, sum);
+  printf("  LEADERBOARD: %7.1f ns/page (top %d cached / %d rows at random "
+         "offset)\n",
+         t_page / PAGES * 1e9, RATING_TOP_N, RATING_PAGE_MAX);
+
+  // Kontrola: rank == 1 + počet hráčů s vyšším ratingem
+  static int hist[RATING_MAX + 1];
+  int *rt = malloc(sizeof(*rt) * (size_t)nplayers);
+  if (!rt)
+    return 1;
+  for (int i = 0; i < nplayers; i++) {
+    snprintf(a, sizeof(a), "r%d", i);
+    rt[i] = rating_rank(a, NULL, &rating) ? rating : -1;
+    if (rt[i] >= 0)
+      hist[rt[i]]++;
+  }
+  for (int r = RATING_MAX - 1; r >= 0; r--)
+    hist[r] += hist[r + 1]; // hist[r] = hráči s ratingem >= r
+  int bad = 0;
+  for (int i = 0; i < nplayers; i++) {
+    snprintf(a, sizeof(a), "r%d", i);
+    if (rt[i] >= 0 && (!rating_rank(a, &rank, NULL) ||
+                       rank != 1 + hist[rt[i] + 1]))
+      bad++;
+  }
+  free(rt);
+  printf("  check:       %d wrong rank(s)\n", bad);
+  return bad ? 2 : 0;
+}
+
+// --- testy s virtuálním časem ---
+
+static int failures;
+
+static void check(int cond, const char *what) {
+  printf("  %-52s %s\n", what, cond ? "ok" : "FAIL");
+  if (!cond)
+    failures++;
+}
+
+static int sim_output_is(const Player *p, const char *want) {
+  size_t len;
+  const char *out = transport_mem_output(p->socket_fd, &len);
+  return len == strlen(want) && memcmp(out, want, len) == 0;
+}
+
+// Všem kromě silent (bitová maska indexů) odpoví na PING, pak proběhne
+// jedno kolo údržby
+static void sim_second(uint64_t silent) {
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    Player *p = &players[i];
+    if (p->socket_fd < 0 || (silent >> i & 1))
+      continue;
+    if (transport_mem_contains(p->socket_fd, "PING\n")) {
+      transport_mem_clear(p->socket_fd);
+      sim_line(p, "PONG");
+    }
+  }
+  transport_mem_advance(1);
+  protocol_tick(rooms, games, players);
+  protocol_heartbeat_tick(rooms, games, players);
+  net_flush_all();
+}
+
+static int timeout_test(void) {
+  sim_init();
+
+  Player *a = sim_connect(0), *b = sim_connect(1), *idle = sim_connect(2);
+  sim_line(a, "HELLO alice");
+  sim_line(b, "HELLO bob");
+  sim_line(idle, "HELLO idle");
+  sim_line(a, "CREATE");
+  sim_linef(b, "JOIN %d", a->current_room_id, 0);
+  sim_place_fleet(a, GAME_VARIANT_CLASSIC);
+  sim_place_fleet(b, GAME_VARIANT_CLASSIC);
+
+  Room *r = sim_room_of(a);
+  int room_id = r ? r->id : -1;
+  printf("heartbeat + reconnect grace (virtual clock):\n");
+  check(r && r->phase == PHASE_PLAY, "room reached PLAY");
+
+  // bob a idle (v lobby) přestanou odpovídat na PING
+  uint64_t silent = (1u << 1) | (1u << 2);
+  transport_mem_clear(a->socket_fd);
+  int down_at = -1;
+  for (int t = 0; t < 40 && down_at < 0; t++) {
+    sim_second(silent);
+    if (transport_mem_contains(a->socket_fd, "OPPONENT_DOWN\n"))
+      down_at = t + 1;
+  }
+  check(down_at > 0, "silent player -> OPPONENT_DOWN");
+  check(b->socket_fd < 0 && transport_mem_is_closed(1),
+        "silent player connection closed");
+  check(idle->socket_fd < 0 && !idle->is_identified,
+        "idle lobby player reset by heartbeat");
+
+  // Grace ještě běží: roomka musí přežít
+  for (int t = 0; t < 40; t++)
+    sim_second(silent);
+  check(find_room_by_id(rooms, room_id) != NULL &&
+            !transport_mem_contains(a->socket_fd, "ROOM_CLOSED"),
+        "room kept during reconnect grace");
+
+  for (int t = 0; t < 10; t++)
+    sim_second(silent);
+  check(transport_mem_contains(a->socket_fd, "ROOM_CLOSED TIMEOUT\n"),
+        "opponent gets ROOM_CLOSED TIMEOUT after grace");
+  check(find_room_by_id(rooms, room_id) == NULL && a->current_room_id == -1,
+        "room destroyed, survivor back in lobby");
+  check(!b->is_identified, "ghost slot released");
+
+  printf("%s (%d failure(s))\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 2 : 0;
+}
+
+// Dohraje hru z PLAY: a potápí flotilu b ze sim_place_fleet (lodě na
+// sudých řádcích od x=0), b mezitím střílí do vody u pravého okraje
+static void sim_finish_game(Player *a, Player *b) {
+  const GameVariant *v = &game_variants[GAME_VARIANT_CLASSIC];
+  int k = 0;
+  for (int i = 0; i < v->fleet; i++)
+    for (int x = 0; x < v->ship_len[i]; x++) {
+      sim_linef(a, "SHOOT %d %d", x, i * 2);
+      if (b && sim_room_of(a) && sim_room_of(a)->phase == PHASE_PLAY) {
+        sim_linef(b, "SHOOT %d %d", 9 - k / 10, k % 10);
+        k++;
+      }
+    }
+}
+
+// Kolik virtuálních sekund uplyne, než p dostane needle (-1 = do max ne);
+// sim_second výstup při PING maže, proto se kontroluje každou sekundu
+static int sim_seconds_until(const Player *p, const char *needle, int max) {
+  for (int t = 1; t <= max; t++) {
+    sim_second(0);
+    if (transport_mem_contains(p->socket_fd, needle))
+      return t;
+  }
+  return -1;
+}
+
+static int rematch_test(void) {
+  sim_init();
+
+  Player *a = sim_connect(0), *b = sim_connect(1);
+  sim_line(a, "HELLO alice");
+  sim_line(b, "HELLO bob");
+  sim_line(a, "CREATE");
+  sim_linef(b, "JOIN %d", a->current_room_id, 0);
+  sim_place_fleet(a, GAME_VARIANT_CLASSIC);
+  sim_place_fleet(b, GAME_VARIANT_CLASSIC);
+  sim_finish_game(a, b);
+
+  Room *r = sim_room_of(a);
+  int room_id = r ? r->id : -1;
+  printf("REMATCH:\n");
+  check(r && r->phase == PHASE_FINISHED, "first game finished");
+
+  transport_mem_clear(a->socket_fd);
+  transport_mem_clear(b->socket_fd);
+  sim_line(a, "REMATCH");
+  check(sim_output_is(a, "REMATCH_WAIT\n") &&
+            transport_mem_contains(b->socket_fd, "OPP_REMATCH\n") &&
+            r->phase == PHASE_FINISHED,
+        "first REMATCH waits for the opponent");
+  sim_line(b, "REMATCH");
+  Game *g = sim_game_of(a);
+  check(transport_mem_contains(a->socket_fd, "REMATCH\nSETUP\n") &&
+            transport_mem_contains(b->socket_fd, "REMATCH\nSETUP\n"),
+        "both REMATCH -> REMATCH + SETUP to both");
+  check(sim_room_of(a) == r && r->id == room_id && r->phase == PHASE_SETUP &&
+            g && g->in_use && !g->ready[0] && !g->ready[1] && !g->shots[0],
+        "same room, fresh game in SETUP");
+
+  sim_place_fleet(a, GAME_VARIANT_CLASSIC);
+  sim_place_fleet(b, GAME_VARIANT_CLASSIC);
+  check(r->phase == PHASE_PLAY, "second game reaches PLAY");
+  sim_finish_game(a, b);
+  check(r->phase == PHASE_FINISHED, "second game finished");
+
+  printf("idle room reclamation (virtual clock):\n");
+  transport_mem_clear(a->socket_fd);
+  int t = sim_seconds_until(a, "ROOM_CLOSED IDLE\n", 2 * ROOM_FINISHED_IDLE_SEC);
+  check(t >= ROOM_FINISHED_IDLE_SEC - 1 && t <= ROOM_FINISHED_IDLE_SEC + 1,
+        "FINISHED room reclaimed after ROOM_FINISHED_IDLE_SEC");
+  check(find_room_by_id(rooms, room_id) == NULL && a->current_room_id == -1 &&
+            b->current_room_id == -1,
+        "players back in lobby");
+
+  sim_line(a, "CREATE");
+  room_id = a->current_room_id;
+  transport_mem_clear(a->socket_fd);
+  t = sim_seconds_until(a, "ROOM_CLOSED IDLE\n", 2 * ROOM_WAITING_IDLE_SEC);
+  check(t >= ROOM_WAITING_IDLE_SEC - 1 && t <= ROOM_WAITING_IDLE_SEC + 1 &&
+            find_room_by_id(rooms, room_id) == NULL,
+        "stale WAITING room reclaimed after ROOM_WAITING_IDLE_SEC");
+
+  printf("REMATCH vs bot:\n");
+  sim_line(a, "CREATE BOT");
+  sim_place_fleet(a, GAME_VARIANT_CLASSIC);
+  r = sim_room_of(a);
+  for (int c = 0; c < 100 && r && r->phase == PHASE_PLAY; c++)
+    sim_linef(a, "SHOOT %d %d", c % 10, c / 10);
+  check(r && r->phase == PHASE_FINISHED, "bot game finished");
+  transport_mem_clear(a->socket_fd);
+  sim_line(a, "REMATCH");
+  g = sim_game_of(a);
+  check(sim_output_is(a, "REMATCH\nSETUP\n") && g && g->ready[BOT_SLOT] &&
+            !g->ready[0],
+        "bot agrees at once and is ready");
+
+  printf("%s (%d failure(s))\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 2 : 0;
+}
+
+// Obsah výstupu p jako řetězec (pro sscanf/strstr v testech)
+static const char *sim_output(const Player *p) {
+  static char buf[MEM_OUT_SIZE + 1];
+  size_t len;
+  const char *out = transport_mem_output(p->socket_fd, &len);
+  memcpy(buf, out, len);
+  buf[len] = '\0';
+  return buf;
+}
+
+static int salvo_test(void) {
+  sim_init();
+
+  Player *a = sim_connect(0), *b = sim_connect(1);
+  sim_line(a, "HELLO alice");
+  sim_line(b, "HELLO bob");
+  sim_line(a, "CREATE SALVO");
+  check(transport_mem_contains(a->socket_fd, "MODE SALVO\n"),
+        "CREATE SALVO announces MODE SALVO");
+  transport_mem_clear(b->socket_fd);
+  sim_line(b, "LIST");
+  check(transport_mem_contains(b->socket_fd, "MODE=SALVO\n"),
+        "LIST marks the salvo room");
+  sim_linef(b, "JOIN %d", a->current_room_id, 0);
+  check(transport_mem_contains(b->socket_fd, "MODE SALVO\n"),
+        "JOIN announces MODE SALVO");
+  transport_mem_clear(a->socket_fd);
+  transport_mem_clear(b->socket_fd);
+  sim_place_fleet(a, GAME_VARIANT_CLASSIC);
+  sim_place_fleet(b, GAME_VARIANT_CLASSIC);
+
+  Room *r = sim_room_of(a);
+  Game *g = sim_game_of(a);
+  printf("salvo turns:\n");
+  check(r && r->phase == PHASE_PLAY && g && g->salvo && g->salvo_left == 5,
+        "PLAY with a 5-shot salvo (5 ships afloat)");
+  check(transport_mem_contains(a->socket_fd, "YOUR_TURN 5\n") &&
+            transport_mem_contains(b->socket_fd, "OPP_TURN\n"),
+        "YOUR_TURN carries the salvo size");
+
+  transport_mem_clear(a->socket_fd);
+  sim_line(a, "SHOOT 0 0");
+  check(sim_output_is(a, "ERROR SHOOT SALVO_REQUIRED\n") && !g->shots[0],
+        "single SHOOT refused in a salvo room");
+  transport_mem_clear(a->socket_fd);
+  sim_line(a, "SALVO 0 0 1 0 2 0 3 0");
+  check(sim_output_is(a, "ERROR SALVO SALVO_SIZE\n"), "short salvo refused");
+  transport_mem_clear(a->socket_fd);
+  sim_line(a, "SALVO 0 0 1 0 2 0 3 0 0 0");
+  check(sim_output_is(a, "ERROR SALVO DUPLICATE\n"), "duplicate cell refused");
+  transport_mem_clear(a->socket_fd);
+  sim_line(a, "SALVO 0 0 1 0 2 0 3 0 10 0");
+  check(sim_output_is(a, "ERROR SALVO OUT_OF_BOUNDS\n") && !g->shots[0] &&
+            g->board[1][0][0] == 1 && g->turn == 0,
+        "invalid salvo leaves the board untouched");
+
+  // Lodě b: délka 5 na řádku 0, délka 2 na řádku 8 -> potopí dvojku
+  transport_mem_clear(a->socket_fd);
+  transport_mem_clear(b->socket_fd);
+  sim_line(a, "SALVO 0 0 1 0 0 8 1 8 9 9");
+  check(sim_output_is(a, "SHOT 0 0 HIT\nSHOT 1 0 HIT\nSHOT 0 8 HIT\n"
+                         "SHOT 1 8 SUNK 0 8 2 H\nSHOT 9 9 WATER\nOPP_TURN\n"),
+        "salvo answered with one coalesced reply");
+  check(sim_output_is(b, "OPP_SHOT 0 0 HIT\nOPP_SHOT 1 0 HIT\n"
+                         "OPP_SHOT 0 8 HIT\nOPP_SHOT 1 8 SUNK 0 8 2 H\n"
+                         "OPP_SHOT 9 9 WATER\nYOUR_TURN 4\n"),
+        "opponent gets the whole salvo and its turn at once");
+  check(g->turn == 1 && g->shots[0] == 5 && g->salvo_left == 4,
+        "turn passes once, salvo shrinks with sunk ships");
+
+  transport_mem_clear(a->socket_fd);
+  sim_line(b, "SALVO 9 9 9 8 9 7 9 6");
+  check(transport_mem_contains(a->socket_fd, "YOUR_TURN 5\n") &&
+            g->shots[1] == 4,
+        "4-shot salvo back, 5 shots for the intact fleet");
+
+  // Dohrát: a potápí zbytek, b střílí do vody u pravého okraje
+  int k = 0;
+  while (r->phase == PHASE_PLAY && k < 200) {
+    char line[16 + GAME_FLEET_MAX * 8];
+    Player *s = (g->turn == 0) ? a : b;
+    int len = snprintf(line, sizeof(line), "SALVO");
+    for (int i = 0, found = 0; found < g->salvo_left && i < 100; i++) {
+      int x = (g->turn == 0) ? i % 10 : 8 - i / 10;
+      int y = (g->turn == 0) ? i / 10 : i % 10;
+      if (g->board[1 - g->turn][y][x] >= 2)
+        continue;
+      len += snprintf(line + len, sizeof(line) - (size_t)len, " %d %d", x, y);
+      found++;
+    }
+    sim_line(s, line);
+    k++;
+  }
+  check(r->phase == PHASE_FINISHED && g->winner == 0 &&
+            transport_mem_contains(a->socket_fd, " WIN\n") &&
+            transport_mem_contains(b->socket_fd, " LOSE\n"),
+        "winning salvo ends the game (WIN / LOSE)");
+
+  printf("salvo vs bot:\n");
+  sim_line(a, "LEAVE");
+  sim_line(a, "CREATE SALVO BOT hard");
+  sim_place_fleet(a, GAME_VARIANT_CLASSIC);
+  g = sim_game_of(a);
+  transport_mem_clear(a->socket_fd);
+  sim_line(a, "SALVO 0 0 1 1 2 2 3 3 4 4");
+  const char *out = sim_output(a);
+  int opp = 0;
+  for (const char *q = out; (q = strstr(q, "OPP_SHOT ")); q++)
+    opp++;
+  check(g && g->shots[1] == 5 && opp == 5 && g->turn == 0,
+        "bot answers with a full salvo of distinct cells");
+  check(strstr(out, "YOUR_TURN ") != NULL, "turn back to the player");
+
+  printf("%s (%d failure(s))\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 2 : 0;
+}
+
+// Konec iterace s odběrateli: diff lobby + fronty (sim_line to dělá jen
+// s --lobby)
+static void sim_publish(void) {
+  lobby_publish(rooms, players);
+  spec_flush(players);
+  net_flush_all();
+}
+
+// Zpožděný přenos (--watch-delay): zprávy čekají v logu roomky a do fronty
+// diváka jdou až dozralé, takže rychlá hra nevykopne diváka, který čte
+static int watch_test(void) {
+  sim_init();
+  spec_delay_sec = 10;
+
+  Pair pr = {{sim_connect(0), sim_connect(1)}, PAIR_HELLO, {0, 0}, {0, 3}, 1};
+  Player *c = sim_connect(2), *d = sim_connect(3);
+  sim_line(c, "HELLO carol");
+  sim_line(d, "HELLO dave");
+  while (pr.stage != PAIR_PLAY)
+    pair_step(&pr, GAME_VARIANT_LARGE);
+  int rid = pr.p[0]->current_room_id;
+
+  printf("delayed broadcast:\n");
+  transport_mem_clear(c->socket_fd);
+  sim_linef(c, "WATCH %d", rid, 0);
+  check(transport_mem_contains(c->socket_fd, "WATCHING ") &&
+            !transport_mem_contains(c->socket_fd, "SPEC_PHASE"),
+        "WATCHING at once, snapshot waits for the delay");
+
+  // 200 výstřelů za 5 s: na zpoždění čeká víc zpráv, než je OUTQ_MAX
+  int shots = 0;
+  for (; shots < 200 && pr.stage == PAIR_PLAY; shots++) {
+    pair_step(&pr, GAME_VARIANT_LARGE);
+    spec_flush(players);
+    net_flush_all();
+    if (shots % 40 == 39)
+      transport_mem_advance(1);
+  }
+  check(shots == 200 && shots > OUTQ_MAX, "game outpaces the queue size");
+  check(!transport_mem_contains(c->socket_fd, "SPEC_SHOT"),
+        "nothing before the delay");
+  for (int t = 0; t < 6; t++) {
+    transport_mem_advance(1);
+    spec_flush(players);
+    net_flush_all();
+  }
+  check(transport_mem_contains(c->socket_fd, "SPEC_SHOT") &&
+            !transport_mem_contains(c->socket_fd, "SLOW") &&
+            c->watching_room_id == rid,
+        "events arrive after the delay, reader is not SLOW");
+
+  printf("room closed while events are pending:\n");
+  sim_line(pr.p[0], "LEAVE");
+  sim_line(pr.p[1], "CREATE");
+  transport_mem_clear(d->socket_fd);
+  sim_linef(d, "WATCH %d", pr.p[1]->current_room_id, 0);
+  for (int t = 0; t < 5; t++) {
+    transport_mem_advance(1);
+    spec_flush(players);
+    net_flush_all();
+  }
+  check(c->spec_feed != 0 && !transport_mem_contains(c->socket_fd, "WATCH_END"),
+        "old watcher still drains the delayed log");
+  transport_mem_clear(c->socket_fd);
+  for (int t = 0; t < 6; t++) {
+    transport_mem_advance(1);
+    spec_flush(players);
+    net_flush_all();
+  }
+  char end[32];
+  snprintf(end, sizeof(end), "WATCH_END %d\n", rid);
+  check(transport_mem_contains(c->socket_fd, end) && c->spec_feed == 0,
+        "WATCH_END after the delay, watcher leaves");
+  check(!transport_mem_contains(c->socket_fd, "SPEC_PHASE") &&
+            transport_mem_contains(d->socket_fd, "SPEC_PHASE LOBBY"),
+        "only the new room's watcher gets its snapshot");
+
+  spec_delay_sec = SPECTATE_DELAY_SEC;
+  printf("%s (%d failure(s))\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 2 : 0;
+}
+
+static int lobby_test(void) {
+  sim_init();
+
+  Player *a = sim_connect(0), *b = sim_connect(1), *c = sim_connect(2),
+         *d = sim_connect(3);
+  sim_line(a, "HELLO alice");
+  sim_line(b, "HELLO bob");
+  sim_line(c, "HELLO carol");
+  sim_line(d, "HELLO dave");
+
+  printf("LIST SUBSCRIBE:\n");
+  sim_line(a, "CREATE");
+  transport_mem_clear(c->socket_fd);
+  sim_line(c, "LIST SUBSCRIBE");
+  check(sim_output_is(c, "ROOMS 1\nROOM 1 1 WAITING LOBBY P1=UP P2=DOWN "
+                         "VARIANT=CLASSIC\nLIST_SUBSCRIBED\n"),
+        "snapshot + LIST_SUBSCRIBED");
+  sim_line(d, "LIST SUBSCRIBE");
+  transport_mem_clear(c->socket_fd);
+  transport_mem_clear(d->socket_fd);
+
+  sim_line(b, "CREATE QUICK SALVO");
+  sim_publish();
+  check(sim_output_is(c, "ROOM+ 2 1 WAITING LOBBY P1=UP P2=DOWN "
+                         "VARIANT=QUICK MODE=SALVO\n"),
+        "new room -> ROOM+");
+  check(sim_output_is(d, "ROOM+ 2 1 WAITING LOBBY P1=UP P2=DOWN "
+                         "VARIANT=QUICK MODE=SALVO\n"),
+        "same diff to every subscriber");
+
+  // LEAVE + JOIN v jedné iteraci: víc změn, jeden řádek na roomku
+  transport_mem_clear(c->socket_fd);
+  protocol_handle_line(b, rooms, games, players, "LEAVE");
+  protocol_handle_line(b, rooms, games, players, "JOIN 1");
+  sim_publish();
+  check(sim_output_is(c, "ROOM~ 1 2 FULL SETUP P1=UP P2=UP VARIANT=CLASSIC\n"
+                         "ROOM- 2\n"),
+        "changes coalesced per room and iteration");
+
+  transport_mem_clear(c->socket_fd);
+  sim_line(a, "STATE");
+  sim_publish();
+  check(sim_output_is(c, ""), "no room change -> nothing sent");
+
+  sim_place_fleet(a, GAME_VARIANT_CLASSIC);
+  sim_place_fleet(b, GAME_VARIANT_CLASSIC);
+  sim_finish_game(a, b);
+  sim_publish();
+  check(transport_mem_contains(c->socket_fd, "ROOM~ 1 2 FULL PLAY ") &&
+            transport_mem_contains(c->socket_fd, "ROOM~ 1 2 FULL FINISHED "),
+        "phase changes pushed");
+
+  transport_mem_clear(c->socket_fd);
+  sim_line(a, "LEAVE");
+  sim_publish();
+  check(sim_output_is(c, "ROOM- 1\n"), "closed room -> ROOM-");
+
+  printf("end of subscription:\n");
+  transport_mem_clear(d->socket_fd);
+  sim_line(d, "LIST UNSUBSCRIBE");
+  sim_line(a, "CREATE");
+  sim_publish();
+  check(sim_output_is(d, "LIST_UNSUBSCRIBED\n") && !d->lobby_sub,
+        "LIST UNSUBSCRIBE stops diffs");
+  sim_linef(c, "JOIN %d", a->current_room_id, 0);
+  check(!c->lobby_sub, "entering a room ends the subscription");
+  transport_mem_clear(d->socket_fd);
+  sim_linef(d, "WATCH %d", a->current_room_id, 0);
+  sim_line(d, "LIST SUBSCRIBE");
+  check(transport_mem_contains(d->socket_fd, "ERROR BAD_STATE\n") &&
+            !d->lobby_sub,
+        "spectator cannot subscribe");
+
+  printf("%s (%d failure(s))\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 2 : 0;
+}
+
+// FLEET ze sim_place_fleet (lodě na sudých řádcích od x=0), s předponou
+static void sim_mux_fleet(Player *p, int room_id) {
+  const GameVariant *v = &game_variants[GAME_VARIANT_CLASSIC];
+  char fleet[32 + GAME_FLEET_MAX * 16];
+  int len = snprintf(fleet, sizeof(fleet), "@%d FLEET ", room_id);
+  for (int i = 0; i < v->fleet; i++)
+    len += snprintf(fleet + len, sizeof(fleet) - (size_t)len, "%s0,%d,%d,H",
+                    i ? ";" : "", i * 2, v->ship_len[i]);
+  sim_line(p, fleet);
+}
+
+static int mux_test(void) {
+  sim_init();
+
+  Player *m = sim_connect(0), *h = sim_connect(1);
+  sim_line(m, "HELLO botfarm");
+  sim_line(h, "HELLO human");
+
+  printf("MUX seats:\n");
+  transport_mem_clear(m->socket_fd);
+  sim_line(m, "MUX");
+  check(sim_output_is(m, "MUX_ON\n"), "MUX -> MUX_ON");
+  transport_mem_clear(m->socket_fd);
+  sim_line(m, "CREATE");
+  sim_line(m, "CREATE BOT");
+  check(transport_mem_contains(m->socket_fd, "@1 CREATED 1\n@1 ") &&
+            transport_mem_contains(m->socket_fd, "@2 CREATED 2\n@2 ") &&
+            transport_mem_contains(m->socket_fd, "@2 JOINED 2 1\n@2 SETUP\n"),
+        "CREATE adds seats, replies tagged");
+  check(m->current_room_id == -1 && rooms[0].player_fds[0] == m->socket_fd &&
+            rooms[1].player_fds[0] == m->socket_fd,
+        "seats live in rooms, not in Player");
+
+  transport_mem_clear(m->socket_fd);
+  sim_line(h, "JOIN 1");
+  check(sim_output_is(m, "@1 JOINED 1 1\n@1 SETUP\n"),
+        "opponent's JOIN tagged for MUX host");
+  transport_mem_clear(m->socket_fd);
+  sim_mux_fleet(m, 1);
+  sim_place_fleet(h, GAME_VARIANT_CLASSIC);
+  check(transport_mem_contains(m->socket_fd, "@1 YOUR_TURN\n"),
+        "game starts on seat 1");
+  check(!transport_mem_contains(h->socket_fd, "@"),
+        "plain connection gets no tags");
+
+  // Tři příkazy pro dvě roomky v jedné iteraci: jeden send() na spojení
+  transport_mem_clear(m->socket_fd);
+  uint64_t msgs = transport_mem_messages();
+  protocol_handle_line(m, rooms, games, players, "@1 SHOOT 9 9");
+  protocol_handle_line(m, rooms, games, players, "@2 AUTO_PLACE");
+  protocol_handle_line(m, rooms, games, players, "@2 STATE");
+  net_flush_all();
+  check(transport_mem_messages() - msgs == 2, "one send per connection");
+  check(transport_mem_contains(m->socket_fd, "@1 WATER\n") &&
+            transport_mem_contains(m->socket_fd, "@2 YOUR_TURN\n"),
+        "events of both games in one batch");
+
+  printf("errors:\n");
+  transport_mem_clear(m->socket_fd);
+  sim_line(m, "@3 STATE");
+  check(sim_output_is(m, "@3 ERROR NOT_IN_ROOM\n"), "unseated room refused");
+  for (int i = 0; i < 10; i++) // MAX_INVALID je 5
+    sim_line(m, "@7 SHOOT 0 0");
+  check(m->is_identified && m->invalid_count == 0,
+        "late commands to a closed room cost no strike");
+  for (int i = 0; i < 5; i++) // 2 sedadla -> limit 15
+    sim_line(m, "@1 BOGUS");
+  check(m->is_identified && rooms[0].slot_connected[0],
+        "strike limit scales with seats");
+  m->invalid_count = 0;
+  transport_mem_clear(m->socket_fd);
+  sim_line(m, "JOIN 1");
+  check(sim_output_is(m, "ERROR ALREADY_IN_ROOM\n"), "no second seat in a room");
+  transport_mem_clear(m->socket_fd);
+  sim_line(m, "@1 PLACING_START");
+  check(sim_output_is(m, "@1 ERROR UNSUPPORTED\n"), "batch placing refused");
+  m->invalid_count = 0;
+
+  printf("disconnect and REJOIN:\n");
+  transport_mem_clear(h->socket_fd);
+  protocol_disconnect(m, rooms, games, players, "test");
+  net_flush_all();
+  check(sim_output_is(h, "OPPONENT_DOWN\n"), "opponent sees OPPONENT_DOWN");
+  check(!m->is_identified && !rooms[0].slot_connected[0] &&
+            !rooms[1].slot_connected[0],
+        "all seats DOWN, no ghost Player");
+
+  Player *m2 = sim_connect(2);
+  sim_line(m2, "HELLO botfarm");
+  sim_line(m2, "MUX");
+  sim_line(m2, "REJOIN 1");
+  sim_line(m2, "REJOIN 2");
+  check(transport_mem_contains(m2->socket_fd, "@1 OK REJOINED 1 1\n") &&
+            transport_mem_contains(m2->socket_fd, "@2 OK REJOINED 2 1\n"),
+        "REJOIN takes seats back one by one");
+
+  // Dohrát roomku 1: m2 potápí flotilu h, h střílí vodu
+  const GameVariant *v = &game_variants[GAME_VARIANT_CLASSIC];
+  Game *g = &games[0];
+  int k = 0;
+  for (int i = 0; i < v->fleet; i++)
+    for (int x = 0; x < v->ship_len[i]; x++) {
+      if (g->turn == 1) {
+        sim_linef(h, "SHOOT %d %d", 9 - k / 10, k % 10);
+        k++;
+      }
+      sim_linef(m2, "@1 SHOOT %d %d", x, i * 2);
+    }
+  check(transport_mem_contains(m2->socket_fd, "@1 WIN\n") &&
+            rooms[0].phase == PHASE_FINISHED,
+        "game won through tagged commands");
+
+  int identified = 0;
+  for (int i = 0; i < MAX_PLAYERS; i++)
+    identified += players[i].is_identified;
+  check(identified == 2 && rooms[1].player_fds[0] == m2->socket_fd,
+        "two games, one Player slot for the bot host");
+
+  printf("%s (%d failure(s))\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 2 : 0;
+}
+
+// Token z posledního WELCOME/RESUMED ve výstupu spojení (3. slovo řádku)
+static void sim_token(const Player *p, char tok[17]) {
+  size_t len;
+  const char *out = transport_mem_output(p->socket_fd, &len);
+  char buf[MEM_OUT_SIZE + 1];
+  memcpy(buf, out, len);
+  buf[len] = '\0';
+
+  tok[0] = '\0';
+  for (char *l = strtok(buf, "\n"); l; l = strtok(NULL, "\n"))
+    if (strncmp(l, "WELCOME ", 8) == 0 || strncmp(l, "RESUMED ", 8) == 0)
+      sscanf(l, "%*s %*s %16s", tok);
+}
+
+static int resume_test(void) {
+  sim_init();
+
+  Player *a = sim_connect(0), *b = sim_connect(1);
+  sim_line(a, "HELLO alice");
+  sim_line(b, "HELLO bob");
+  char tok[17], tok2[17];
+  sim_token(b, tok);
+  printf("session resume:\n");
+  check(strlen(tok) == 16, "WELCOME carries a resume token");
+
+  sim_line(a, "CREATE");
+  int room_id = a->current_room_id;
+  sim_linef(b, "JOIN %d", room_id, 0);
+  sim_place_fleet(a, GAME_VARIANT_CLASSIC);
+  sim_place_fleet(b, GAME_VARIANT_CLASSIC);
+  sim_line(a, "SHOOT 0 0");
+
+  // bob spadne a vrátí se na novém spojení jedním příkazem
+  protocol_disconnect(b, rooms, games, players, "test");
+  net_flush_all();
+  transport_mem_clear(a->socket_fd);
+  Player *c = sim_connect(2);
+  char line[64];
+  snprintf(line, sizeof(line), "RESUME %s 17", tok);
+  sim_line(c, line);
+  check(transport_mem_contains(c->socket_fd, "RESUMED bob ") &&
+            c->current_room_id == room_id && c->player_slot == 1,
+        "RESUME reattaches the ghost slot");
+  check(transport_mem_contains(c->socket_fd, "STATE ROOM=") &&
+            transport_mem_contains(c->socket_fd, "BENEMY 9 ") &&
+            transport_mem_contains(c->socket_fd, "YOUR_TURN\n"),
+        "one reply carries state, boards and turn");
+  check(transport_mem_contains(a->socket_fd, "OPPONENT_UP\n"),
+        "opponent told OPPONENT_UP");
+  sim_token(c, tok2);
+  check(tok2[0] && strcmp(tok, tok2) != 0, "token rotated on resume");
+
+  Player *d = sim_connect(3);
+  sim_line(d, line); // starý token
+  check(transport_mem_contains(d->socket_fd, "ERROR RESUME_DENIED\n") &&
+            !d->is_identified,
+        "old token rejected");
+
+  // Převzetí živého spojení (klient o starém TCP neví)
+  Player *e = sim_connect(4);
+  snprintf(line, sizeof(line), "RESUME %s", tok2);
+  sim_line(e, line);
+  check(c->socket_fd < 0 && transport_mem_is_closed(2) &&
+            e->current_room_id == room_id && e->player_slot == 1,
+        "RESUME takes over a still-open session");
+  sim_line(e, "SHOOT 0 0");
+  check(transport_mem_contains(e->socket_fd, "HIT\n"),
+        "resumed player plays on");
+
+  printf("%s (%d failure(s))\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 2 : 0;
+}
+
+// Přetížení: úroveň se vnutí přes load_force (měření lagu tu nedává smysl)
+static int overload_test(void) {
+  sim_init();
+
+  Player *a = sim_connect(0), *b = sim_connect(1), *c = sim_connect(2);
+  sim_line(a, "HELLO alice");
+  sim_line(b, "HELLO bob");
+  sim_line(c, "HELLO carol");
+  sim_line(a, "CREATE");
+  sim_linef(b, "JOIN %d", a->current_room_id, 0);
+  sim_place_fleet(a, GAME_VARIANT_CLASSIC);
+  sim_place_fleet(b, GAME_VARIANT_CLASSIC);
+  int room_id = a->current_room_id;
+  printf("load shedding (forced levels):\n");
+
+  load_force(LOAD_BUSY);
+  transport_mem_clear(c->socket_fd);
+  sim_line(c, "LIST");
+  sim_linef(c, "WATCH %d", room_id, 0);
+  check(sim_output_is(c, "ERROR BUSY 1\nERROR BUSY 1\n"),
+        "BUSY: LIST and WATCH -> ERROR BUSY 1");
+  check(c->invalid_count == 0, "BUSY: shed commands are not strikes");
+  transport_mem_clear(a->socket_fd);
+  sim_line(a, "SHOOT 0 0");
+  check(transport_mem_contains(a->socket_fd, "HIT\n"),
+        "BUSY: in-game SHOOT still served");
+
+  load_force(LOAD_CRITICAL);
+  transport_mem_clear(c->socket_fd);
+  sim_line(c, "CREATE");
+  check(sim_output_is(c, "ERROR BUSY 2\n") && c->current_room_id == -1,
+        "CRITICAL: CREATE -> ERROR BUSY 2");
+  // Nikdo neodpovídá na PING: při CRITICAL se výpadky nepočítají
+  for (int t = 0; t < 60; t++)
+    sim_second(~(uint64_t)0);
+  check(a->socket_fd >= 0 && b->socket_fd >= 0 && c->socket_fd >= 0,
+        "CRITICAL: missed PONGs do not disconnect");
+
+  // Čtení přes protocol_serve jako ve smyčce: LEAVE v prvním průchodu
+  // (hráči ve hře) nesmí hráče poslat na recv i ve druhém (lobby). Sockety
+  // jsou neblokující, takže druhé čtení by skončilo odpojením, ne zamrznutím.
+  load_force(LOAD_BUSY);
+  int sv[2][2];
+  check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv[0]) == 0 &&
+            socketpair(AF_UNIX, SOCK_STREAM, 0, sv[1]) == 0 &&
+            sv[0][0] < MAX_PLAYERS && sv[1][0] < MAX_PLAYERS,
+        "socket pairs for the read loop");
+  Player *l = sim_connect(sv[0][0]), *n = sim_connect(sv[1][0]);
+  fcntl(l->socket_fd, F_SETFL, O_NONBLOCK);
+  fcntl(n->socket_fd, F_SETFL, O_NONBLOCK);
+  sim_line(l, "HELLO leaver");
+  sim_line(l, "CREATE");
+  transport_mem_clear(l->socket_fd);
+  check(write(sv[0][1], "LEAVE\n", 6) == 6 &&
+            write(sv[1][1], "HELLO newcomer\n", 15) == 15,
+        "LEAVE and HELLO on the wire");
+  fd_set rd;
+  FD_ZERO(&rd);
+  FD_SET(l->socket_fd, &rd);
+  FD_SET(n->socket_fd, &rd);
+  protocol_serve(rooms, games, players, &rd, LOAD_BUSY, 0);
+  net_flush_all();
+  check(l->socket_fd >= 0 && l->current_room_id == -1 &&
+            transport_mem_contains(sv[0][0], "LEFT "),
+        "BUSY: LEAVE served once, player stays connected");
+  check(transport_mem_contains(sv[1][0], "WELCOME newcomer"),
+        "BUSY: lobby HELLO served in the same iteration");
+  for (int i = 0; i < 2; i++) {
+    protocol_disconnect(&players[sv[i][0]], rooms, games, players, "test");
+    close(sv[i][0]);
+    close(sv[i][1]);
+  }
+
+  load_force(-1);
+  transport_mem_clear(c->socket_fd);
+  sim_line(c, "LIST");
+  check(transport_mem_contains(c->socket_fd, "ROOMS 1\n"),
+        "OK again: LIST served");
+
+  printf("%s (%d failure(s))\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 2 : 0;
+}
+
+// --- obnova z WAL ---
+
+#define WAL_BENCH_PREFIX "/tmp/protosim_wal"
+
+static Room wal_saved_rooms[MAX_ROOMS];
+static Game wal_saved_games[MAX_ROOMS];
+
+static void wal_bench_unlink(void) {
+  const char *ext[] = {".snap", ".wal0", ".wal1"};
+  char path[64];
+  for (int i = 0; i < 3; i++) {
+    snprintf(path, sizeof(path), "%s%s", WAL_BENCH_PREFIX, ext[i]);
+    unlink(path);
+  }
+}
+
+static void wal_pairs(Pair pairs[], int npairs, int games_left) {
+  for (int i = 0; i < npairs; i++) {
+    pairs[i].p[0] = sim_connect(2 * i);
+    pairs[i].p[1] = sim_connect(2 * i + 1);
+    pairs[i].stage = PAIR_HELLO;
+    pairs[i].off[0] = i % 5;
+    pairs[i].off[1] = 3 + i % 7;
+    pairs[i].games_left = games_left;
+  }
+}
+
+// Páry hrají, dokud poslední hra každého páru nemá `shots` výstřelů
+static void wal_play(Pair pairs[], int npairs, int shots) {
+  int active = npairs;
+  while (active > 0) {
+    active = 0;
+    for (int i = 0; i < npairs; i++) {
+      Pair *pr = &pairs[i];
+      if (pr->stage == PAIR_DONE || (pr->games_left == 1 &&
+                                     pr->stage == PAIR_PLAY && pr->shot[0] >= shots))
+        continue;
+      pair_step(pr, GAME_VARIANT_CLASSIC);
+      active++;
+    }
+    wal_flush(rooms, games); // jedno kolo párů = jedna iterace smyčky serveru
+  }
+}
+
+// "Pád": stav se uloží pro porovnání, pole se vynulují
+static void wal_crash(void) {
+  memcpy(wal_saved_rooms, rooms, sizeof(rooms));
+  memcpy(wal_saved_games, games, sizeof(games));
+  wal_close();
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    room_reset(&rooms[i]);
+    game_reset(&games[i]);
+  }
+}
+
+static void wal_compare(void) {
+  // Po obnově se liší jen čas startu hry a vazba na sockety (sloty DOWN)
+  int rooms_ok = 1, games_ok = 1, down_ok = 1;
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    const Room *a = &wal_saved_rooms[i], *b = &rooms[i];
+    if (a->state != b->state || (a->state != ROOM_EMPTY &&
+                                 (a->id != b->id || a->phase != b->phase ||
+                                  a->variant != b->variant ||
+                                  memcmp(a->player_names, b->player_names,
+                                         sizeof(a->player_names)) != 0)))
+      rooms_ok = 0;
+    if (b->state != ROOM_EMPTY && (b->slot_connected[0] || b->slot_connected[1]))
+      down_ok = 0;
+    Game g = games[i];
+    g.started_at = wal_saved_games[i].started_at;
+    if (memcmp(&g, &wal_saved_games[i], sizeof(g)) != 0)
+      games_ok = 0;
+  }
+  check(rooms_ok, "rooms match the pre-crash state");
+  check(games_ok, "games (boards, turn, hits) match");
+  check(down_ok, "every human slot is DOWN");
+}
+
+// Pád uprostřed obnovy: na disku snapshot s, log s a log s + 1 (přepnutí
+// snapshotu před pádem nedoběhlo). Obnova (v potomkovi) přepne snapshot a
+// spadne dřív, než začne nový log v souboru, kde leží log s + 1. Další
+// obnova nesmí přijít o žádný tah.
+static void wal_crash_switch(int npairs) {
+  sim_init();
+  wal_bench_unlink();
+  wal_snapshot_bytes = LONG_MAX;
+  if (!wal_open(WAL_BENCH_PREFIX, rooms, games)) {
+    check(0, "wal opens for the crash test");
+    return;
+  }
+  Pair pairs[MAX_PLAYERS / 2];
+  wal_pairs(pairs, npairs, 2);
+  wal_play(pairs, npairs, 10);
+  wal_crash_at = WAL_CRASH_HOLD_SWITCH;
+  wal_snapshot_bytes = 0; // první flush začne epochu s + 1, víc jich nebude
+  wal_play(pairs, npairs, 20);
+  wal_crash();
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    wal_crash_at = WAL_CRASH_RECOVERY;
+    wal_open(WAL_BENCH_PREFIX, rooms, games);
+    _exit(1); // sem se nemá dojít
+  }
+  int status = 1;
+  if (pid > 0)
+    waitpid(pid, &status, 0);
+  wal_crash_at = WAL_CRASH_NONE;
+  check(pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+        "recovery crashed between snapshot switch and log reset");
+
+  int opened = wal_open(WAL_BENCH_PREFIX, rooms, games);
+  check(opened, "wal reopens after the crash in recovery");
+  if (!opened)
+    return;
+  printf("[wal] crash in recovery: epoch %llu, %ld record(s) replayed\n",
+         (unsigned long long)wal_recovery.epoch, wal_recovery.records);
+  wal_compare();
+  wal_close();
+}
+
+// Odehraje games životních cyklů roomek s logem a bez snapshotu (nejhorší
+// případ: přehrává se všechno), poslední hra každého páru zůstane rozehraná.
+// Pak "pád": pole se vynulují a obnoví z disku, výsledek se porovná.
+static int wal_bench(int total_games, int npairs) {
+  sim_init();
+  wal_bench_unlink();
+  wal_snapshot_bytes = LONG_MAX;
+  if (!wal_open(WAL_BENCH_PREFIX, rooms, games))
+    return 1;
+
+  Pair pairs[MAX_PLAYERS / 2];
+  int per_pair = (total_games + npairs - 1) / npairs;
+  wal_pairs(pairs, npairs, per_pair + 1);
+  wal_play(pairs, npairs, 10);
+  wal_crash();
+  double t0 = now_sec();
+  int opened = wal_open(WAL_BENCH_PREFIX, rooms, games);
+  double dt = now_sec() - t0;
+  if (!opened)
+    return 1;
+
+  printf("[wal] %d room lifecycle(s), %d in progress at crash\n",
+         per_pair * npairs, wal_recovery.rooms);
+  printf("  replayed: %ld record(s), %ld bytes (%ld rejected)\n",
+         wal_recovery.records, wal_recovery.bytes, wal_recovery.rejected);
+  printf("  recovery: %.3f s (%.0f ns/record)\n", dt,
+         dt / (double)(wal_recovery.records ? wal_recovery.records : 1) * 1e9);
+
+  wal_compare();
+
+  // Hráč se po restartu vrací přes HELLO + REJOIN do rozehrané hry
+  transport_mem_reset(SIM_START_TIME);
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    memset(&players[i], 0, sizeof(players[i]));
+    players[i].socket_fd = -1;
+    player_reset(&players[i]);
+  }
+  int rid = -1;
+  for (int i = 0; i < MAX_ROOMS; i++)
+    if (rooms[i].state != ROOM_EMPTY &&
+        strcmp(rooms[i].player_names[0], "sim0") == 0)
+      rid = rooms[i].id;
+  Player *a = sim_connect(0);
+  sim_line(a, "HELLO sim0");
+  transport_mem_clear(a->socket_fd);
+  sim_linef(a, "REJOIN %d", rid, 0);
+  check(rid > 0 && transport_mem_contains(a->socket_fd, "OK REJOINED ") &&
+            transport_mem_contains(a->socket_fd, "PLAY\n"),
+        "REJOIN after recovery lands in PLAY");
+
+  wal_close();
+  wal_crash_switch(npairs);
+  wal_bench_unlink();
+  printf("%s (%d failure(s))\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 2 : 0;
+}
+
+int main(int argc, char **argv) {
+  int games = 20000, npairs = 16, variant = GAME_VARIANT_CLASSIC;
+  int timeouts = 0, overload = 0, resume = 0, rematch = 0, salvo = 0;
+  int lobby = 0, mux = 0, watch = 0;
+  long scan = 0;
+  int rank_players = 0, wal_games = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--timeout-test") == 0) {
+      timeouts = 1;
+    } else if (strcmp(argv[i], "--overload-test") == 0) {
+      overload = 1;
+    } else if (strcmp(argv[i], "--resume-test") == 0) {
+      resume = 1;
+    } else if (strcmp(argv[i], "--rematch-test") == 0) {
+      rematch = 1;
+    } else if (strcmp(argv[i], "--salvo-test") == 0) {
+      salvo = 1;
+    } else if (strcmp(argv[i], "--mux-test") == 0) {
+      mux = 1;
+    } else if (strcmp(argv[i], "--lobby-test") == 0) {
+      lobby = 1;
+    } else if (strcmp(argv[i], "--watch-test") == 0) {
+      watch = 1;
+    } else if (strncmp(argv[i], "--lobby=", 8) == 0) {
+      sim_lobby = atoi(argv[i] + 8);
+    } else if (strcmp(argv[i], "--lobby-poll") == 0) {
+      sim_lobby_poll = 1;
+    } else if (strcmp(argv[i], "--salvo") == 0) {
+      sim_salvo = 1;
+    } else if (strcmp(argv[i], "--rematch") == 0) {
+      sim_rematch = 1;
+    } else if (strncmp(argv[i], "--scan-bench", 12) == 0) {
+      scan = (argv[i][12] == '=') ? atol(argv[i] + 13) : 200000;
+    } else if (strncmp(argv[i], "--rank-bench", 12) == 0) {
+      rank_players = (argv[i][12] == '=') ? atoi(argv[i] + 13) : 1000000;
+    } else if (strncmp(argv[i], "--wal-bench", 11) == 0) {
+      wal_games = (argv[i][11] == '=') ? atoi(argv[i] + 12) : 100000;
+    } else if (strncmp(argv[i], "--pairs=", 8) == 0) {
+      npairs = atoi(argv[i] + 8);
+    } else if (strncmp(argv[i], "--stats=", 8) == 0) {
+      if (!stats_open(argv[i] + 8))
+        return 1;
+    } else if (strncmp(argv[i], "--place=", 8) == 0) {
+      const char *m = argv[i] + 8;
+      sim_place = strcmp(m, "fleet") == 0  ? PLACE_FLEET
+                  : strcmp(m, "auto") == 0 ? PLACE_AUTO
+                                           : PLACE_BATCH;
+    } else if (strncmp(argv[i], "--poll=", 7) == 0) {
+      sim_poll = atoi(argv[i] + 7);
+    } else if (strncmp(argv[i], "--variant=", 10) == 0) {
+      variant = game_variant_from_str(argv[i] + 10);
+    } else if (argv[i][0] != '-') {
+      games = atoi(argv[i]);
+    } else {
+      fprintf(stderr,
+              "Usage: %s [games] [--pairs=N] [--variant=NAME] [--poll=K]\n"
+              "          [--place=batch|fleet|auto] [--rematch] [--salvo]\n"
+              "          [--lobby=N [--lobby-poll]] [--stats=PATH]\n"
+              "       %s --timeout-test | --overload-test | --resume-test |\n"
+              "          --rematch-test | --salvo-test | --lobby-test |\n"
+              "          --mux-test | --watch-test\n"
+              "       %s --scan-bench[=ROUNDS] | --rank-bench[=PLAYERS]\n"
+              "       %s --wal-bench[=GAMES] [--pairs=N]\n",
+              argv[0], argv[0], argv[0], argv[0]);
+      return 1;
+    }
+  }
+  if (games <= 0)
+    games = 20000;
+  if (npairs <= 0 || npairs > MAX_PLAYERS / 2)
+    npairs = 16;
+  if (sim_lobby < 0 || sim_lobby > MAX_PLAYERS - 2 * npairs)
+    sim_lobby = MAX_PLAYERS - 2 * npairs;
+  if (variant < 0) {
+    fprintf(stderr, "unknown variant\n");
+    return 1;
+  }
+
+  log_set_quiet(1);
+  if (timeouts)
+    return timeout_test();
+  if (overload)
+    return overload_test();
+  if (resume)
+    return resume_test();
+  if (rematch)
+    return rematch_test();
+  if (salvo)
+    return salvo_test();
+  if (lobby)
+    return lobby_test();
+  if (mux)
+    return mux_test();
+  if (watch)
+    return watch_test();
+  if (scan > 0)
+    return scan_bench(scan);
+  if (rank_players > 0)
+    return rank_bench(rank_players);
+  if (wal_games > 0)
+    return wal_bench(wal_games, npairs);
+
+  int rc = bench(games, npairs, variant);
+  if (stats_enabled()) {
+    printf("  stats:  %llu result(s) dropped\n",
+           (unsigned long long)stats_dropped());
+    stats_close();
+  }
+  return rc;
+}
@@ -0,0 +1,419 @@
+#define _POSIX_C_SOURCE 200112L
+#include "game.h"
+#include "journal.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Offline nástroj: vypíše hry ze žurnálu a umí libovolnou z nich znovu
+// přehrát přes game_place_ship()/game_shoot(). Režim --bench měří režii
+// zaznamenávání proti čistému game_shoot().
+
+typedef struct Rec {
+  int tag;
+  int session;
+  uint64_t v[6];
+} Rec;
+
+typedef struct GameInfo {
+  int session;
+  unsigned gid;
+  int room_id;
+  int variant;
+  int salvo;
+  time_t started;
+  int places;
+  int shots;
+  int winner;
+} GameInfo;
+
+static unsigned char *load_file(const char *path, size_t *out_len) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (sz < 0) {
+    fclose(f);
+    return NULL;
+  }
+  unsigned char *buf = malloc((size_t)sz + 1);
+  if (!buf || fread(buf, 1, (size_t)sz, f) != (size_t)sz) {
+    fclose(f);
+    free(buf);
+    return NULL;
+  }
+  fclose(f);
+  *out_len = (size_t)sz;
+  return buf;
+}
+
+static int field_count(int tag) {
+  switch (tag) {
+  case JR_SESSION:
+    return 1;
+  case JR_GAME:
+    return 4;
+  case JR_PLACE:
+    return 6;
+  case JR_READY:
+    return 2;
+  case JR_SHOT:
+    return 2;
+  case JR_END:
+    return 2;
+  case JR_SALVO:
+    return 1;
+  default:
+    return -1;
+  }
+}
+
+static Rec *decode(const unsigned char *buf, size_t len, int *out_n) {
+  if (len < 4 || memcmp(buf, JOURNAL_MAGIC, 4) != 0) {
+    fprintf(stderr, "not a journal file\n");
+    return NULL;
+  }
+
+  int cap = 1024, n = 0, session = 0;
+  Rec *recs = malloc(sizeof(Rec) * (size_t)cap);
+  const unsigned char *p = buf + 4, *end = buf + len;
+
+  while (p < end) {
+    Rec r = {0};
+    r.tag = *p++;
+    int fc = field_count(r.tag);
+    if (fc < 0) {
+      fprintf(stderr, "corrupt record at offset %ld\n", (long)(p - buf - 1));
+      break;
+    }
+    int ok = 1;
+    for (int i = 0; i < fc && ok; i++)
+      ok = varint_get(&p, end, &r.v[i]);
+    if (!ok) {
+      fprintf(stderr, "truncated record at end of file\n");
+      break;
+    }
+    if (r.tag == JR_SESSION)
+      session++;
+    r.session = session;
+
+    // Sbalený výstřel rozbalíme do tvaru gid, slot, x, y
+    if (r.tag == JR_SHOT) {
+      uint64_t packed = r.v[1];
+      r.v[1] = packed & 1;
+      r.v[2] = (packed >> 1) & 31;
+      r.v[3] = packed >> 6;
+    }
+
+    if (n == cap) {
+      cap *= 2;
+      recs = realloc(recs, sizeof(Rec) * (size_t)cap);
+    }
+    recs[n++] = r;
+  }
+  *out_n = n;
+  return recs;
+}
+
+static int find_game(GameInfo *games, int ng, int session, unsigned gid) {
+  for (int i = ng - 1; i >= 0; i--)
+    if (games[i].session == session && games[i].gid == gid)
+      return i;
+  return -1;
+}
+
+static GameInfo *index_games(const Rec *recs, int n, int *out_ng) {
+  int cap = 64, ng = 0;
+  GameInfo *games = malloc(sizeof(GameInfo) * (size_t)cap);
+
+  for (int i = 0; i < n; i++) {
+    const Rec *r = &recs[i];
+    if (r->tag == JR_GAME) {
+      if (ng == cap) {
+        cap *= 2;
+        games = realloc(games, sizeof(GameInfo) * (size_t)cap);
+      }
+      GameInfo *gi = &games[ng++];
+      memset(gi, 0, sizeof(*gi));
+      gi->session = r->session;
+      gi->gid = (unsigned)r->v[0];
+      gi->room_id = (int)r->v[1];
+      gi->started = (time_t)r->v[2];
+      gi->variant = (int)r->v[3];
+      gi->winner = -1;
+      continue;
+    }
+    if (r->tag == JR_SESSION)
+      continue;
+
+    int k = find_game(games, ng, r->session, (unsigned)r->v[0]);
+    if (k < 0)
+      continue;
+    if (r->tag == JR_PLACE)
+      games[k].places++;
+    else if (r->tag == JR_SHOT)
+      games[k].shots++;
+    else if (r->tag == JR_END)
+      games[k].winner = (int)r->v[1];
+    else if (r->tag == JR_SALVO)
+      games[k].salvo = 1;
+  }
+  *out_ng = ng;
+  return games;
+}
+
+static void print_board(const Game *g, int slot) {
+  printf("P%d board:\n", slot + 1);
+  for (int y = 0; y < g->n; y++) {
+    printf("  ");
+    for (int x = 0; x < g->n; x++) {
+      unsigned char c = g->board[slot][y][x];
+      putchar((c == 0) ? '.' : (c == 1) ? 'S' : (c == 2) ? 'H' : 'M');
+    }
+    putchar('\n');
+  }
+}
+
+static int replay_game(const Rec *recs, int n, const GameInfo *gi,
+                       int verbose) {
+  Game g;
+  game_room_init(&g, gi->room_id, gi->variant);
+  g.salvo = gi->salvo; // výstřely salvy jsou v žurnálu po jednom
+
+  static const char *res_str[] = {"WATER", "HIT", "SUNK", "WIN"};
+  int errors = 0;
+  char err[64];
+
+  for (int i = 0; i < n; i++) {
+    const Rec *r = &recs[i];
+    if (r->session != gi->session || r->tag == JR_SESSION ||
+        r->tag == JR_GAME || (unsigned)r->v[0] != gi->gid)
+      continue;
+
+    int slot = (int)r->v[1];
+    if (r->tag == JR_PLACE) {
+      char dir = r->v[5] ? 'V' : 'H';
+      if (!game_place_ship(&g, slot, (int)r->v[2], (int)r->v[3], (int)r->v[4],
+                           dir, err, sizeof(err))) {
+        printf("!! PLACE P%d %d %d %d %c rejected: %s\n", slot + 1,
+               (int)r->v[2], (int)r->v[3], (int)r->v[4], dir, err);
+        errors++;
+      } else if (verbose) {
+        printf("PLACE P%d %d %d %d %c\n", slot + 1, (int)r->v[2],
+               (int)r->v[3], (int)r->v[4], dir);
+      }
+    } else if (r->tag == JR_READY) {
+      if (!game_set_ready(&g, slot, err, sizeof(err))) {
+        printf("!! READY P%d rejected: %s\n", slot + 1, err);
+        errors++;
+      }
+    } else if (r->tag == JR_SHOT) {
+      int res = game_shoot(&g, slot, (int)r->v[2], (int)r->v[3], err,
+                           sizeof(err));
+      if (res < 0) {
+        printf("!! SHOOT P%d %d %d rejected: %s\n", slot + 1, (int)r->v[2],
+               (int)r->v[3], err);
+        errors++;
+      } else if (verbose) {
+        printf("SHOOT P%d %d %d -> %s\n", slot + 1, (int)r->v[2],
+               (int)r->v[3], res_str[res]);
+      }
+    } else if (r->tag == JR_END) {
+      if (!g.finished || g.winner != slot) {
+        printf("!! END mismatch: journal winner P%d, replay %s\n", slot + 1,
+               g.finished ? "other player" : "unfinished");
+        errors++;
+      }
+    }
+  }
+
+  print_board(&g, 0);
+  print_board(&g, 1);
+  printf("result: %s", g.finished ? "finished" : "unfinished");
+  if (g.finished)
+    printf(", winner P%d", g.winner + 1);
+  printf(", %d replay error(s)\n", errors);
+  return errors == 0;
+}
+
+// --- benchmark ---
+
+static uint64_t bench_rng = 88172645463325252ull;
+
+static unsigned bench_rand(unsigned n) {
+  bench_rng ^= bench_rng << 13;
+  bench_rng ^= bench_rng >> 7;
+  bench_rng ^= bench_rng << 17;
+  return (unsigned)(bench_rng % n);
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// wire_fd >= 0: ke každému výstřelu se pošlou i odpovědi jako na serveru
+// (výsledek střelci, OPP_* soupeři, tahy oběma), aby byla režie vztažená
+// k reálné cestě SHOOT a ne jen k samotnému game_shoot()
+static long bench_run(int games, int record, int wire_fd, int drain_fd) {
+  static const char *res_me[] = {"WATER\n", "HIT\n", "SUNK 0 0 2 H\n", "WIN\n"};
+  static const char *res_opp[] = {"OPP_WATER\n", "OPP_HIT\n",
+                                   "OPP_SUNK 0 0 2 H\n", "LOSE\n"};
+  char err[64];
+  char sink[4096];
+  long shots = 0;
+  bench_rng = 88172645463325252ull; // obě varianty hrají stejné hry
+
+  for (int k = 0; k < games; k++) {
+    Game g;
+    game_room_init(&g, 1, GAME_VARIANT_CLASSIC);
+    if (record)
+      g.journal_id = journal_game_start(1, GAME_VARIANT_CLASSIC);
+
+    for (int slot = 0; slot < 2; slot++) {
+      for (int s = 0; s < g.fleet; s++) {
+        int len = g.ship_len[s], x, y;
+        char dir;
+        do {
+          x = (int)bench_rand((unsigned)g.n);
+          y = (int)bench_rand((unsigned)g.n);
+          dir = bench_rand(2) ? 'V' : 'H';
+        } while (!game_place_ship(&g, slot, x, y, len, dir, err, sizeof(err)));
+        if (record)
+          journal_place(g.journal_id, slot, x, y, len, dir);
+      }
+      game_set_ready(&g, slot, err, sizeof(err));
+      if (record)
+        journal_ready(g.journal_id, slot);
+    }
+
+    while (!g.finished) {
+      int slot = g.turn, x, y;
+      do {
+        x = (int)bench_rand((unsigned)g.n);
+        y = (int)bench_rand((unsigned)g.n);
+      } while (g.board[1 - slot][y][x] >= 2);
+
+      int res = game_shoot(&g, slot, x, y, err, sizeof(err));
+      shots++;
+      if (wire_fd >= 0) {
+        net_send_all(wire_fd, res_me[res]);
+        net_send_all(wire_fd, res_opp[res]);
+        net_send_all(wire_fd, "YOUR_TURN\n");
+        net_send_all(wire_fd, "OPP_TURN\n");
+        while (recv(drain_fd, sink, sizeof(sink), MSG_DONTWAIT) > 0) {
+        }
+      }
+      if (record) {
+        journal_shot(g.journal_id, slot, x, y);
+        if (res == 3)
+          journal_game_end(g.journal_id, slot);
+      }
+    }
+    if (record)
+      journal_flush(0);
+  }
+  return shots;
+}
+
+static void bench_pair(const char *name, int games, int wire_fd,
+                       int drain_fd, const char *path) {
+  double t0 = now_sec();
+  long shots = bench_run(games, 0, wire_fd, drain_fd);
+  double base = now_sec() - t0;
+
+  if (!journal_open(path))
+    return;
+  t0 = now_sec();
+  bench_run(games, 1, wire_fd, drain_fd);
+  journal_close();
+  double rec = now_sec() - t0;
+  unlink(path);
+
+  printf("[%s] games=%d shots=%ld\n", name, games, shots);
+  printf("  baseline:  %.3f s (%.0f shots/s)\n", base, shots / base);
+  printf("  recording: %.3f s (%.0f shots/s)\n", rec, shots / rec);
+  printf("  overhead:  %.2f %% (%.1f ns/shot)\n", (rec - base) / base * 100.0,
+         (rec - base) / (double)shots * 1e9);
+}
+
+static int bench(int games) {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/replay-bench-%d.bsj", (int)getpid());
+
+  bench_pair("game core", games, -1, -1, path);
+
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+    perror("socketpair");
+    return 1;
+  }
+  bench_pair("shoot path", games / 10 > 0 ? games / 10 : 1, sv[0], sv[1],
+             path);
+  close(sv[0]);
+  close(sv[1]);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+    int games = (argc >= 3) ? atoi(argv[2]) : 200000;
+    if (games <= 0)
+      games = 200000;
+    return bench(games);
+  }
+
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <journal> [game_no] [-v]\n"
+            "       %s --bench [games]\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+
+  size_t len = 0;
+  unsigned char *buf = load_file(argv[1], &len);
+  if (!buf)
+    return 1;
+
+  int n = 0, ng = 0;
+  Rec *recs = decode(buf, len, &n);
+  if (!recs)
+    return 1;
+  GameInfo *games = index_games(recs, n, &ng);
+
+  if (argc == 2) {
+    for (int i = 0; i < ng; i++) {
+      char ts[32];
+      struct tm *tm = localtime(&games[i].started);
+      strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", tm);
+      int v = games[i].variant;
+      printf("#%d %s room=%d variant=%s%s places=%d shots=%d winner=", i + 1,
+             ts, games[i].room_id,
+             (v >= 0 && v < GAME_VARIANT_COUNT) ? game_variants[v].name : "?",
+             games[i].salvo ? " SALVO" : "", games[i].places, games[i].shots);
+      if (games[i].winner >= 0)
+        printf("P%d\n", games[i].winner + 1);
+      else
+        printf("-\n");
+    }
+    return 0;
+  }
+
+  int no = atoi(argv[2]);
+  if (no < 1 || no > ng) {
+    fprintf(stderr, "no such game #%d (journal has %d)\n", no, ng);
+    return 1;
+  }
+  int verbose = (argc >= 4 && strcmp(argv[3], "-v") == 0);
+  return replay_game(recs, n, &games[no - 1], verbose) ? 0 : 2;
+}
@@ -0,0 +1,389 @@
+#define _POSIX_C_SOURCE 200112L
+#include "bot.h"
+#include "common.h"
+#include "game.h"
+#include "log.h"
+#include "rng.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Bezhlavý simulátor: bot proti botovi přímo nad game.c (žádný protokol,
+// žádné sockety) na všech jádrech. Hry se rozdělí po blocích mezi vlákna,
+// kdo svůj rozsah dohraje, ukradne půlku cizího (work stealing). Každá hra
+// má vlastní seed odvozený z indexu, takže výsledek nezávisí na počtu
+// vláken ani na tom, kdo co ukradl.
+
+#define SIM_CHUNK 64 // her na jeden odběr z vlastního rozsahu
+#define SIM_LEN_MAX (2 * GAME_N_MAX * GAME_N_MAX)
+#define SIM_RANDOM BOT_NONE // "hráč" bez AI: náhodné pořadí buněk
+
+typedef struct SimStats {
+  uint64_t games;
+  uint64_t p1_wins;
+  uint64_t shots[2];
+  uint64_t hits[2];
+  uint64_t calls; // game_shoot()
+  uint64_t len_hist[SIM_LEN_MAX + 1]; // výstřelů v celé hře
+  uint64_t sunk_at[GAME_FLEET_MAX];   // součet pořadí výstřelu, který loď potopil
+  uint64_t sunk_n[GAME_FLEET_MAX];
+} SimStats;
+
+// Rozsah her [lo, hi) v jednom slově, aby šel vzít i ukrást jedním CAS
+typedef struct Worker {
+  _Alignas(CACHE_LINE) uint64_t range;
+  pthread_t th;
+  int id;
+  uint64_t rng; // výběr oběti při krádeži
+  long steals;
+  SimStats st;
+} Worker;
+
+typedef struct Job {
+  int variant;
+  int level[2];
+  int salvo; // --salvo: tah = salva (Game.salvo)
+  uint64_t seed;
+  int nworkers;
+  Worker *workers;
+} Job;
+
+static Job job;
+
+#define RANGE(lo, hi) ((uint64_t)(lo) | (uint64_t)(hi) << 32)
+#define RANGE_LO(r) ((uint32_t)(r))
+#define RANGE_HI(r) ((uint32_t)((r) >> 32))
+
+static uint64_t splitmix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// --- jedna hra ---
+
+static void shuffle_cells(unsigned char *cells, int count, uint64_t *rng) {
+  for (int i = 0; i < count; i++)
+    cells[i] = (unsigned char)i; // GAME_N_MAX^2 = 256 -> vejde se do bajtu
+  for (int i = count - 1; i > 0; i--) {
+    int j = (int)rng_below(rng, (unsigned)i + 1);
+    unsigned char t = cells[i];
+    cells[i] = cells[j];
+    cells[j] = t;
+  }
+}
+
+// shot = kolikátý výstřel střelce loď potopil
+static void note_sunk(const Game *g, int slot, int x, int y, int shot,
+                      SimStats *st) {
+  int s = g->ship_id[1 - slot][y][x] - 1;
+  if (s >= 0 && s < GAME_FLEET_MAX) {
+    st->sunk_at[s] += (uint64_t)shot;
+    st->sunk_n[s]++;
+  }
+}
+
+static void play(uint64_t index, SimStats *st) {
+  Game g;
+  uint64_t rng;
+  rng_seed(&rng, splitmix64(job.seed ^ splitmix64(index)));
+  game_room_init(&g, 1, job.variant);
+  g.salvo = job.salvo;
+  for (int slot = 0; slot < 2; slot++) {
+    if (!bot_place_fleet(&g, slot, &rng, NULL) ||
+        !game_set_ready(&g, slot, NULL, 0))
+      return;
+  }
+
+  unsigned char order[2][GAME_N_MAX * GAME_N_MAX];
+  int next[2] = {0, 0}, cells = g.n * g.n;
+  for (int slot = 0; slot < 2; slot++)
+    if (job.level[slot] == SIM_RANDOM)
+      shuffle_cells(order[slot], cells, &rng);
+
+  while (!g.finished) {
+    int slot = g.turn, x, y;
+    if (g.salvo && job.level[slot] != SIM_RANDOM) {
+      // Bot vybírá celou salvu naslepo, stejně jako hráč přes SALVO
+      GameShot sv[GAME_FLEET_MAX];
+      int k = g.salvo_left, before = g.shots[slot];
+      if (bot_choose_salvo(&g, slot, job.level[slot], &rng, sv, k) != k)
+        break;
+      int fired = game_salvo(&g, slot, sv, k, NULL, 0);
+      if (fired < 0)
+        break;
+      st->calls += (uint64_t)fired;
+      for (int i = 0; i < fired; i++)
+        if (sv[i].res >= 2)
+          note_sunk(&g, slot, sv[i].x, sv[i].y, before + i + 1, st);
+      continue;
+    }
+    if (job.level[slot] == SIM_RANDOM) {
+      if (next[slot] >= cells)
+        break;
+      int c = order[slot][next[slot]++];
+      x = c % g.n;
+      y = c / g.n;
+    } else if (!bot_choose_shot(&g, slot, job.level[slot], &rng, &x, &y)) {
+      break;
+    }
+
+    int res = game_shoot(&g, slot, x, y, NULL, 0);
+    st->calls++;
+    if (res < 0)
+      break; // bot vybral neplatnou buňku: chyba v bot.c, hru nepočítáme
+    if (res >= 2)
+      note_sunk(&g, slot, x, y, g.shots[slot], st);
+  }
+  if (!g.finished)
+    return;
+
+  st->games++;
+  if (g.winner == 0)
+    st->p1_wins++;
+  for (int s = 0; s < 2; s++) {
+    st->shots[s] += (uint64_t)g.shots[s];
+    st->hits[s] += (uint64_t)g.hits[s];
+  }
+  int len = g.shots[0] + g.shots[1];
+  st->len_hist[len <= SIM_LEN_MAX ? len : SIM_LEN_MAX]++;
+}
+
+// --- work stealing ---
+
+static int take(Worker *w, uint32_t *lo, uint32_t *hi) {
+  uint64_t r = __atomic_load_n(&w->range, __ATOMIC_ACQUIRE);
+  for (;;) {
+    uint32_t l = RANGE_LO(r), h = RANGE_HI(r);
+    if (l >= h)
+      return 0;
+    uint32_t n = (h - l < SIM_CHUNK) ? h - l : SIM_CHUNK;
+    if (__atomic_compare_exchange_n(&w->range, &r, RANGE(l + n, h), 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      *lo = l;
+      *hi = l + n;
+      return 1;
+    }
+  }
+}
+
+// Půlka rozsahu náhodné oběti; 0 = všude je prázdno (hotovo)
+static int steal(Worker *self) {
+  int start = (int)rng_below(&self->rng, (unsigned)job.nworkers);
+  for (int k = 0; k < job.nworkers; k++) {
+    Worker *v = &job.workers[(start + k) % job.nworkers];
+    if (v == self)
+      continue;
+    uint64_t r = __atomic_load_n(&v->range, __ATOMIC_ACQUIRE);
+    while (RANGE_LO(r) < RANGE_HI(r)) {
+      uint32_t l = RANGE_LO(r), h = RANGE_HI(r);
+      uint32_t mid = l + (h - l) / 2;
+      if (__atomic_compare_exchange_n(&v->range, &r, RANGE(l, mid), 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // Vlastní rozsah je prázdný, nikdo jiný ho teď nemění
+        __atomic_store_n(&self->range, RANGE(mid, h), __ATOMIC_RELEASE);
+        self->steals++;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static void *worker_main(void *arg) {
+  Worker *w = arg;
+  uint32_t lo, hi;
+  for (;;) {
+    while (take(w, &lo, &hi))
+      for (uint32_t i = lo; i < hi; i++)
+        play(i, &w->st);
+    if (!steal(w))
+      break;
+  }
+  return NULL;
+}
+
+// --- výstup ---
+
+static void add_stats(SimStats *to, const SimStats *s) {
+  to->games += s->games;
+  to->p1_wins += s->p1_wins;
+  to->calls += s->calls;
+  for (int k = 0; k < 2; k++) {
+    to->shots[k] += s->shots[k];
+    to->hits[k] += s->hits[k];
+  }
+  for (int k = 0; k <= SIM_LEN_MAX; k++)
+    to->len_hist[k] += s->len_hist[k];
+  for (int k = 0; k < GAME_FLEET_MAX; k++) {
+    to->sunk_at[k] += s->sunk_at[k];
+    to->sunk_n[k] += s->sunk_n[k];
+  }
+}
+
+static int percentile(const SimStats *s, double q) {
+  uint64_t want = (uint64_t)((double)s->games * q), acc = 0;
+  if (want >= s->games)
+    want = s->games - 1;
+  for (int k = 0; k <= SIM_LEN_MAX; k++) {
+    acc += s->len_hist[k];
+    if (acc > want)
+      return k;
+  }
+  return SIM_LEN_MAX;
+}
+
+static const char *level_name(int level) {
+  return level == SIM_RANDOM ? "RANDOM" : bot_level_str(level);
+}
+
+static void report(const SimStats *s, double dt, long steals) {
+  const GameVariant *v = &game_variants[job.variant];
+  printf("[%s%s] games=%llu P1=%s P2=%s threads=%d\n", v->name,
+         job.salvo ? " SALVO" : "", (unsigned long long)s->games,
+         level_name(job.level[0]),
+         level_name(job.level[1]), job.nworkers);
+  if (!s->games)
+    return;
+  double n = (double)s->games;
+  printf("  time:     %.3f s (%.0f games/s, %.1f M game_shoot/s, "
+         "%.1f M/s per thread, %ld steals)\n",
+         dt, n / dt, (double)s->calls / dt / 1e6,
+         (double)s->calls / dt / 1e6 / job.nworkers, steals);
+
+  double total = (double)(s->shots[0] + s->shots[1]);
+  printf("  length:   %.2f shots avg (p10 %d, p50 %d, p90 %d, max %d)\n",
+         total / n, percentile(s, 0.10), percentile(s, 0.50),
+         percentile(s, 0.90), percentile(s, 1.0));
+
+  double p = (double)s->p1_wins / n;
+  printf("  first:    P1 wins %.2f %% +- %.2f (advantage %+.2f pts)\n",
+         p * 100.0, 196.0 * sqrt(p * (1.0 - p) / n), (p - 0.5) * 100.0);
+  printf("  hit rate: P1 %.2f %%, P2 %.2f %%\n",
+         100.0 * (double)s->hits[0] / (double)(s->shots[0] ? s->shots[0] : 1),
+         100.0 * (double)s->hits[1] / (double)(s->shots[1] ? s->shots[1] : 1));
+
+  // Průměrné pořadí výstřelu (střelce), kterým loď šla ke dnu
+  printf("  sunk at:  ");
+  for (int k = 0; k < v->fleet; k++)
+    printf("%slen%d %.1f", k ? ", " : "", v->ship_len[k],
+           s->sunk_n[k] ? (double)s->sunk_at[k] / (double)s->sunk_n[k] : 0.0);
+  printf("\n");
+}
+
+static int run(int variant, uint64_t games) {
+  job.variant = variant;
+  Worker *ws = job.workers;
+  for (int i = 0; i < job.nworkers; i++) {
+    memset(&ws[i].st, 0, sizeof(ws[i].st));
+    uint64_t lo = games * (uint64_t)i / (uint64_t)job.nworkers;
+    uint64_t hi = games * (uint64_t)(i + 1) / (uint64_t)job.nworkers;
+    ws[i].range = RANGE(lo, hi);
+    ws[i].id = i;
+    ws[i].steals = 0;
+    rng_seed(&ws[i].rng, splitmix64((uint64_t)i + 1));
+  }
+
+  double t0 = now_sec();
+  for (int i = 0; i < job.nworkers; i++) {
+    if (pthread_create(&ws[i].th, NULL, worker_main, &ws[i]) != 0) {
+      fprintf(stderr, "sim: cannot start thread %d\n", i);
+      return 1;
+    }
+  }
+  static SimStats sum;
+  memset(&sum, 0, sizeof(sum));
+  long steals = 0;
+  for (int i = 0; i < job.nworkers; i++) {
+    pthread_join(ws[i].th, NULL);
+    add_stats(&sum, &ws[i].st);
+    steals += ws[i].steals;
+  }
+  report(&sum, now_sec() - t0, steals);
+  return sum.games == games ? 0 : 2;
+}
+
+// Tabulky placementu (game.c) a masky bota (bot.c) se plní líně při prvním
+// použití a nejsou thread-safe: jedna hra na variantu je naplní předem
+static void warm_up(void) {
+  for (int v = 0; v < GAME_VARIANT_COUNT; v++) {
+    Game g;
+    uint64_t rng = 1;
+    int x, y;
+    game_room_init(&g, 1, v);
+    bot_place_fleet(&g, 1, &rng, NULL);
+    bot_choose_shot(&g, 0, BOT_HARD, &rng, &x, &y);
+  }
+}
+
+static int parse_level(const char *s) {
+  if (strcmp(s, "random") == 0 || strcmp(s, "RANDOM") == 0)
+    return SIM_RANDOM;
+  int level = bot_level_from_str(s);
+  return level == BOT_NONE ? -1 : level;
+}
+
+int main(int argc, char **argv) {
+  uint64_t games = 1000000;
+  int variant = -1, threads = (int)sysconf(_SC_NPROCESSORS_ONLN), bad = 0;
+  job.level[0] = job.level[1] = BOT_HARD;
+  job.seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--threads=", 10) == 0) {
+      threads = atoi(argv[i] + 10);
+    } else if (strncmp(argv[i], "--variant=", 10) == 0) {
+      if (strcmp(argv[i] + 10, "all") != 0 &&
+          (variant = game_variant_from_str(argv[i] + 10)) < 0)
+        bad = 1;
+    } else if (strncmp(argv[i], "--p1=", 5) == 0) {
+      bad |= (job.level[0] = parse_level(argv[i] + 5)) < 0;
+    } else if (strncmp(argv[i], "--p2=", 5) == 0) {
+      bad |= (job.level[1] = parse_level(argv[i] + 5)) < 0;
+    } else if (strcmp(argv[i], "--salvo") == 0) {
+      job.salvo = 1;
+    } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+      job.seed = strtoull(argv[i] + 7, NULL, 10);
+    } else if (argv[i][0] != '-') {
+      games = strtoull(argv[i], NULL, 10);
+    } else {
+      bad = 1;
+    }
+  }
+  if (bad || games == 0 || games > UINT32_MAX || threads <= 0) {
+    fprintf(stderr,
+            "Usage: %s [games] [--threads=N] [--variant=NAME|all]\n"
+            "          [--p1=easy|hard|random] [--p2=easy|hard|random] "
+            "[--salvo] [--seed=N]\n",
+            argv[0]);
+    return 1;
+  }
+
+  log_set_quiet(1);
+  warm_up();
+  job.nworkers = threads;
+  // Worker má vlastní cache line (rozsah se mění přes CAS z více vláken)
+  job.workers = aligned_alloc(CACHE_LINE, (size_t)threads * sizeof(Worker));
+  if (!job.workers)
+    return 1;
+  memset(job.workers, 0, (size_t)threads * sizeof(Worker));
+
+  int rc = 0;
+  for (int v = 0; v < GAME_VARIANT_COUNT; v++)
+    if (variant < 0 || v == variant)
+      rc |= run(v, games);
+  free(job.workers);
+  return rc;
+}